@@ -0,0 +1,106 @@
+/*
+ * Calibrates the transmitter's timer-generated BREAK, MAB, and
+ * inter-slot MARK times and stores the corrections in EEPROM so
+ * that later startups can use them without calibrating again.
+ *
+ * Wire Serial1's TX pin to the loopback pin below. Send 'c' over
+ * the serial monitor to calibrate again, for example after
+ * changing the CPU speed.
+ *
+ * This example is part of the TeensyDMX library.
+ * (c) 2023 Shawn Silverman
+ */
+
+#include <EEPROM.h>
+#include <TeensyDMX.h>
+#include <TimingCalibrator.h>
+
+namespace teensydmx = ::qindesign::teensydmx;
+
+// Pin for enabling or disabling the transmitter.
+// This may not be needed for your hardware.
+constexpr uint8_t kTXPin = 17;
+
+// Pin wired to Serial1's TX pin.
+constexpr int kLoopbackPin = 2;
+
+// Where the corrections are stored in EEPROM.
+constexpr int kEEPROMAddress = 0;
+
+// Marks stored corrections as valid and for this CPU speed.
+constexpr uint32_t kMagic = 0x54444d43 ^ F_CPU;  // "TDMC"
+
+// What's stored in EEPROM.
+struct StoredCalibration {
+  uint32_t magic;
+  teensydmx::Sender::TimerCalibration cal;
+};
+
+// Create the DMX transmitter on Serial1.
+teensydmx::Sender dmxTx{Serial1};
+
+// Prints a correction.
+void printCorrection(const char *name,
+                     const teensydmx::Sender::TimerCorrection &c) {
+  Serial.printf("%s: offset=%.2fus gain=%.4f\r\n",
+                name, c.offset / 65536.0f, c.gain / 65536.0f);
+}
+
+// Calibrates, prints the results, and stores them.
+void calibrate() {
+  Serial.println("Calibrating...");
+  teensydmx::TimingCalibrator calibrator{dmxTx, kLoopbackPin};
+  StoredCalibration stored;
+  if (!calibrator.calibrate(&stored.cal)) {
+    Serial.println("Calibration failed; check the loopback wiring.");
+    return;
+  }
+
+  Serial.println("timer(us): break,mab,interslot -> measured(us)");
+  for (int i = 0; i < teensydmx::TimingCalibrator::kPoints; i++) {
+    teensydmx::TimingCalibrator::Measurement m = calibrator.measurement(i);
+    Serial.printf("%lu,%lu,%lu -> %.2f,%.2f,%.2f\r\n",
+                  m.breakTime, m.mabTime, m.interSlotTime,
+                  m.measuredBreakTime, m.measuredMABTime,
+                  m.measuredInterSlotTime);
+  }
+  printCorrection("BREAK", stored.cal.breakTime);
+  printCorrection("MAB", stored.cal.mabTime);
+  printCorrection("Inter-slot", stored.cal.interSlotTime);
+
+  stored.magic = kMagic;
+  EEPROM.put(kEEPROMAddress, stored);
+  Serial.println("Stored.");
+}
+
+void setup() {
+  // Initialize the serial port
+  Serial.begin(115200);
+  while (!Serial && millis() < 4000) {
+    // Wait for initialization to complete or a time limit
+  }
+  Serial.println("Starting Calibrate.");
+
+  // Set the pin that enables the transmitter; may not be needed
+  pinMode(kTXPin, OUTPUT);
+  digitalWriteFast(kTXPin, HIGH);
+
+  dmxTx.setBreakUseTimerNotSerial(true);
+  dmxTx.begin();
+
+  // Use stored corrections if there are any
+  StoredCalibration stored;
+  EEPROM.get(kEEPROMAddress, stored);
+  if (stored.magic == kMagic) {
+    dmxTx.setTimerCalibration(stored.cal);
+    Serial.println("Using stored corrections.");
+  } else {
+    calibrate();
+  }
+}
+
+void loop() {
+  if (Serial.available() > 0 && Serial.read() == 'c') {
+    calibrate();
+  }
+}
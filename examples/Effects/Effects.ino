@@ -0,0 +1,93 @@
+/*
+ * Demonstrates procedural effects computed by the transmitter
+ * every frame: a sine wave across a row of dimmers, a rainbow
+ * across RGB fixtures, and a chase. The main loop is free to
+ * do other things; here it swaps the chase direction every
+ * ten seconds.
+ *
+ * This example is part of the TeensyDMX library.
+ * (c) 2023 Shawn Silverman
+ */
+
+#include <EffectEngine.h>
+#include <TeensyDMX.h>
+
+namespace teensydmx = ::qindesign::teensydmx;
+
+// Pin for enabling or disabling the transmitter.
+// This may not be needed for your hardware.
+constexpr uint8_t kTXPin = 17;
+
+// Number of fixtures in each effect.
+constexpr int kDimmers = 12;
+constexpr int kRGBFixtures = 8;
+constexpr int kChaseChannels = 16;
+
+// Create the DMX transmitter on Serial1.
+teensydmx::Sender dmxTx{Serial1};
+
+// The effects, computed once per transmitted frame.
+teensydmx::EffectEngine effects;
+
+// The chase effect and its slot, for changing direction.
+teensydmx::Effect chase;
+int chaseSlot;
+
+// Elapsed time since the last direction change.
+elapsedMillis sinceLastSwap;
+
+void setup() {
+  // Initialize the serial port
+  Serial.begin(115200);
+  while (!Serial && millis() < 4000) {
+    // Wait for initialization to complete or a time limit
+  }
+  Serial.println("Starting Effects.");
+
+  // Set the pin that enables the transmitter; may not be needed
+  pinMode(kTXPin, OUTPUT);
+  digitalWriteFast(kTXPin, HIGH);
+
+  // A slow sine wave rolling across the dimmers, channels 1-12
+  teensydmx::Effect wave;
+  wave.waveform = teensydmx::Waveform::kSine;
+  wave.startChannel = 1;
+  wave.groupCount = kDimmers;
+  wave.periodFrames = 4 * 44;  // About 4 seconds
+  wave.phaseSpread = 65536 / kDimmers;
+  effects.add(wave);
+
+  // A rainbow across the RGB fixtures, channels 101-124
+  teensydmx::Effect rainbow;
+  rainbow.waveform = teensydmx::Waveform::kRainbow;
+  rainbow.startChannel = 101;
+  rainbow.groupCount = kRGBFixtures;
+  rainbow.groupSize = 3;
+  rainbow.periodFrames = 10 * 44;  // About 10 seconds
+  rainbow.phaseSpread = 65536 / kRGBFixtures;
+  effects.add(rainbow);
+
+  // A single lit channel chasing across channels 201-216
+  chase.waveform = teensydmx::Waveform::kSquare;
+  chase.startChannel = 201;
+  chase.groupCount = kChaseChannels;
+  chase.periodFrames = kChaseChannels * 4;  // 4 frames per step
+  chase.duty = 65536 / kChaseChannels;
+  chase.phaseSpread = 65536 - 65536 / kChaseChannels;
+  chaseSlot = effects.add(chase);
+
+  dmxTx.addFrameProcessor(&effects);
+  dmxTx.begin();
+}
+
+void loop() {
+  if (sinceLastSwap < 10000) {
+    return;
+  }
+  sinceLastSwap = 0;
+
+  // Reverse the chase without a jump
+  chase.phaseSpread = 65536 - chase.phaseSpread;
+  effects.update(chaseSlot, chase);
+  Serial.println("Reversed the chase.");
+}
@@ -0,0 +1,142 @@
+/*
+ * Characterizes the transmitter by sweeping packet size, BREAK and
+ * MAB times, inter-slot MARK time, and MBB time, and printing a
+ * table of the theoretical and measured frame rates, the ISR cost
+ * per frame, and the cost of copying a packet into the sender.
+ *
+ * Use the table to pick the highest refresh rate that's both
+ * achievable and within the ANSI E1.11 limits for a universe. The
+ * "limits" column is zero when the settings meet all the limits;
+ * otherwise it's the util::TXTimingViolation bits, in hex.
+ *
+ * The output is comma-separated so that it can be pasted into
+ * a spreadsheet.
+ *
+ * This example is part of the TeensyDMX library.
+ * (c) 2023 Shawn Silverman
+ */
+
+#include <TeensyDMX.h>
+
+namespace teensydmx = ::qindesign::teensydmx;
+
+// How long to measure each combination of settings.
+constexpr uint32_t kMeasureTime = 1000;  // 1s
+
+// Pin for enabling or disabling the transmitter.
+// This may not be needed for your hardware.
+constexpr uint8_t kTXPin = 17;
+
+// The packet sizes to try.
+constexpr int kPacketSizes[]{25, 50, 100, 150, 200, 300, 400, 513};
+
+// BREAK and MAB settings to try. A BREAK time of zero means "use the
+// default serial parameters" instead of a timer.
+struct BreakSettings {
+  uint32_t breakTime;
+  uint32_t mabTime;
+};
+constexpr BreakSettings kBreakSettings[]{
+    {0, 0},     // Serial parameters, ~180us BREAK and ~20us MAB
+    {92, 12},   // Timer, minimum allowed times
+    {180, 20},  // Timer, typical times
+};
+
+// Inter-slot MARK times to try.
+constexpr uint32_t kInterSlotTimes[]{0, 4};
+
+// MBB times to try.
+constexpr uint32_t kMBBTimes[]{0, 100};
+
+// Create the DMX transmitter on Serial1.
+teensydmx::Sender dmxTx{Serial1};
+
+// Packet data to copy.
+uint8_t packetBuf[teensydmx::kMaxDMXPacketSize]{0};
+
+// Measures one combination of settings and prints a row.
+void measure(int size, const BreakSettings &b, uint32_t interSlotTime,
+             uint32_t mbbTime) {
+  dmxTx.end();
+  if (b.breakTime == 0) {
+    dmxTx.setBreakUseTimerNotSerial(false);
+  } else {
+    dmxTx.setBreakUseTimerNotSerial(true);
+    dmxTx.setBreakTime(b.breakTime);
+    dmxTx.setMABTime(b.mabTime);
+  }
+  dmxTx.setInterSlotTime(interSlotTime);
+  dmxTx.setMBBTime(mbbTime);
+  dmxTx.begin();
+
+  // Copy cost
+  uint32_t t = teensydmx::util::cycleCount();
+  dmxTx.setPacketSizeAndData(size, 0, packetBuf, size);
+  uint32_t copyCycles = teensydmx::util::cycleCount() - t;
+
+  // Let the new settings take effect before measuring
+  delay(50);
+  dmxTx.resetISRStats();
+  uint32_t startCount = dmxTx.packetCount();
+  uint32_t startTime = millis();
+  delay(kMeasureTime);
+  uint32_t packets = dmxTx.packetCount() - startCount;
+  uint32_t elapsed = millis() - startTime;
+  teensydmx::util::ISRProfiler::Stats isr = dmxTx.isrStats();
+
+  teensydmx::util::TXTiming timing = dmxTx.timing();
+  float cyclesPerUs = isr.cyclesPerSecond / 1000000.0f;
+  float isrUs = isr.totalCycles / cyclesPerUs;
+  float isrPerFrame = 0.0f;
+  if (packets > 0) {
+    isrPerFrame = isrUs / packets;
+  }
+
+  Serial.printf("%d,%lu,%lu,%lu,%lu,%.2f,%.2f,%.2f,%.2f,%.2f,%lx\r\n",
+                size,
+                timing.breakTime,
+                timing.mabTime,
+                interSlotTime,
+                mbbTime,
+                timing.frameRate(),
+                1000.0f * packets / elapsed,
+                isrPerFrame,
+                isrUs / (10.0f * elapsed),  // Percent of elapsed time
+                copyCycles / cyclesPerUs,
+                timing.violations());
+}
+
+void setup() {
+  // Initialize the serial port
+  Serial.begin(115200);
+  while (!Serial && millis() < 4000) {
+    // Wait for initialization to complete or a time limit
+  }
+  Serial.println("Starting TimingSweep.");
+
+  // Set the pin that enables the transmitter; may not be needed
+  pinMode(kTXPin, OUTPUT);
+  digitalWriteFast(kTXPin, HIGH);
+
+  for (int i = 0; i < teensydmx::kMaxDMXPacketSize; i++) {
+    packetBuf[i] = i;
+  }
+  packetBuf[0] = 0;  // Start code
+
+  Serial.println("size,break(us),mab(us),interslot(us),mbb(us),"
+                 "model(Hz),measured(Hz),isr/frame(us),isr load(%),"
+                 "copy(us),limits");
+  for (const BreakSettings &b : kBreakSettings) {
+    for (uint32_t interSlotTime : kInterSlotTimes) {
+      for (uint32_t mbbTime : kMBBTimes) {
+        for (int size : kPacketSizes) {
+          measure(size, b, interSlotTime, mbbTime);
+        }
+      }
+    }
+  }
+  Serial.println("Done.");
+}
+
+void loop() {
+}
@@ -0,0 +1,98 @@
+// CaptureLine.h defines a way for host tests to send captured frames into a
+// simulated RX line, so that they go through the whole receive path of a real
+// `Receiver` instead of being handed to a responder directly.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_TEST_CAPTURELINE_H_
+#define TEENSYDMX_TEST_CAPTURELINE_H_
+
+// C++ includes
+#include <algorithm>
+#include <cstdint>
+
+#include "Capture.h"
+#include "LineDriver.h"
+
+// The bit time at 250kbaud, in nanoseconds.
+constexpr double kCaptureBitNs = 4000.0;
+
+// Used when a capture doesn't have the BREAK or MAB time, in nanoseconds.
+constexpr double kCaptureDefaultBreakNs = 176e3;
+constexpr double kCaptureDefaultMABNs = 12e3;
+
+// Sends one captured frame: the BREAK and MAB, using the captured times where
+// they were measured, and then the slots, spread out evenly to fill the
+// captured packet time. Each slot has two stop bits.
+inline void sendCaptureFrame(LineDriver &line,
+                             const ::qindesign::teensydmx::CaptureFrame &frame) {
+  const auto &stats = frame.stats;
+  double breakNs = (stats.breakTime != 0) ? stats.breakTime*1e3
+                                          : kCaptureDefaultBreakNs;
+  double mabNs;
+  if (stats.mabTime != 0) {
+    mabNs = stats.mabTime*1e3;
+  } else if (stats.breakPlusMABTime*1e3 > breakNs) {
+    mabNs = stats.breakPlusMABTime*1e3 - breakNs;
+  } else {
+    mabNs = kCaptureDefaultMABNs;
+  }
+
+  int size = stats.size;
+  double interSlotNs = 0.0;
+  if (size > 1) {
+    double slotsNs = size*11*kCaptureBitNs;
+    interSlotNs = std::max(
+        0.0, (stats.packetTime*1e3 - breakNs - mabNs - slotsNs) / (size - 1));
+  }
+
+  line.hold(false, breakNs);
+  line.hold(true, mabNs);
+  for (int i = 0; i < size; i++) {
+    line.sendChar(frame.data[i], kCaptureBitNs, 2, false);
+    if (i + 1 < size) {
+      line.hold(true, interSlotNs);
+    }
+  }
+}
+
+// Sends all the frames the reader has available. Each BREAK starts at its
+// captured BREAK-to-BREAK time after the previous one, or as soon as the
+// previous frame is done if that's later. This returns the number of frames
+// sent.
+//
+// A receiver only completes a packet when it sees the next BREAK, so follow
+// this with `sendCaptureEnd`.
+inline int sendCapture(LineDriver &line,
+                       ::qindesign::teensydmx::CaptureReader &reader) {
+  ::qindesign::teensydmx::CaptureFrame frame;
+  double start = 0.0;
+  uint32_t lastTimestamp = 0;
+  int count = 0;
+  while (reader.readFrame(&frame) > 0) {
+    if (count > 0) {
+      double due = start + (frame.stats.frameTimestamp - lastTimestamp)*1e3;
+      if (due > line.time()) {
+        line.hold(true, due - line.time());
+      }
+    }
+    start = line.time();
+    lastTimestamp = frame.stats.frameTimestamp;
+    sendCaptureFrame(line, frame);
+    count++;
+  }
+  return count;
+}
+
+// Sends a BREAK, MAB, and null start code, so that the receiver completes the
+// last packet, and then runs the simulation to the end of the waveform.
+inline void sendCaptureEnd(LineDriver &line) {
+  line.hold(true, 100e3);
+  line.hold(false, kCaptureDefaultBreakNs);
+  line.hold(true, kCaptureDefaultMABNs);
+  line.sendChar(0, kCaptureBitNs, 2, false);
+  line.hold(true, 100e3);
+  line.flush();
+}
+
+#endif  // TEENSYDMX_TEST_CAPTURELINE_H_
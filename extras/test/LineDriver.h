@@ -0,0 +1,58 @@
+// LineDriver.h defines a way for host tests to drive a simulated RX line with
+// DMX waveforms.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_TEST_LINEDRIVER_H_
+#define TEENSYDMX_TEST_LINEDRIVER_H_
+
+// C++ includes
+#include <cstdint>
+
+#include <Host.h>
+#include <LPUARTModel.h>
+
+// Drives a line by scheduling level changes in simulated time.
+class LineDriver final {
+ public:
+  explicit LineDriver(host::LineListener &line)
+      : line_(line),
+        level_(true),
+        t_(host::now()) {}
+
+  // Holds the line at a level for a duration.
+  void hold(bool level, double ns) {
+    if (level != level_) {
+      host::runUntil(static_cast<uint64_t>(t_));
+      line_.lineChanged(level);
+      level_ = level;
+    }
+    t_ += ns;
+  }
+
+  // Sends one 8-bit character with the given number of stop bits, or with a
+  // low stop bit if `frameError` is true.
+  void sendChar(uint8_t b, double bitNs, int stopBits, bool frameError) {
+    hold(false, bitNs);
+    for (int i = 0; i < 8; i++) {
+      hold(((b >> i) & 0x01) != 0, bitNs);
+    }
+    hold(!frameError, bitNs*stopBits);
+  }
+
+  // Runs the simulation up to the current end of the waveform.
+  void flush() {
+    host::runUntil(static_cast<uint64_t>(t_));
+  }
+
+  double time() const {
+    return t_;
+  }
+
+ private:
+  host::LineListener &line_;
+  bool level_;
+  double t_;  // The end of the waveform so far, in nanoseconds
+};
+
+#endif  // TEENSYDMX_TEST_LINEDRIVER_H_
@@ -0,0 +1,297 @@
+// TXCapture.h defines a way for host tests to run a `Sender` against the
+// LPUART model, decode the waveform on its TX line into packets, and check its
+// send interrupts, as traced, against the handler's state machine.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_TEST_TXCAPTURE_H_
+#define TEENSYDMX_TEST_TXCAPTURE_H_
+
+#ifndef TEENSYDMX_ENABLE_TRACE
+#error "Build with TEENSYDMX_ENABLE_TRACE defined"
+#endif  // !TEENSYDMX_ENABLE_TRACE
+
+// C++ includes
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <Host.h>
+#include <LPUARTModel.h>
+
+#include "TeensyDMX.h"
+
+// Names used by this file and by the tests that include it.
+using ::qindesign::teensydmx::Sender;
+using ::qindesign::teensydmx::util::TraceEvent;
+using ::qindesign::teensydmx::util::TraceEventType;
+
+// The nominal bit and slot times, in nanoseconds.
+constexpr double kBitNs = 4000.0;
+constexpr double kSlotNs = 11*kBitNs;
+
+// Any LOW longer than a character, a start bit and nine zero data bits, is a
+// BREAK, in nanoseconds.
+constexpr double kMinBreakLowNs = 11*kBitNs;
+
+// How far an edge inside a character may be from where it belongs, in
+// nanoseconds. This is the allowed 2% bit time error over nine bits.
+constexpr double kEdgeToleranceNs = 9*0.02*kBitNs;
+
+// The sender's states, as traced.
+enum TXState : uint8_t {
+  kBreak,
+  kMAB,
+  kData,
+  kInterSlot,
+  kIdle,
+};
+
+// One packet decoded from the TX line. Times are in microseconds.
+struct Packet {
+  double start = 0.0;  // BREAK start
+  double end = 0.0;    // End of the last slot's two stop bits
+  double breakTime = 0.0;
+  double mabTime = 0.0;
+  double mbbTime = 0.0;
+  double breakToBreakTime = 0.0;
+  std::vector<uint8_t> slots;
+  std::vector<double> interSlotTimes;  // MARK before each slot after the first
+  int framingErrors = 0;               // Slots without two stop bits
+  int bitErrors = 0;                   // Edges off the bit grid
+  bool complete = false;               // Followed by another BREAK
+};
+
+// Returns the line level at time `t`, in nanoseconds. The line starts out
+// idle.
+inline bool levelAt(const std::vector<host::Edge> &edges, double t) {
+  auto it = std::upper_bound(
+      edges.begin(), edges.end(), t,
+      [](double t, const host::Edge &e) { return t < e.time; });
+  return (it == edges.begin()) ? true : (it - 1)->level;
+}
+
+// Decodes the packets on a TX line. Anything before the first BREAK is
+// ignored.
+inline std::vector<Packet> decode(const std::vector<host::Edge> &edges) {
+  std::vector<Packet> packets;
+  double lastEnd = 0.0;  // End of the BREAK or the last slot, in ns
+
+  size_t i = 0;
+  while (i < edges.size()) {
+    if (edges[i].level) {
+      i++;
+      continue;
+    }
+    double fall = edges[i].time;
+    if (i + 1 >= edges.size()) {
+      break;  // The line is still LOW
+    }
+    double rise = edges[i + 1].time;
+
+    if (rise - fall >= kMinBreakLowNs) {
+      if (!packets.empty()) {
+        Packet &prev = packets.back();
+        prev.complete = true;
+        prev.mbbTime = (fall - lastEnd) / 1000.0;
+        prev.breakToBreakTime = fall/1000.0 - prev.start;
+      }
+      Packet p;
+      p.start = fall / 1000.0;
+      p.breakTime = (rise - fall) / 1000.0;
+      packets.push_back(p);
+      lastEnd = rise;
+      i += 2;
+      continue;
+    }
+    if (packets.empty()) {
+      i++;
+      continue;
+    }
+
+    // A character: a start bit, 8 data bits, and 2 stop bits
+    Packet &p = packets.back();
+    double mark = (fall - lastEnd) / 1000.0;
+    if (p.slots.empty()) {
+      p.mabTime = mark;
+    } else {
+      p.interSlotTimes.push_back(mark);
+    }
+    uint8_t b = 0;
+    for (int bit = 0; bit < 8; bit++) {
+      if (levelAt(edges, fall + (bit + 1.5)*kBitNs)) {
+        b |= 1 << bit;
+      }
+    }
+    p.slots.push_back(b);
+
+    // Every edge must be on a bit boundary and the stop bits must be HIGH
+    double stopStart = fall + 9*kBitNs;
+    double end = fall + kSlotNs;
+    size_t j = i + 1;
+    for (; j < edges.size() && edges[j].time < end - kBitNs/2; j++) {
+      double offset = edges[j].time - fall;
+      double k = std::round(offset / kBitNs);
+      if (std::fabs(offset - k*kBitNs) > kEdgeToleranceNs) {
+        p.bitErrors++;
+      }
+      if (edges[j].time > stopStart + kEdgeToleranceNs) {
+        p.framingErrors++;
+      }
+    }
+    if (!levelAt(edges, stopStart + kBitNs/2) ||
+        !levelAt(edges, end - kBitNs/2)) {
+      p.framingErrors++;
+    }
+    p.end = end / 1000.0;
+    lastEnd = end;
+    i = j;
+  }
+  return packets;
+}
+
+// Runs a sender and collects what it transmitted.
+class Capture final {
+ public:
+  explicit Capture(Sender &tx)
+      : tx_(tx),
+        uart_(host::lpuartForSerial(tx.serialNumber() - 1)) {
+    uart_.clearTXEdges();
+    drainTrace();
+  }
+
+  // Runs the simulation for the given time, in milliseconds, and collects the
+  // trace events along the way.
+  void run(double ms) {
+    uint64_t end = host::now() + static_cast<uint64_t>(ms * 1e6);
+    while (host::now() < end) {
+      host::runUntil(std::min(end, host::now() + kChunk));
+      readTrace();
+    }
+  }
+
+  // Decodes everything sent so far.
+  std::vector<Packet> packets() const {
+    return decode(uart_.txEdges());
+  }
+
+  // Returns the number of packets that the trace showed being completed.
+  int completedPackets() const {
+    return completedPackets_;
+  }
+
+  // Returns the number of send interrupts that happened in a state that
+  // doesn't follow from the previous one.
+  int badTransitions() const {
+    return badTransitions_;
+  }
+
+  // Returns the number of send interrupts seen in each state.
+  int irqCount(TXState state) const {
+    return irqCounts_[state];
+  }
+
+  // Returns the number of send interrupts seen in all states.
+  int irqCount() const {
+    int n = 0;
+    for (int c : irqCounts_) {
+      n += c;
+    }
+    return n;
+  }
+
+ private:
+  // How much to simulate before reading the trace, in nanoseconds.
+  static constexpr uint64_t kChunk = 5000000;
+
+  void drainTrace() {
+    TraceEvent buf[256];
+    while (tx_.readTraceEvents(buf, 256) > 0) {
+    }
+  }
+
+  void readTrace() {
+    TraceEvent buf[256];
+    int n;
+    while ((n = tx_.readTraceEvents(buf, 256)) > 0) {
+      for (int i = 0; i < n; i++) {
+        addEvent(buf[i]);
+      }
+    }
+  }
+
+  // Checks one event against the previous one. A packet goes from kIdle to
+  // kBreak, and then to kData either through the serial BREAK's completion or
+  // through the BREAK and MAB timers. Slots are sent in kData, with a visit to
+  // kInterSlot for each slot when a timer makes the inter-slot time. The
+  // packet is completed in kData, after which the next interrupt is in kIdle.
+  void addEvent(const TraceEvent &e) {
+    if (e.type == TraceEventType::kSendCompletePacket) {
+      if (prev_ != kData) {
+        badTransitions_++;
+      }
+      completedPackets_++;
+      prev_ = kIdle;
+      return;
+    }
+    if (e.type != TraceEventType::kSendIRQ || e.state > kIdle) {
+      return;
+    }
+    TXState s = static_cast<TXState>(e.state);
+    irqCounts_[s]++;
+    bool ok;
+    switch (prev_) {
+      case kIdle:
+        ok = (s == kIdle || s == kBreak);
+        break;
+      case kBreak:
+        ok = (s == kBreak || s == kData);
+        break;
+      case kData:
+        ok = (s == kData || s == kInterSlot);
+        break;
+      case kInterSlot:
+        ok = (s == kData);
+        break;
+      default:  // kMAB is handled by the timer and never by the interrupt
+        ok = false;
+        break;
+    }
+    if (!ok) {
+      badTransitions_++;
+    }
+    prev_ = s;
+  }
+
+  Sender &tx_;
+  host::LPUARTModel &uart_;
+  TXState prev_ = kIdle;
+  int completedPackets_ = 0;
+  int badTransitions_ = 0;
+  int irqCounts_[kIdle + 1]{0};
+};
+
+// Returns the complete packets, except for the first one, which is always sent
+// from the sender's initial buffer: all zeros and full size.
+inline std::vector<Packet> completePackets(const std::vector<Packet> &all) {
+  std::vector<Packet> packets;
+  for (size_t i = 1; i < all.size(); i++) {
+    if (all[i].complete) {
+      packets.push_back(all[i]);
+    }
+  }
+  return packets;
+}
+
+// Returns the achieved frame rate, in Hz, over the BREAKs of the given packets.
+// This returns zero if there are fewer than two packets.
+inline double frameRate(const std::vector<Packet> &packets) {
+  if (packets.size() < 2) {
+    return 0.0;
+  }
+  double t = packets.back().start - packets.front().start;
+  return (packets.size() - 1) * 1e6 / t;
+}
+
+#endif  // TEENSYDMX_TEST_TXCAPTURE_H_
@@ -0,0 +1,485 @@
+// Test for reading and replaying captures. Captures are read from a source
+// that only has a few bytes at a time, replayed through a real Sender into
+// a real Receiver over modelled LPUARTs, sent directly into a Receiver's RX
+// line, and fed to responders.
+//
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+// C++ includes
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <Arduino.h>
+#include <Host.h>
+#include <LPUARTModel.h>
+
+#include "Capture.h"
+#include "CaptureLine.h"
+#include "LineDriver.h"
+#include "Responder.h"
+#include "TeensyDMX.h"
+
+namespace teensydmx = ::qindesign::teensydmx;
+
+using teensydmx::CaptureFrame;
+using teensydmx::CaptureReader;
+using teensydmx::CaptureReplayer;
+using teensydmx::CaptureWriter;
+using teensydmx::kMaxDMXPacketSize;
+using teensydmx::Receiver;
+using teensydmx::Responder;
+using teensydmx::Sender;
+
+// The start code used for the responder that works a byte at a time.
+constexpr uint8_t kByteStartCode = 0xcc;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                   \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      std::printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__,    \
+                  #cond);                                             \
+      failures++;                                                     \
+    }                                                                 \
+  } while (false)
+
+// Collects a capture in memory.
+class VectorSink final : public teensydmx::CaptureSink {
+ public:
+  bool write(const uint8_t *buf, size_t len) override {
+    bytes.insert(bytes.end(), buf, buf + len);
+    return true;
+  }
+
+  std::vector<uint8_t> bytes;
+};
+
+// A source that only has the bytes it's been allowed to give so far, the way
+// a ring buffer or a serial port fills up over time.
+class TrickleSource final : public teensydmx::CaptureSource {
+ public:
+  TrickleSource(const std::vector<uint8_t> &bytes, bool isFinite)
+      : bytes_(bytes),
+        isFinite_(isFinite) {}
+
+  size_t read(uint8_t *buf, size_t len) override {
+    size_t n = std::min(len, limit_ - pos_);
+    std::copy_n(&bytes_[pos_], n, buf);
+    pos_ += n;
+    return n;
+  }
+
+  bool atEnd() override {
+    return isFinite_ && pos_ >= bytes_.size();
+  }
+
+  // Makes up to `n` more bytes available.
+  void allow(size_t n) {
+    limit_ = std::min(limit_ + n, bytes_.size());
+  }
+
+  bool allAllowed() const {
+    return limit_ >= bytes_.size();
+  }
+
+ private:
+  const std::vector<uint8_t> &bytes_;
+  const bool isFinite_;
+  size_t pos_ = 0;
+  size_t limit_ = 0;
+};
+
+// Records every packet it's given.
+class Recorder final : public Responder {
+ public:
+  void receivePacket(const uint8_t *buf, int len) override {
+    packets.emplace_back(buf, buf + len);
+  }
+
+  std::vector<std::vector<uint8_t>> packets;
+};
+
+// Works a byte at a time, like an RDM responder, and optionally responds
+// once a packet reaches a given length.
+class ByteResponder final : public Responder {
+ public:
+  explicit ByteResponder(int respondAt)
+      : respondAt_(respondAt) {}
+
+  int outputBufferSize() const override {
+    return 4;
+  }
+
+  bool eatPacket() const override {
+    return false;
+  }
+
+  int processByte(const uint8_t *buf, int len, uint8_t *outBuf) override {
+    // The length must grow by one each time, starting again at one
+    if (len != lastLen_ + 1 || buf[len - 1] != nextByte(buf, len)) {
+      badBytes++;
+    }
+    lastLen_ = len;
+    byteCount++;
+    if (len == respondAt_) {
+      outBuf[0] = 0;
+      return 1;
+    }
+    return -1;
+  }
+
+  void receivePacket(const uint8_t *buf, int len) override {
+    lastLen_ = 0;
+    packetSizes.push_back(len);
+  }
+
+  int badBytes = 0;
+  int byteCount = 0;
+  std::vector<int> packetSizes;
+
+ private:
+  // The data pattern used for this start code.
+  static uint8_t nextByte(const uint8_t *buf, int len) {
+    return (len == 1) ? kByteStartCode : static_cast<uint8_t>(len*3);
+  }
+
+  const int respondAt_;
+  int lastLen_ = 0;
+};
+
+// Makes a capture of `count` frames with random sizes and gaps. Every fourth
+// frame uses `kByteStartCode`.
+static std::vector<CaptureFrame> makeFrames(int count, uint32_t seed) {
+  std::minstd_rand rng{seed};
+  auto uniform = [&rng](int lo, int hi) {
+    return std::uniform_int_distribution<int>{lo, hi}(rng);
+  };
+
+  std::vector<CaptureFrame> frames(count);
+  uint32_t t = 1000000;
+  for (int i = 0; i < count; i++) {
+    CaptureFrame &f = frames[i];
+    int size = uniform(25, kMaxDMXPacketSize);
+    f.stats = Receiver::PacketStats{};
+    f.stats.size = size;
+    f.stats.breakTime = uniform(92, 300);
+    f.stats.mabTime = uniform(12, 40);
+    f.stats.breakPlusMABTime = f.stats.breakTime + f.stats.mabTime;
+    f.stats.packetTime = f.stats.breakPlusMABTime + size*44 + uniform(0, 200);
+    if (i % 4 == 3) {
+      f.data[0] = kByteStartCode;
+      for (int j = 1; j < size; j++) {
+        f.data[j] = static_cast<uint8_t>(j*3 + 3);
+      }
+    } else {
+      f.data[0] = 0;
+      for (int j = 1; j < size; j++) {
+        f.data[j] = static_cast<uint8_t>(uniform(0, 255));
+      }
+    }
+    f.stats.frameTimestamp = t;
+    f.stats.breakToBreakTime = (i == 0) ? 0 : t - frames[i - 1].stats.frameTimestamp;
+    t += f.stats.packetTime + uniform(100, 5000);
+  }
+  return frames;
+}
+
+// Writes frames as a capture.
+static std::vector<uint8_t> writeCapture(const std::vector<CaptureFrame> &frames) {
+  VectorSink sink;
+  CaptureWriter writer{sink};
+  CHECK(writer.begin());
+  for (const CaptureFrame &f : frames) {
+    CHECK(writer.writeFrame(f.data, f.stats.size, f.stats));
+  }
+  return sink.bytes;
+}
+
+static bool sameFrame(const CaptureFrame &a, const CaptureFrame &b) {
+  return a.stats.size == b.stats.size &&
+         a.stats.frameTimestamp == b.stats.frameTimestamp &&
+         a.stats.packetTime == b.stats.packetTime &&
+         std::equal(&a.data[0], &a.data[a.stats.size], &b.data[0]);
+}
+
+static bool samePacket(const std::vector<uint8_t> &p, const CaptureFrame &f) {
+  return static_cast<int>(p.size()) == f.stats.size &&
+         std::equal(p.begin(), p.end(), &f.data[0]);
+}
+
+// Reads a capture that arrives a few bytes at a time: an incomplete frame is
+// reported as such and kept, and the end is only reported at the end.
+static void testReaderTrickle() {
+  std::vector<CaptureFrame> frames = makeFrames(40, 1);
+  std::vector<uint8_t> bytes = writeCapture(frames);
+  TrickleSource src{bytes, true};
+  CaptureReader reader{src};
+
+  std::minstd_rand rng{2};
+  int beginTries = 0;
+  while (!reader.begin()) {
+    src.allow(3);
+    CHECK(++beginTries < 10);
+  }
+
+  CaptureFrame frame;
+  size_t next = 0;
+  int incomplete = 0;
+  while (true) {
+    src.allow(std::uniform_int_distribution<size_t>{0, 9}(rng));
+    int result = reader.readFrame(&frame);
+    if (result == -1) {
+      incomplete++;
+      CHECK(!src.atEnd());
+      continue;
+    }
+    if (result <= 0) {
+      CHECK(result == 0);
+      break;
+    }
+    CHECK(next < frames.size());
+    if (next < frames.size()) {
+      CHECK(result == frames[next].stats.size);
+      CHECK(sameFrame(frame, frames[next]));
+    }
+    next++;
+  }
+  CHECK(next == frames.size());
+  CHECK(incomplete > 100);
+  CHECK(reader.readFrame(&frame) == 0);
+}
+
+// Corrupt and truncated captures.
+static void testReaderCorrupt() {
+  std::vector<CaptureFrame> frames = makeFrames(5, 3);
+  std::vector<uint8_t> bytes = writeCapture(frames);
+  CaptureFrame frame;
+
+  // A bad size in the fourth record
+  {
+    std::vector<uint8_t> bad = bytes;
+    size_t pos = teensydmx::kCaptureHeaderSize;
+    for (int i = 0; i < 3; i++) {
+      pos += teensydmx::kCaptureRecordHeaderSize + frames[i].stats.size;
+    }
+    bad[pos] = 0;
+    bad[pos + 1] = 0;
+    teensydmx::MemoryCaptureSource src{bad.data(), bad.size()};
+    CaptureReader reader{src};
+    CHECK(reader.begin());
+    for (int i = 0; i < 3; i++) {
+      CHECK(reader.readFrame(&frame) == frames[i].stats.size);
+    }
+    CHECK(reader.readFrame(&frame) == -2);
+    CHECK(reader.readFrame(&frame) == -2);
+  }
+
+  // A truncated last record
+  {
+    teensydmx::MemoryCaptureSource src{bytes.data(), bytes.size() - 10};
+    CaptureReader reader{src};
+    CHECK(reader.begin());
+    for (int i = 0; i < 4; i++) {
+      CHECK(reader.readFrame(&frame) == frames[i].stats.size);
+    }
+    CHECK(reader.readFrame(&frame) == -2);
+  }
+
+  // Not started
+  {
+    teensydmx::MemoryCaptureSource src{bytes.data(), bytes.size()};
+    CaptureReader reader{src};
+    CHECK(reader.readFrame(&frame) == -2);
+  }
+}
+
+// Replays a capture that arrives a few bytes at a time through a Sender whose
+// TX line is wired to a Receiver's RX line. The replay waits for the data
+// instead of ending, and every frame arrives.
+static void testReplayerTrickle() {
+  std::vector<CaptureFrame> frames = makeFrames(30, 4);
+  std::vector<uint8_t> bytes = writeCapture(frames);
+  TrickleSource src{bytes, true};
+  CaptureReader reader{src};
+  CaptureReplayer replayer{reader};
+
+  host::lpuartForSerial(1).reset();
+  Receiver rx{Serial2};
+  Recorder recorder;
+  ByteResponder byteResponder{0};
+  rx.setResponder(0, &recorder);
+  rx.setResponder(kByteStartCode, &byteResponder);
+  rx.begin();
+
+  Sender tx{Serial1};
+  tx.begin();
+  host::lpuartForSerial(0).setTXListener(&host::lpuartForSerial(1));
+
+  src.allow(teensydmx::kCaptureHeaderSize);
+  CHECK(reader.begin());
+  replayer.begin(tx);
+
+  // A few bytes every 100us is much slower than the capture
+  bool ended = false;
+  for (int i = 0; i < 2000000 && !ended; i++) {
+    src.allow(5);
+    host::runFor(100000);
+    if (!replayer.poll()) {
+      ended = true;
+      CHECK(src.allAllowed());
+    }
+  }
+  CHECK(ended);
+  CHECK(replayer.frameCount() == frames.size());
+
+  // Send one more packet so that the last one is completed
+  host::runFor(50000000);
+  tx.resume();
+  host::runFor(50000000);
+  tx.end();
+  rx.end();
+  host::lpuartForSerial(0).setTXListener(nullptr);
+
+  // The receiver also saw the sender's initial packet, so look for the
+  // frames in order
+  std::vector<const CaptureFrame *> nullFrames;
+  for (const CaptureFrame &f : frames) {
+    if (f.data[0] == 0) {
+      nullFrames.push_back(&f);
+    }
+  }
+  size_t next = 0;
+  for (const auto &p : recorder.packets) {
+    if (next < nullFrames.size() && samePacket(p, *nullFrames[next])) {
+      next++;
+    }
+  }
+  CHECK(next == nullFrames.size());
+  CHECK(byteResponder.packetSizes.size() == frames.size() - nullFrames.size());
+  CHECK(byteResponder.badBytes == 0);
+}
+
+// Sends a capture straight into a Receiver's RX line with its original timing.
+static void testReceiverReplay() {
+  std::vector<CaptureFrame> frames = makeFrames(30, 5);
+  std::vector<uint8_t> bytes = writeCapture(frames);
+  teensydmx::MemoryCaptureSource src{bytes.data(), bytes.size()};
+  CaptureReader reader{src};
+  CHECK(reader.begin());
+
+  host::LPUARTModel &uart = host::lpuartForSerial(2);
+  Receiver rx{Serial3};
+  Recorder recorder;
+  ByteResponder byteResponder{0};
+  rx.setResponder(0, &recorder);
+  rx.setResponder(kByteStartCode, &byteResponder);
+  rx.begin();
+
+  LineDriver line{uart};
+  line.hold(true, 1e6);
+  CHECK(sendCapture(line, reader) == static_cast<int>(frames.size()));
+  sendCaptureEnd(line);
+
+  std::vector<int> byteSizes;
+  size_t nullCount = 0;
+  for (const CaptureFrame &f : frames) {
+    if (f.data[0] == kByteStartCode) {
+      byteSizes.push_back(f.stats.size);
+    } else {
+      CHECK(nullCount < recorder.packets.size() &&
+            samePacket(recorder.packets[nullCount], f));
+      nullCount++;
+    }
+  }
+  CHECK(recorder.packets.size() == nullCount);
+  CHECK(byteResponder.packetSizes == byteSizes);
+  CHECK(byteResponder.badBytes == 0);
+
+  // The receiver measures what the capture says. It also saw the gap to the
+  // final BREAK, which is the last packet time plus the 100us idle.
+  Receiver::TimingStats stats = rx.timingStats();
+  double total = frames.back().stats.packetTime + 100;
+  for (size_t i = 1; i < frames.size(); i++) {
+    total += frames[i].stats.breakToBreakTime;
+  }
+  CHECK(stats.breakToBreakTime.count() == frames.size());
+  CHECK(std::abs(stats.breakToBreakTime.mean()*stats.breakToBreakTime.count() -
+                 total) < 2.0*frames.size());
+  rx.end();
+}
+
+// Feeds frames to a responder directly, a byte at a time.
+static void testFeed() {
+  std::vector<CaptureFrame> frames = makeFrames(20, 6);
+  std::vector<uint8_t> bytes = writeCapture(frames);
+
+  // Without a response, the whole packet is passed along
+  {
+    teensydmx::MemoryCaptureSource src{bytes.data(), bytes.size()};
+    CaptureReader reader{src};
+    CaptureReplayer replayer{reader};
+    CHECK(reader.begin());
+    ByteResponder r{0};
+    CHECK(replayer.feed(kByteStartCode, r) == 5);
+    int total = 0;
+    for (const CaptureFrame &f : frames) {
+      if (f.data[0] == kByteStartCode) {
+        total += f.stats.size;
+      }
+    }
+    CHECK(r.byteCount == total);
+    CHECK(r.badBytes == 0);
+    CHECK(r.packetSizes.size() == 5);
+  }
+
+  // A response ends the packet
+  {
+    teensydmx::MemoryCaptureSource src{bytes.data(), bytes.size()};
+    CaptureReader reader{src};
+    CaptureReplayer replayer{reader};
+    CHECK(reader.begin());
+    ByteResponder r{10};
+    CHECK(replayer.feed(kByteStartCode, r) == 5);
+    CHECK(r.byteCount == 5*10);
+    CHECK(r.badBytes == 0);
+    CHECK(r.packetSizes == std::vector<int>(5, 10));
+  }
+
+  // A capture that arrives a few bytes at a time can be fed as it arrives
+  {
+    TrickleSource src{bytes, false};
+    CaptureReader reader{src};
+    CaptureReplayer replayer{reader};
+    ByteResponder r{0};
+    src.allow(teensydmx::kCaptureHeaderSize);
+    CHECK(reader.begin());
+    int fed = 0;
+    while (!src.allAllowed()) {
+      src.allow(50);
+      fed += replayer.feed(kByteStartCode, r);
+    }
+    CHECK(fed == 5);
+    CHECK(r.badBytes == 0);
+  }
+}
+
+int main() {
+  testReaderTrickle();
+  testReaderCorrupt();
+  testReplayerTrickle();
+  testReceiverReplay();
+  testFeed();
+
+  if (failures != 0) {
+    std::printf("%d failures\n", failures);
+    return 1;
+  }
+  std::printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,241 @@
+// Round-trip tests for DeltaEncoder and DeltaDecoder.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+// C++ includes
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include "DeltaCodec.h"
+
+namespace teensydmx = ::qindesign::teensydmx;
+
+using teensydmx::DeltaDecoder;
+using teensydmx::DeltaEncoder;
+using teensydmx::kDeltaFrame;
+using teensydmx::kDeltaKeyframe;
+using teensydmx::kMaxDeltaEncodedSize;
+using teensydmx::kMaxDMXPacketSize;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                   \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      std::printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__,    \
+                  #cond);                                             \
+      failures++;                                                     \
+    }                                                                 \
+  } while (false)
+
+// Encodes and decodes a frame, and checks that it survived. This returns the
+// encoded size.
+static int roundTrip(DeltaEncoder &enc, DeltaDecoder &dec,
+                     const uint8_t *frame, int size) {
+  uint8_t out[kMaxDeltaEncodedSize];
+  int n = enc.encode(frame, size, out);
+  CHECK(0 < n && n <= kMaxDeltaEncodedSize);
+
+  // Every prefix is incomplete and mustn't change anything
+  for (int len = 0; len < n; len++) {
+    int before = dec.size();
+    CHECK(dec.decode(out, len) == -1);
+    CHECK(dec.size() == before);
+  }
+
+  int consumed = 0;
+  CHECK(dec.decode(out, n, &consumed) == size);
+  CHECK(consumed == n);
+  CHECK(dec.size() == size);
+  CHECK(std::memcmp(dec.frame(), frame, size) == 0);
+  return n;
+}
+
+static void testStatic() {
+  DeltaEncoder enc{0};
+  DeltaDecoder dec;
+  uint8_t frame[kMaxDMXPacketSize]{0};
+  for (int i = 1; i < kMaxDMXPacketSize; i++) {
+    frame[i] = static_cast<uint8_t>(i*7);
+  }
+
+  roundTrip(enc, dec, frame, kMaxDMXPacketSize);
+  CHECK(enc.lastWasKeyframe());
+  for (int i = 0; i < 100; i++) {
+    // An unchanged frame is just the header and an empty range count
+    CHECK(roundTrip(enc, dec, frame, kMaxDMXPacketSize) == 4);
+    CHECK(!enc.lastWasKeyframe());
+  }
+}
+
+static void testSparse(std::minstd_rand &rng) {
+  DeltaEncoder enc{44};
+  DeltaDecoder dec;
+  uint8_t frame[kMaxDMXPacketSize]{0};
+  int keyframes = 0;
+
+  for (int f = 0; f < 1000; f++) {
+    // Change a few slots, some next to each other and some at the edges,
+    // so that the word-at-a-time skipping sees every alignment
+    int changes = rng() % 6;
+    for (int c = 0; c < changes; c++) {
+      int i = rng() % kMaxDMXPacketSize;
+      frame[i]++;
+    }
+    if (f % 50 == 0) {
+      frame[0]++;
+      frame[kMaxDMXPacketSize - 1]++;
+    }
+    int n = roundTrip(enc, dec, frame, kMaxDMXPacketSize);
+    if (enc.lastWasKeyframe()) {
+      keyframes++;
+    } else {
+      CHECK(n < 64);
+    }
+  }
+  CHECK(keyframes == (1000 + 43)/44);
+}
+
+static void testFullChange(std::minstd_rand &rng) {
+  DeltaEncoder enc{0};
+  DeltaDecoder dec;
+  uint8_t frame[kMaxDMXPacketSize];
+
+  for (int f = 0; f < 200; f++) {
+    for (int i = 0; i < kMaxDMXPacketSize; i++) {
+      frame[i] = static_cast<uint8_t>(rng());
+    }
+    roundTrip(enc, dec, frame, kMaxDMXPacketSize);
+  }
+
+  // Every slot changing by a constant still round-trips
+  for (int f = 0; f < 50; f++) {
+    for (int i = 0; i < kMaxDMXPacketSize; i++) {
+      frame[i]++;
+    }
+    roundTrip(enc, dec, frame, kMaxDMXPacketSize);
+  }
+}
+
+static void testSizeChange(std::minstd_rand &rng) {
+  DeltaEncoder enc{0};
+  DeltaDecoder dec;
+  uint8_t frame[kMaxDMXPacketSize]{0};
+
+  static constexpr int kSizes[]{1, 2, 3, 4, 5, 24, 25, 513, 512, 100, 1, 513};
+  for (int size : kSizes) {
+    for (int f = 0; f < 5; f++) {
+      frame[rng() % size] = static_cast<uint8_t>(rng());
+      roundTrip(enc, dec, frame, size);
+      // Small frames may always be keyframes because a delta isn't smaller
+      if (f == 0 || size > 24) {
+        CHECK(enc.lastWasKeyframe() == (f == 0));
+      }
+    }
+  }
+
+  uint8_t out[kMaxDeltaEncodedSize];
+  CHECK(enc.encode(frame, 0, out) == 0);
+  CHECK(enc.encode(frame, kMaxDMXPacketSize + 1, out) == 0);
+}
+
+static void testResync() {
+  DeltaEncoder enc{4};
+  uint8_t frame[kMaxDMXPacketSize]{0};
+  uint8_t out[8][kMaxDeltaEncodedSize];
+  int lens[8];
+  for (int f = 0; f < 8; f++) {
+    frame[10] = static_cast<uint8_t>(f);
+    lens[f] = enc.encode(frame, kMaxDMXPacketSize, out[f]);
+  }
+  CHECK(out[0][0] == kDeltaKeyframe);
+  CHECK(out[1][0] == kDeltaFrame);
+  CHECK(out[4][0] == kDeltaKeyframe);
+
+  // Starting in the middle skips deltas until the next keyframe
+  DeltaDecoder dec;
+  for (int f = 1; f < 4; f++) {
+    int consumed = 0;
+    CHECK(dec.decode(out[f], lens[f], &consumed) == 0);
+    CHECK(consumed == lens[f]);
+    CHECK(!dec.synced());
+  }
+  for (int f = 4; f < 8; f++) {
+    CHECK(dec.decode(out[f], lens[f]) == kMaxDMXPacketSize);
+    CHECK(dec.frame()[10] == f);
+  }
+}
+
+static void testCorrupt() {
+  DeltaEncoder enc{0};
+  DeltaDecoder dec;
+  uint8_t frame[kMaxDMXPacketSize]{0};
+  uint8_t key[kMaxDeltaEncodedSize];
+  uint8_t delta[kMaxDeltaEncodedSize];
+  int keyLen = enc.encode(frame, 100, key);
+  frame[50] = 1;
+  int deltaLen = enc.encode(frame, 100, delta);
+  CHECK(delta[0] == kDeltaFrame);
+
+  uint8_t bad[kMaxDeltaEncodedSize];
+
+  // Unknown type
+  CHECK(dec.decode(key, keyLen) == 100);
+  std::memcpy(bad, delta, deltaLen);
+  bad[0] = 0x7f;
+  CHECK(dec.decode(bad, deltaLen) == -2);
+  CHECK(!dec.synced());
+
+  // Bad size
+  CHECK(dec.decode(key, keyLen) == 100);
+  std::memcpy(bad, delta, deltaLen);
+  bad[1] = 0;
+  bad[2] = 0;
+  CHECK(dec.decode(bad, deltaLen) == -2);
+  CHECK(!dec.synced());
+
+  // A delta for a different size
+  CHECK(dec.decode(key, keyLen) == 100);
+  std::memcpy(bad, delta, deltaLen);
+  bad[1] = 99;
+  CHECK(dec.decode(bad, deltaLen) == -2);
+  CHECK(!dec.synced());
+
+  // A range past the end
+  CHECK(dec.decode(key, keyLen) == 100);
+  std::memcpy(bad, delta, deltaLen);
+  bad[4] = 0xff;  // Skip
+  CHECK(dec.decode(bad, deltaLen) == -2);
+  CHECK(!dec.synced());
+
+  // A keyframe run past the end
+  std::memcpy(bad, key, keyLen);
+  bad[1] = 2;
+  bad[2] = 0;
+  CHECK(dec.decode(bad, keyLen) == -2);
+  CHECK(!dec.synced());
+
+  // Still decodes afterwards
+  CHECK(dec.decode(key, keyLen) == 100);
+  CHECK(dec.decode(delta, deltaLen) == 100);
+  CHECK(dec.frame()[50] == 1);
+}
+
+int main() {
+  std::minstd_rand rng{1};
+  testStatic();
+  testSparse(rng);
+  testFullChange(rng);
+  testSizeChange(rng);
+  testResync();
+  testCorrupt();
+
+  if (failures != 0) {
+    std::printf("%d failures\n", failures);
+    return 1;
+  }
+  std::printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,330 @@
+// Fuzz test for the Receiver state machine. This drives random sequences of
+// well-formed packets, malformed packets, line noise, idle periods, and API
+// calls into the RX line of a modelled LPUART, so that the real
+// LPUARTReceiveHandler and Receiver code handle them, and checks the
+// receiver's invariants after every event. Clean packets are also checked
+// against what was received.
+//
+// Usage: receiver_fuzz_test [steps [seed]]
+//
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_CHECK_INVARIANTS
+#error "Build with TEENSYDMX_CHECK_INVARIANTS defined"
+#endif  // !TEENSYDMX_CHECK_INVARIANTS
+
+// C++ includes
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <Arduino.h>
+#include <Host.h>
+#include <LPUARTModel.h>
+
+#include "LineDriver.h"
+#include "TeensyDMX.h"
+
+namespace teensydmx = ::qindesign::teensydmx;
+
+using teensydmx::kMaxDMXPacketSize;
+using teensydmx::Receiver;
+
+// The nominal bit time at 250kbaud, in nanoseconds.
+constexpr double kBitNs = 4000.0;
+
+// The minimum packet time, and the margin for the receiver's estimates, in
+// nanoseconds.
+constexpr double kMinPacketNs = 1204e3;
+constexpr double kMarginNs = 50e3;
+
+// A fuzzing session.
+class Fuzzer final {
+ public:
+  Fuzzer(Receiver &rx, LineDriver &line, uint32_t seed)
+      : rx_(rx),
+        line_(line),
+        rng_(seed) {}
+
+  // Runs one random step.
+  void step() {
+    int r = uniform(0, 99);
+    if (r < 35) {
+      cleanPacket(false);
+    } else if (r < 45) {
+      cleanPacket(true);
+    } else if (r < 60) {
+      roughPacket();
+    } else if (r < 70) {
+      noise();
+    } else if (r < 80) {
+      idle();
+    } else if (r < 88) {
+      looseChars();
+    } else if (r < 92) {
+      longBreak();
+    } else {
+      api();
+    }
+    line_.flush();
+    yield();
+    steps_++;
+  }
+
+  uint64_t steps() const {
+    return steps_;
+  }
+
+  uint64_t checkedPackets() const {
+    return checkedPackets_;
+  }
+
+  uint64_t mismatches() const {
+    return mismatches_;
+  }
+
+ private:
+  int uniform(int lo, int hi) {
+    return std::uniform_int_distribution<int>{lo, hi}(rng_);
+  }
+
+  double uniformReal(double lo, double hi) {
+    return std::uniform_real_distribution<double>{lo, hi}(rng_);
+  }
+
+  bool chance(int percent) {
+    return uniform(0, 99) < percent;
+  }
+
+  // Sends a packet that meets the receive timing, optionally followed by a
+  // BREAK, MAB, and start code, after which the packet is checked.
+  void cleanPacket(bool check) {
+    double bitNs = kBitNs * uniformReal(0.99, 1.01);
+    double breakNs = chance(80) ? uniformReal(92e3, 250e3)
+                                : uniformReal(92e3, 5e6);
+    double mabNs = chance(80) ? uniformReal(12e3, 40e3)
+                              : uniformReal(12e3, 500e3);
+    int size = chance(70) ? uniform(25, kMaxDMXPacketSize)
+                          : uniform(1, kMaxDMXPacketSize);
+    double interSlotNs = chance(70) ? 0.0 : uniformReal(0.0, 40e3);
+
+    std::vector<uint8_t> data(size);
+    data[0] = chance(80) ? 0 : static_cast<uint8_t>(uniform(0, 255));
+    for (int i = 1; i < size; i++) {
+      data[i] = static_cast<uint8_t>(uniform(0, 255));
+    }
+
+    // A BREAK that starts while a character is still arriving is only seen as
+    // a framing error, so give any earlier noise time to finish
+    if (check) {
+      line_.hold(true, 100e3);
+    }
+
+    double start = line_.time();
+    line_.hold(false, breakNs);
+    line_.hold(true, mabNs);
+    for (int i = 0; i < size; i++) {
+      line_.sendChar(data[i], bitNs, 2, false);
+      if (i + 1 < size) {
+        line_.hold(true, interSlotNs);
+      }
+    }
+    double end = line_.time();
+    line_.hold(true, uniformReal(0.0, 100e3));
+
+    if (!check) {
+      return;
+    }
+
+    // A following BREAK completes the packet when the start code arrives. The
+    // start code is only seen after the line is idle for a character.
+    double nextBreak = line_.time();
+    line_.hold(false, 100e3);
+    line_.hold(true, 20e3);
+    line_.sendChar(0, kBitNs, 2, false);
+    line_.hold(true, 100e3);
+    line_.flush();
+
+    // Packets shorter than the minimum BREAK-to-BREAK time, or whose slots end
+    // before that time, are discarded. The receiver only estimates when the
+    // BREAK started, so leave some margin.
+    if (nextBreak - start < kMinPacketNs + kMarginNs ||
+        end - start < kMinPacketNs + kMarginNs ||
+        end - start > 1e9) {
+      return;
+    }
+
+    uint8_t buf[kMaxDMXPacketSize];
+    int n = rx_.readPacket(buf, 0, kMaxDMXPacketSize);
+    checkedPackets_++;
+    if (n != size || std::memcmp(buf, data.data(), size) != 0) {
+      mismatches_++;
+      if (mismatches_ <= 5) {
+        std::printf("step %llu: sent %d slots, read %d\n",
+                    static_cast<unsigned long long>(steps_), size, n);
+      }
+    }
+  }
+
+  // Sends a packet with timing and framing problems.
+  void roughPacket() {
+    double bitNs = kBitNs * uniformReal(0.9, 1.1);
+    line_.hold(false, uniformReal(1e3, 130e3));
+    line_.hold(true, uniformReal(0.0, 20e3));
+    int size = uniform(0, 600);
+    for (int i = 0; i < size; i++) {
+      if (chance(2)) {
+        line_.hold(false, uniformReal(100.0, 10e3));  // Glitch
+        line_.hold(true, uniformReal(100.0, 10e3));
+      }
+      line_.sendChar(static_cast<uint8_t>(uniform(0, 255)), bitNs,
+                     uniform(1, 2), chance(3));
+      if (chance(5)) {
+        line_.hold(true, uniformReal(0.0, 200e3));
+      }
+    }
+    line_.hold(true, uniformReal(0.0, 50e3));
+  }
+
+  // Short pulses on the line.
+  void noise() {
+    int count = uniform(1, 50);
+    for (int i = 0; i < count; i++) {
+      line_.hold(false, uniformReal(50.0, 50e3));
+      line_.hold(true, uniformReal(50.0, 50e3));
+    }
+  }
+
+  // An idle line, occasionally long enough to time out.
+  void idle() {
+    if (chance(3)) {
+      line_.hold(true, uniformReal(1.0e9, 1.5e9));
+    } else {
+      line_.hold(true, uniformReal(0.0, 5e6));
+    }
+  }
+
+  // Characters without a BREAK, some with framing errors, including zero.
+  void looseChars() {
+    int count = uniform(1, 20);
+    for (int i = 0; i < count; i++) {
+      line_.sendChar(chance(20) ? 0 : static_cast<uint8_t>(uniform(0, 255)),
+                     kBitNs, 2, chance(20));
+      line_.hold(true, uniformReal(0.0, 100e3));
+    }
+  }
+
+  // A BREAK of up to 20ms.
+  void longBreak() {
+    line_.hold(false, uniformReal(250e3, 20e6));
+    line_.hold(true, uniformReal(0.0, 1e6));
+  }
+
+  // Calls into the receiver's API.
+  void api() {
+    uint8_t buf[kMaxDMXPacketSize];
+    switch (uniform(0, 7)) {
+      case 0:
+        rx_.readPacket(buf, uniform(0, 600), uniform(0, 600));
+        break;
+      case 1:
+        rx_.get(uniform(-1, 600));
+        break;
+      case 2:
+        rx_.packetStats();
+        rx_.errorStats();
+        rx_.timingStats();
+        break;
+      case 3:
+        rx_.setKeepShortPackets(!rx_.isKeepShortPackets());
+        break;
+      case 4:
+        rx_.refreshRateEstimate();
+        rx_.breakToBreakHistogram();
+        break;
+      case 5:
+        rx_.resetTimingStats();
+        rx_.resetBreakToBreakHistogram();
+        break;
+      case 6:
+        if (chance(10)) {
+          rx_.end();
+          rx_.begin();
+        }
+        break;
+      default:
+        rx_.readPacket(buf, 0, kMaxDMXPacketSize);
+        break;
+    }
+  }
+
+  Receiver &rx_;
+  LineDriver &line_;
+  std::minstd_rand rng_;
+  uint64_t steps_ = 0;
+  uint64_t checkedPackets_ = 0;
+  uint64_t mismatches_ = 0;
+};
+
+static uint64_t packetReadyCount = 0;
+
+int main(int argc, char *argv[]) {
+  long steps = (argc > 1) ? std::strtol(argv[1], nullptr, 0) : 20000;
+  uint32_t seed = (argc > 2) ? std::strtoul(argv[2], nullptr, 0) : 1;
+
+  host::LPUARTModel &uart = host::lpuartForSerial(0);
+  Receiver rx{Serial1};
+  rx.onPacketReady([](Receiver *r) {
+    static_cast<void>(r);
+    packetReadyCount++;
+  });
+  rx.setKeepShortPackets(false);
+  rx.begin();
+
+  LineDriver line{uart};
+  Fuzzer fuzzer{rx, line, seed};
+
+  auto wallStart = std::chrono::steady_clock::now();
+  uint64_t simStart = host::now();
+  uint64_t isrStart = uart.isrCount();
+  for (long i = 0; i < steps; i++) {
+    fuzzer.step();
+  }
+  double wall = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - wallStart)
+                    .count();
+  double sim = (host::now() - simStart) / 1e9;
+  uint64_t isrs = uart.isrCount() - isrStart;
+
+  Receiver::ErrorStats errors = rx.errorStats();
+  std::printf("seed %lu: %llu steps, %.1fs simulated, %.2fs wall\n",
+              static_cast<unsigned long>(seed),
+              static_cast<unsigned long long>(fuzzer.steps()), sim, wall);
+  std::printf("%llu UART interrupts, %.0f events/s\n",
+              static_cast<unsigned long long>(isrs), isrs / wall);
+  std::printf("packets ready: %llu, checked: %llu, mismatches: %llu\n",
+              static_cast<unsigned long long>(packetReadyCount),
+              static_cast<unsigned long long>(fuzzer.checkedPackets()),
+              static_cast<unsigned long long>(fuzzer.mismatches()));
+  std::printf("errors: timeouts=%lu framing=%lu short=%lu long=%lu\n",
+              static_cast<unsigned long>(errors.packetTimeoutCount),
+              static_cast<unsigned long>(errors.framingErrorCount),
+              static_cast<unsigned long>(errors.shortPacketCount),
+              static_cast<unsigned long>(errors.longPacketCount));
+  std::printf("invariant violations: %lu (last: %d)\n",
+              static_cast<unsigned long>(rx.invariantViolationCount()),
+              static_cast<int>(rx.lastInvariantViolation()));
+
+  if (rx.invariantViolationCount() != 0 || fuzzer.mismatches() != 0 ||
+      fuzzer.checkedPackets() == 0) {
+    std::printf("FAILED\n");
+    return 1;
+  }
+  std::printf("OK\n");
+  return 0;
+}
@@ -0,0 +1,136 @@
+// Characterizes the Sender on the host, the same way the TimingSweep example
+// does on a Teensy, by sweeping packet size, BREAK and MAB times, inter-slot
+// MARK time, and MBB time. The real Sender and LPUARTSendHandler run against
+// the LPUART model, and the waveform on the TX line is decoded.
+//
+// The output is the same comma-separated table as the example's, with these
+// differences, because the simulated ISRs take no simulated time:
+// * The "isr/frame" column is the number of send interrupts per frame, from
+//   the trace, instead of a time.
+// * The "isr load" column is replaced by "host load", the host's wall time
+//   spent running the simulation as a percentage of the simulated time.
+// * The "copy" column is the host's wall time for `setPacketSizeAndData()`.
+//
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+// C++ includes
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include <Arduino.h>
+#include <Host.h>
+#include <LPUARTModel.h>
+
+#include "TeensyDMX.h"
+#include "TXCapture.h"
+
+namespace teensydmx = ::qindesign::teensydmx;
+
+using teensydmx::kMaxDMXPacketSize;
+using teensydmx::util::TXTiming;
+
+// How long to measure each combination of settings, in milliseconds.
+constexpr double kMeasureTime = 1000.0;
+
+// How many times to copy a packet when timing the copy.
+constexpr int kCopyCount = 1000;
+
+// The packet sizes to try.
+constexpr int kPacketSizes[]{25, 50, 100, 150, 200, 300, 400, 513};
+
+// BREAK and MAB settings to try. A BREAK time of zero means "use the
+// default serial parameters" instead of a timer.
+struct BreakSettings {
+  uint32_t breakTime;
+  uint32_t mabTime;
+};
+constexpr BreakSettings kBreakSettings[]{
+    {0, 0},     // Serial parameters, ~180us BREAK and ~20us MAB
+    {92, 12},   // Timer, minimum allowed times
+    {180, 20},  // Timer, typical times
+};
+
+// Inter-slot MARK times to try.
+constexpr uint32_t kInterSlotTimes[]{0, 4};
+
+// MBB times to try.
+constexpr uint32_t kMBBTimes[]{0, 100};
+
+// Measures one combination of settings and prints a row.
+static void measure(const uint8_t *data, int size, const BreakSettings &b,
+                    uint32_t interSlotTime, uint32_t mbbTime) {
+  using Clock = std::chrono::steady_clock;
+
+  Sender tx{Serial1};
+  if (b.breakTime == 0) {
+    tx.setBreakUseTimerNotSerial(false);
+  } else {
+    tx.setBreakUseTimerNotSerial(true);
+    tx.setBreakTime(b.breakTime);
+    tx.setMABTime(b.mabTime);
+  }
+  tx.setInterSlotTime(interSlotTime);
+  tx.setMBBTime(mbbTime);
+
+  // Copy cost
+  Clock::time_point t = Clock::now();
+  for (int i = 0; i < kCopyCount; i++) {
+    tx.setPacketSizeAndData(size, 0, data, size);
+  }
+  double copyUs =
+      std::chrono::duration<double, std::micro>(Clock::now() - t).count() /
+      kCopyCount;
+
+  Capture cap{tx};
+  tx.begin();
+  t = Clock::now();
+  cap.run(kMeasureTime);
+  double wallUs =
+      std::chrono::duration<double, std::micro>(Clock::now() - t).count();
+  tx.end();
+
+  std::vector<Packet> packets = completePackets(cap.packets());
+  double irqsPerFrame = 0.0;
+  if (cap.completedPackets() > 0) {
+    irqsPerFrame = double(cap.irqCount()) / cap.completedPackets();
+  }
+
+  TXTiming timing = tx.timing();
+  std::printf("%d,%lu,%lu,%lu,%lu,%.2f,%.2f,%.2f,%.2f,%.2f,%lx\n",
+              size,
+              static_cast<unsigned long>(timing.breakTime),
+              static_cast<unsigned long>(timing.mabTime),
+              static_cast<unsigned long>(interSlotTime),
+              static_cast<unsigned long>(mbbTime),
+              timing.frameRate(),
+              frameRate(packets),
+              irqsPerFrame,
+              wallUs / (10.0 * kMeasureTime),  // Percent of simulated time
+              copyUs,
+              static_cast<unsigned long>(timing.violations()));
+}
+
+int main() {
+  uint8_t data[kMaxDMXPacketSize];
+  for (int i = 0; i < kMaxDMXPacketSize; i++) {
+    data[i] = i;
+  }
+  data[0] = 0;  // Start code
+
+  std::printf("size,break(us),mab(us),interslot(us),mbb(us),"
+              "model(Hz),measured(Hz),isr/frame(irqs),host load(%%),"
+              "copy(us),limits\n");
+  for (const BreakSettings &b : kBreakSettings) {
+    for (uint32_t interSlotTime : kInterSlotTimes) {
+      for (uint32_t mbbTime : kMBBTimes) {
+        for (int size : kPacketSizes) {
+          measure(data, size, b, interSlotTime, mbbTime);
+        }
+      }
+    }
+  }
+  return 0;
+}
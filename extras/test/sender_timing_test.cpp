@@ -0,0 +1,509 @@
+// Timing test for the Sender. This runs the real Sender and LPUARTSendHandler
+// against a model of the Teensy 4 LPUART, decodes the waveform on the TX line,
+// and checks it against the ANSI E1.11 transmitter limits, the sender's
+// settings, and the `Sender::timing()` model. The send interrupts are traced
+// and their states checked against the handler's state machine.
+//
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+// C++ includes
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include <Arduino.h>
+#include <Host.h>
+#include <LPUARTModel.h>
+
+#include "TeensyDMX.h"
+#include "TXCapture.h"
+
+namespace teensydmx = ::qindesign::teensydmx;
+
+using teensydmx::kMaxDMXPacketSize;
+using teensydmx::Sender;
+using teensydmx::util::TXTiming;
+
+// How far the timer-generated times may be from their settings, in
+// microseconds. The model has no interrupt overhead, so this only covers the
+// built-in timer corrections.
+constexpr double kTimerTolerance = 5.0;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                   \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      std::printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__,    \
+                  #cond);                                             \
+      failures++;                                                     \
+    }                                                                 \
+  } while (false)
+
+// What a packet should look like.
+struct Expected {
+  double breakTime;        // In microseconds
+  double breakTolerance;   // In microseconds
+  double mabTime;          // In microseconds
+  double mabTolerance;     // In microseconds
+  double interSlotMin;     // In microseconds
+  double interSlotMax;     // In microseconds
+};
+
+// Checks the complete packets against the E1.11 transmitter limits and the
+// expected values, and the trace against the packets. The slots are checked
+// against `data`; the packet sizes are checked by the caller. This returns
+// the checked packets.
+static std::vector<Packet> checkPackets(const char *name, const Capture &cap,
+                                        const uint8_t *data,
+                                        const Expected &exp) {
+  std::vector<Packet> all = cap.packets();
+  std::vector<Packet> packets = completePackets(all);
+  CHECK(packets.size() >= 2);
+
+  int bad = 0;
+  for (const Packet &p : packets) {
+    bool ok = true;
+
+    // ANSI E1.11 transmitter limits
+    ok = ok && p.breakTime >= 92.0;
+    ok = ok && 12.0 <= p.mabTime && p.mabTime < 1e6;
+    ok = ok && p.mbbTime < 1e6;
+    ok = ok && p.breakToBreakTime <= 1e6;
+    ok = ok && p.framingErrors == 0 && p.bitErrors == 0;
+    for (double t : p.interSlotTimes) {
+      ok = ok && t < 1e6;
+    }
+
+    // The settings
+    ok = ok && std::fabs(p.breakTime - exp.breakTime) <= exp.breakTolerance;
+    ok = ok && std::fabs(p.mabTime - exp.mabTime) <= exp.mabTolerance;
+    for (double t : p.interSlotTimes) {
+      ok = ok && exp.interSlotMin <= t && t <= exp.interSlotMax;
+    }
+    ok = ok && !p.slots.empty() &&
+         std::equal(p.slots.begin(), p.slots.end(), &data[0]);
+
+    if (!ok) {
+      if (bad++ < 3) {
+        double minISL = p.interSlotTimes.empty()
+                            ? 0.0
+                            : *std::min_element(p.interSlotTimes.begin(),
+                                                p.interSlotTimes.end());
+        double maxISL = p.interSlotTimes.empty()
+                            ? 0.0
+                            : *std::max_element(p.interSlotTimes.begin(),
+                                                p.interSlotTimes.end());
+        std::printf("%s: packet at %.1fus: break=%.2f mab=%.2f "
+                    "interslot=%.2f..%.2f mbb=%.2f slots=%zu "
+                    "framing=%d bits=%d\n",
+                    name, p.start, p.breakTime, p.mabTime, minISL, maxISL,
+                    p.mbbTime, p.slots.size(), p.framingErrors, p.bitErrors);
+      }
+    }
+  }
+  CHECK(bad == 0);
+
+  // Every sent packet, maybe except the last, was completed by the handler
+  int sent = static_cast<int>(all.size());
+  CHECK(sent - 1 <= cap.completedPackets() && cap.completedPackets() <= sent);
+  CHECK(cap.badTransitions() == 0);
+  CHECK(cap.irqCount(kMAB) == 0);
+  return packets;
+}
+
+// Checks the waveform against the `Sender::timing()` model. A packet may take
+// up to `shorter` microseconds less than the model says and up to `longer`
+// microseconds more, and the model must flag a too-short BREAK-to-BREAK time
+// exactly when the line shows one.
+static void checkModel(const char *name, const std::vector<Packet> &packets,
+                       const TXTiming &timing, double shorter, double longer) {
+  for (const Packet &p : packets) {
+    double packetTime = p.end - p.start;
+    bool ok = timing.packetTime() <= packetTime + shorter &&
+              packetTime <= timing.packetTime() + longer;
+    bool tooShort = p.breakToBreakTime < 1204.0;
+    bool modelTooShort =
+        (timing.violations() & teensydmx::util::kTXBreakToBreakTooShort) != 0;
+    ok = ok && (tooShort == modelTooShort);
+    if (!ok) {
+      std::printf("%s: packet time %.2fus, model %luus; "
+                  "BREAK-to-BREAK %.2fus, model %luus\n",
+                  name, packetTime,
+                  static_cast<unsigned long>(timing.packetTime()),
+                  p.breakToBreakTime,
+                  static_cast<unsigned long>(timing.breakToBreakTime()));
+      CHECK(ok);
+      return;
+    }
+  }
+}
+
+// Fills the packet data with something recognizable.
+static void fillData(uint8_t *data, int size) {
+  data[0] = 0;
+  for (int i = 1; i < size; i++) {
+    data[i] = static_cast<uint8_t>(i*7 + 3);
+  }
+}
+
+// The serial-parameters BREAK: the BREAK and MAB come from sending a zero at
+// a slower baud rate.
+static void testSerialBreak(uint32_t baud, uint32_t format) {
+  uint8_t data[kMaxDMXPacketSize];
+  fillData(data, kMaxDMXPacketSize);
+
+  Sender tx{Serial1};
+  CHECK(tx.setBreakSerialParams(baud, format));
+
+  // Bad parameters don't replace good ones
+  CHECK(!tx.setBreakSerialParams(0, format));
+  CHECK(!tx.setBreakSerialParams(baud, format | 0x20));  // TXINV
+  CHECK(!tx.setBreakSerialParams(baud, 0xffff));
+  CHECK(tx.breakSerialBaud() == baud);
+  CHECK(tx.breakSerialFormat() == format);
+  tx.setBreakUseTimerNotSerial(false);
+  tx.set(0, data, kMaxDMXPacketSize);
+  Capture cap{tx};
+  tx.begin();
+  cap.run(100);
+  tx.end();
+
+  TXTiming timing = tx.timing();
+  double bitTime = 1e6 / baud;
+  std::vector<Packet> packets = checkPackets(
+      "serial BREAK", cap, data,
+      Expected{double(timing.breakTime), bitTime,
+               double(timing.mabTime), bitTime,
+               0.0, 0.5});
+  for (const Packet &p : packets) {
+    CHECK(p.slots.size() == kMaxDMXPacketSize);
+  }
+  checkModel("serial BREAK", packets, timing, 0.0, bitTime + 2.0);
+  CHECK(cap.irqCount(kInterSlot) == 0);
+}
+
+// The timer BREAK: the line is inverted for the BREAK and then released for
+// the MAB.
+static void testTimerBreak(uint32_t breakTime, uint32_t mabTime) {
+  uint8_t data[kMaxDMXPacketSize];
+  fillData(data, kMaxDMXPacketSize);
+
+  Sender tx{Serial1};
+  tx.setBreakUseTimerNotSerial(true);
+  tx.setBreakTime(breakTime);
+  tx.setMABTime(mabTime);
+  tx.setPacketSize(100);
+  tx.set(0, data, 100);
+  Capture cap{tx};
+  tx.begin();
+  cap.run(50);
+  tx.end();
+
+  TXTiming timing = tx.timing();
+  CHECK(timing.breakTime == breakTime);
+  CHECK(timing.mabTime == mabTime);
+  std::vector<Packet> packets = checkPackets(
+      "timer BREAK", cap, data,
+      Expected{double(breakTime), kTimerTolerance,
+               double(mabTime), kTimerTolerance,
+               0.0, 0.5});
+  for (const Packet &p : packets) {
+    CHECK(p.slots.size() == 100);
+  }
+  checkModel("timer BREAK", packets, timing, 2*kTimerTolerance,
+             2*kTimerTolerance);
+}
+
+// The automatic packet size: trailing zeros aren't sent, and the size only
+// grows.
+static void testAutoPacketSize() {
+  uint8_t data[kMaxDMXPacketSize]{0};
+  data[10] = 1;
+  data[37] = 2;
+
+  Sender tx{Serial1};
+  tx.set(0, data, kMaxDMXPacketSize);
+  tx.setAutoPacketSize(true);
+  tx.setRefreshRate(200.0f);
+  Capture cap{tx};
+  tx.begin();
+  cap.run(50);
+  CHECK(tx.timing().packetSize == 38);
+
+  // Grow the packet, and then shrink the data, which doesn't shrink it
+  tx.set(100, 3);
+  cap.run(30);
+  tx.set(100, 0);
+  tx.set(37, 0);
+  cap.run(30);
+  tx.end();
+  CHECK(tx.timing().packetSize == 101);
+
+  std::vector<Packet> packets = completePackets(cap.packets());
+  CHECK(packets.size() >= 10);
+  size_t last = 0;
+  int grown = 0;
+  for (const Packet &p : packets) {
+    size_t n = p.slots.size();
+    CHECK(n == 38 || n == 101);
+    CHECK(n >= last);
+    last = n;
+    if (n == 101) {
+      grown++;
+      CHECK(p.slots[100] == 3 || p.slots[100] == 0);
+    }
+    CHECK(p.slots[10] == 1);
+    CHECK(p.breakTime >= 92.0 && p.mabTime >= 12.0);
+    CHECK(p.breakToBreakTime >= 1204.0);
+    CHECK(p.framingErrors == 0 && p.bitErrors == 0);
+  }
+  CHECK(grown >= 5);
+
+  // The refresh rate holds
+  for (const Packet &p : packets) {
+    CHECK(std::fabs(p.breakToBreakTime - 5000.0) <= 2.0);
+  }
+
+  // And the stats agree, without a partial snapshot outside an ISR
+  Sender::TXStats stats = tx.txStats();
+  CHECK(!stats.isPartial);
+  CHECK(stats.frameCount >= packets.size());
+  CHECK(std::fabs(stats.lastBreakToBreakTimeNs - 5000e3) <= 2e3);
+}
+
+// The inter-slot MARK time, made either by the UART, with extra MARK bits in
+// each slot and idle characters, or by a timer.
+static void testInterSlot(uint32_t t, bool useTimer) {
+  constexpr int kSize = 60;
+  uint8_t data[kMaxDMXPacketSize];
+  fillData(data, kSize);
+
+  Sender tx{Serial1};
+  tx.setInterSlotUseTimer(useTimer);
+  tx.setInterSlotTime(t);
+  tx.setPacketSize(kSize);
+  tx.set(0, data, kSize);
+  Capture cap{tx};
+  tx.begin();
+  cap.run(120);
+  tx.end();
+
+  const char *name = useTimer ? "timer inter-slot" : "UART inter-slot";
+  TXTiming timing = tx.timing();
+  std::vector<Packet> packets;
+  if (useTimer) {
+    packets = checkPackets(name, cap, data,
+                           Expected{double(timing.breakTime), 4.0,
+                                    double(timing.mabTime), 4.0,
+                                    t - kTimerTolerance, t + kTimerTolerance});
+    CHECK(timing.interSlotTime == t);
+    CHECK(cap.irqCount(kInterSlot) > 0);
+    checkModel(name, packets, timing, (kSize - 1)*kTimerTolerance,
+               (kSize - 1)*kTimerTolerance + 4.0);
+  } else {
+    // The UART rounds up to whole bits, and at most by a character, and the
+    // model knows by how much
+    CHECK(t <= timing.interSlotTime &&
+          timing.interSlotTime <= t + kSlotNs/1000.0);
+    packets = checkPackets(name, cap, data,
+                           Expected{double(timing.breakTime), 4.0,
+                                    double(timing.mabTime), 4.0,
+                                    double(timing.interSlotTime),
+                                    double(timing.interSlotTime)});
+    CHECK(cap.irqCount(kInterSlot) == 0);
+
+    // Each MARK is the same whole number of bits
+    for (const Packet &p : packets) {
+      for (double isl : p.interSlotTimes) {
+        CHECK(std::fabs(isl - p.interSlotTimes[0]) < 0.01);
+        double bits = isl*1000.0 / kBitNs;
+        CHECK(std::fabs(bits - std::round(bits)) < 0.01);
+      }
+    }
+    checkModel(name, packets, timing, 0.0, 2.0);
+  }
+  for (const Packet &p : packets) {
+    CHECK(p.slots.size() == kSize);
+  }
+}
+
+// A packet too short for the minimum BREAK-to-BREAK time, with no refresh
+// rate limit, is flagged by the model and is too short on the line.
+static void testShortPacket() {
+  uint8_t data[2]{0, 0x55};
+
+  Sender tx{Serial1};
+  tx.setPacketSizeAndData(2, 0, data, 2);
+  Capture cap{tx};
+  tx.begin();
+  cap.run(40);
+  tx.end();
+
+  TXTiming timing = tx.timing();
+  CHECK((timing.violations() & teensydmx::util::kTXBreakToBreakTooShort) != 0);
+  std::vector<Packet> packets = checkPackets(
+      "short packet", cap, data,
+      Expected{double(timing.breakTime), 20.0,
+               double(timing.mabTime), 20.0,
+               0.0, 0.5});
+  checkModel("short packet", packets, timing, 0.0, 22.0);
+}
+
+// The achieved BREAK-to-BREAK rate for each packet size, at full speed, is the
+// rate that `TXTiming::frameRate()` says. The MBB and an inter-slot MARK made
+// by the UART are included.
+static void testFrameRates(uint32_t interSlotTime, uint32_t mbbTime) {
+  constexpr int kSizes[]{25, 50, 100, 200, 300, 400, 513};
+  constexpr int kFrames = 20;
+  uint8_t data[kMaxDMXPacketSize];
+  fillData(data, kMaxDMXPacketSize);
+
+  std::printf("Rates (Hz) for interslot=%luus mbb=%luus, measured/model:",
+              static_cast<unsigned long>(interSlotTime),
+              static_cast<unsigned long>(mbbTime));
+  for (int size : kSizes) {
+    Sender tx{Serial1};
+    tx.setInterSlotUseTimer(false);
+    tx.setInterSlotTime(interSlotTime);
+    tx.setMBBTime(mbbTime);
+    tx.setPacketSizeAndData(size, 0, data, size);
+    Capture cap{tx};
+    tx.begin();
+    TXTiming timing = tx.timing();
+
+    // Leave time for the initial full-size packet
+    TXTiming initial = timing;
+    initial.packetSize = kMaxDMXPacketSize;
+    cap.run(((kFrames + 1)*timing.breakToBreakTime() +
+             initial.breakToBreakTime()) / 1000.0);
+    tx.end();
+
+    std::vector<Packet> packets = completePackets(cap.packets());
+    CHECK(packets.size() >= kFrames);
+    double rate = frameRate(packets);
+    std::printf(" %d:%.2f/%.2f", size, rate, timing.frameRate());
+
+    // The MBB timer may be short by its calibration, and each packet may be
+    // long by up to a bit
+    double period = 1e6 / rate;
+    if (!(std::fabs(period - timing.breakToBreakTime()) <= kTimerTolerance)) {
+      std::printf("\n%d slots: BREAK-to-BREAK %.2fus, model %luus\n", size,
+                  period,
+                  static_cast<unsigned long>(timing.breakToBreakTime()));
+      CHECK(false);
+    }
+  }
+  std::printf("\n");
+}
+
+// BREAKs follow a fixed schedule at the refresh rate, so that neither the
+// fractional part of the period nor interrupt latency accumulates.
+static void testRefreshRateDrift() {
+  constexpr float kRate = 30.0f;
+  constexpr double kPeriod = 1e6 / kRate;  // In microseconds
+  constexpr double kMaxLatency = 5.0;      // In microseconds
+  uint8_t data[25]{0};
+
+  host::LPUARTModel &uart = host::lpuartForSerial(0);
+  uart.setISRLatency(0, static_cast<uint64_t>(kMaxLatency*1000.0));
+
+  Sender tx{Serial1};
+  tx.setPacketSizeAndData(25, 0, data, 25);
+  tx.setRefreshRate(kRate);
+  Capture cap{tx};
+  tx.begin();
+  cap.run(100000);
+  tx.end();
+  uart.setISRLatency(host::kISRLatency, host::kISRLatency);
+
+  std::vector<Packet> packets = completePackets(cap.packets());
+  CHECK(packets.size() >= 2900);
+  if (packets.size() < 2) {
+    return;
+  }
+
+  // Every BREAK is within the timer's microsecond resolution and the latency
+  // of where it belongs
+  double first = packets[0].start;
+  double worst = 0.0;
+  for (size_t i = 0; i < packets.size(); i++) {
+    double offset = packets[i].start - (first + i*kPeriod);
+    worst = std::max(worst, std::fabs(offset));
+    CHECK(-1.0 - kMaxLatency <= offset && offset <= 1.0 + kMaxLatency);
+  }
+
+  // The long-term rate is the requested one; a truncated period would be off
+  // by 10ppm
+  double period = (packets.back().start - first) / (packets.size() - 1);
+  double ppm = (period - kPeriod) / kPeriod * 1e6;
+  CHECK(std::fabs(ppm) < 0.1);
+  std::printf("30Hz over %zu frames: worst BREAK offset %.2fus, "
+              "rate error %.4fppm\n",
+              packets.size(), worst, ppm);
+}
+
+// The running stats hold up when the refresh rate drops from 44Hz to one frame
+// every 2.5s, far enough apart that squared nanoseconds would overflow.
+static void testLowRateStats() {
+  uint8_t data[25]{0};
+
+  Sender tx{Serial1};
+  tx.setPacketSizeAndData(25, 0, data, 25);
+  tx.setRefreshRate(44.0f);
+  Capture cap{tx};
+  tx.begin();
+  cap.run(1000);
+  tx.setRefreshRate(0.4f);
+  cap.run(60000);
+  tx.end();
+
+  Sender::TXStats stats = tx.txStats();
+  const teensydmx::util::RunningStat &b2b = stats.breakToBreakTime;
+  CHECK(b2b.count() >= 60);
+  CHECK(std::fabs(b2b.max() - 2.5e6) <= 25.0);  // Within 10ppm
+  CHECK(b2b.mean() > 22727.0f && b2b.mean() < 2.5e6f);
+  CHECK(std::isfinite(b2b.stddev()) && b2b.stddev() > 0.0f);
+  CHECK(std::fabs(stats.lastBreakToBreakTimeNs - 2.5e9) <= 25e3);
+}
+
+int main() {
+  // Defaults: 50000 baud 8N1, a 180us BREAK and a 20us MAB
+  testSerialBreak(50000, SERIAL_8N1);
+  // 9 bits for the BREAK and 2 for the MAB
+  testSerialBreak(50000, SERIAL_8N2);
+  // 10 bits for the BREAK and 1 for the MAB
+  testSerialBreak(45455, SERIAL_8E1);
+
+  testTimerBreak(180, 20);
+  testTimerBreak(100, 16);
+  testTimerBreak(500, 100);
+
+  testAutoPacketSize();
+
+  for (uint32_t t : {1, 4, 5, 8, 12, 40, 44, 100}) {
+    testInterSlot(t, false);
+  }
+  testInterSlot(20, true);
+  testInterSlot(100, true);
+
+  testShortPacket();
+
+  testFrameRates(0, 0);
+  testFrameRates(0, 100);
+  testFrameRates(4, 0);
+  testFrameRates(12, 100);
+
+  testRefreshRateDrift();
+  testLowRateStats();
+
+  if (failures != 0) {
+    std::printf("%d failures\n", failures);
+    return 1;
+  }
+  std::printf("OK\n");
+  return 0;
+}
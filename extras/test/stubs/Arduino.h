@@ -0,0 +1,11 @@
+// Arduino.h is a host stand-in for the Teensy core's main header.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_TEST_STUBS_ARDUINO_H_
+#define TEENSYDMX_TEST_STUBS_ARDUINO_H_
+
+#include "HardwareSerial.h"
+#include "core_pins.h"
+
+#endif  // TEENSYDMX_TEST_STUBS_ARDUINO_H_
@@ -0,0 +1,58 @@
+// EventResponder.h is a host stand-in for the Teensy core's EventResponder.
+// Triggered events run on the next call to `yield()`.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_TEST_STUBS_EVENTRESPONDER_H_
+#define TEENSYDMX_TEST_STUBS_EVENTRESPONDER_H_
+
+// C++ includes
+#include <cstdint>
+
+class EventResponder;
+typedef EventResponder &EventResponderRef;
+typedef void (*EventResponderFunction)(EventResponderRef);
+
+class EventResponder {
+ public:
+  EventResponder() = default;
+  ~EventResponder() {
+    detach();
+  }
+
+  EventResponder(const EventResponder &) = delete;
+  EventResponder &operator=(const EventResponder &) = delete;
+
+  void attach(EventResponderFunction function) {
+    attachInterrupt(function);
+  }
+
+  void attachInterrupt(EventResponderFunction function, uint8_t priority = 128);
+
+  void detach();
+
+  void triggerEvent(int status = 0, void *data = nullptr);
+
+  void clearEvent() {
+    pending_ = false;
+  }
+
+  void setContext(void *context) {
+    context_ = context;
+  }
+
+  void *getContext() {
+    return context_;
+  }
+
+  // Runs all pending events. This is called from `yield()`.
+  static void runPending();
+
+ private:
+  EventResponderFunction function_ = nullptr;
+  void *context_ = nullptr;
+  bool pending_ = false;
+  EventResponder *next_ = nullptr;  // In the list of attached responders
+};
+
+#endif  // TEENSYDMX_TEST_STUBS_EVENTRESPONDER_H_
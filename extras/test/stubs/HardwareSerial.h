@@ -0,0 +1,64 @@
+// HardwareSerial.h is a host stand-in for the Teensy core's serial ports.
+// `begin()` and `end()` are passed to the hook in Host.h so that a peripheral
+// model can configure itself the way the core would.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_TEST_STUBS_HARDWARESERIAL_H_
+#define TEENSYDMX_TEST_STUBS_HARDWARESERIAL_H_
+
+// C++ includes
+#include <cstdint>
+
+#include "Stream.h"
+
+// The same values as the Teensy 4 core
+#define SERIAL_7E1 0x02
+#define SERIAL_7O1 0x03
+#define SERIAL_8N1 0x00
+#define SERIAL_8E1 0x06
+#define SERIAL_8O1 0x07
+#define SERIAL_2STOP_BITS 0x100
+#define SERIAL_8N2 (SERIAL_8N1 | SERIAL_2STOP_BITS)
+#define SERIAL_8E2 (SERIAL_8E1 | SERIAL_2STOP_BITS)
+#define SERIAL_8O2 (SERIAL_8O1 | SERIAL_2STOP_BITS)
+
+class HardwareSerial : public Stream {
+ public:
+  explicit constexpr HardwareSerial(int index) : index_(index) {}
+
+  void begin(uint32_t baud, uint16_t format = 0);
+  void end();
+
+  int available() override {
+    return 0;
+  }
+
+  int read() override {
+    return -1;
+  }
+
+  size_t write(uint8_t b) override {
+    static_cast<void>(b);
+    return 1;
+  }
+
+  // Returns the zero-based port index, i.e. zero for Serial1.
+  int index() const {
+    return index_;
+  }
+
+ private:
+  const int index_;
+};
+
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+extern HardwareSerial Serial3;
+extern HardwareSerial Serial4;
+extern HardwareSerial Serial5;
+extern HardwareSerial Serial6;
+extern HardwareSerial Serial7;
+extern HardwareSerial Serial8;
+
+#endif  // TEENSYDMX_TEST_STUBS_HARDWARESERIAL_H_
@@ -0,0 +1,292 @@
+// Host.cpp implements the simulated time, the event loop, and the host
+// versions of the Teensy core functions.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#include "Host.h"
+
+// C++ includes
+#include <algorithm>
+#include <vector>
+
+#include "EventResponder.h"
+#include "HardwareSerial.h"
+#include "IntervalTimer.h"
+#include "core_pins.h"
+#include "imxrt.h"
+
+namespace host {
+
+static uint64_t currentTime = 0;
+static bool eventRunning = false;
+
+static constexpr int kNumIRQs = 256;
+static bool irqEnables[kNumIRQs]{false};
+static void (*irqVectors[kNumIRQs])(){nullptr};
+static int irqPriorities[kNumIRQs]{0};
+
+// In the order they were added, so that simultaneous events run in that order
+static std::vector<Source *> &sources() {
+  static std::vector<Source *> v;
+  return v;
+}
+
+void (*serialHook)(int index, bool begin, uint32_t baud, uint16_t format) =
+    nullptr;
+
+Source::~Source() {
+  removeSource(this);
+}
+
+void addSource(Source *s) {
+  std::vector<Source *> &v = sources();
+  if (std::find(v.begin(), v.end(), s) == v.end()) {
+    v.push_back(s);
+  }
+}
+
+void removeSource(Source *s) {
+  std::vector<Source *> &v = sources();
+  v.erase(std::remove(v.begin(), v.end(), s), v.end());
+}
+
+uint64_t now() {
+  return currentTime;
+}
+
+bool inEvent() {
+  return eventRunning;
+}
+
+bool irqEnabled(int irq) {
+  return irqEnables[irq];
+}
+
+void (*irqVector(int irq))() {
+  return irqVectors[irq];
+}
+
+void runUntil(uint64_t t) {
+  if (eventRunning) {
+    currentTime = std::max(currentTime, t);
+    return;
+  }
+
+  while (true) {
+    Source *next = nullptr;
+    uint64_t nextTime = kNever;
+    for (Source *s : sources()) {
+      uint64_t st = s->nextTime();
+      if (st < nextTime) {
+        nextTime = st;
+        next = s;
+      }
+    }
+    if (next == nullptr || nextTime > t) {
+      break;
+    }
+    currentTime = std::max(currentTime, nextTime);
+    eventRunning = true;
+    next->fire();
+    eventRunning = false;
+  }
+  currentTime = std::max(currentTime, t);
+}
+
+}  // namespace host
+
+// ---------------------------------------------------------------------------
+//  core_pins.h
+// ---------------------------------------------------------------------------
+
+uint32_t micros() {
+  return static_cast<uint32_t>(host::now() / 1000);
+}
+
+uint32_t millis() {
+  return static_cast<uint32_t>(host::now() / 1000000);
+}
+
+void delay(uint32_t ms) {
+  host::runFor(uint64_t{ms} * 1000000);
+}
+
+void delayMicroseconds(uint32_t us) {
+  host::runFor(uint64_t{us} * 1000);
+}
+
+void yield() {
+  EventResponder::runPending();
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  static_cast<void>(pin);
+  static_cast<void>(mode);
+}
+
+uint8_t digitalReadFast(uint8_t pin) {
+  static_cast<void>(pin);
+  return HIGH;
+}
+
+void digitalWriteFast(uint8_t pin, uint8_t val) {
+  static_cast<void>(pin);
+  static_cast<void>(val);
+}
+
+void attachInterrupt(uint8_t pin, void (*function)(), int mode) {
+  static_cast<void>(pin);
+  static_cast<void>(function);
+  static_cast<void>(mode);
+}
+
+void detachInterrupt(uint8_t pin) {
+  static_cast<void>(pin);
+}
+
+volatile uint32_t *portConfigRegister(int pin) {
+  static volatile uint32_t muxes[64]{0};
+  return &muxes[pin & 63];
+}
+
+// ---------------------------------------------------------------------------
+//  imxrt.h
+// ---------------------------------------------------------------------------
+
+volatile uint32_t F_CPU_ACTUAL = F_CPU;
+volatile uint32_t F_BUS_ACTUAL = 150000000;
+
+uint32_t ARM_DEMCR = 0;
+uint32_t ARM_DWT_CTRL = 0;
+
+uint32_t hostCycleCount() {
+  return static_cast<uint32_t>(host::now() * F_CPU_ACTUAL / 1000000000);
+}
+
+IMXRT_TMR_t IMXRT_TMR1;
+volatile uint32_t CCM_CCGR6 = 0;
+
+void attachInterruptVector(IRQ_NUMBER_t irq, void (*function)()) {
+  host::irqVectors[irq] = function;
+}
+
+void NVIC_ENABLE_IRQ(int irq) {
+  host::irqEnables[irq] = true;
+}
+
+void NVIC_DISABLE_IRQ(int irq) {
+  host::irqEnables[irq] = false;
+}
+
+int NVIC_GET_PRIORITY(int irq) {
+  return host::irqPriorities[irq];
+}
+
+void NVIC_SET_PRIORITY(int irq, int priority) {
+  host::irqPriorities[irq] = priority;
+}
+
+// ---------------------------------------------------------------------------
+//  HardwareSerial
+// ---------------------------------------------------------------------------
+
+HardwareSerial Serial1{0};
+HardwareSerial Serial2{1};
+HardwareSerial Serial3{2};
+HardwareSerial Serial4{3};
+HardwareSerial Serial5{4};
+HardwareSerial Serial6{5};
+HardwareSerial Serial7{6};
+HardwareSerial Serial8{7};
+
+void HardwareSerial::begin(uint32_t baud, uint16_t format) {
+  if (host::serialHook != nullptr) {
+    host::serialHook(index_, true, baud, format);
+  }
+}
+
+void HardwareSerial::end() {
+  if (host::serialHook != nullptr) {
+    host::serialHook(index_, false, 0, 0);
+  }
+}
+
+// ---------------------------------------------------------------------------
+//  IntervalTimer
+// ---------------------------------------------------------------------------
+
+bool IntervalTimer::start(void (*function)(), double period) {
+  if (function == nullptr || !(period > 0.0)) {
+    return false;
+  }
+  function_ = function;
+  periodNs_ = static_cast<uint64_t>(period*1000.0 + 0.5);
+  next_ = host::now() + periodNs_;
+  host::addSource(this);
+  return true;
+}
+
+void IntervalTimer::setPeriod(double period) {
+  if (function_ != nullptr && period > 0.0) {
+    periodNs_ = static_cast<uint64_t>(period*1000.0 + 0.5);
+  }
+}
+
+void IntervalTimer::end() {
+  function_ = nullptr;
+  host::removeSource(this);
+}
+
+uint64_t IntervalTimer::nextTime() const {
+  return (function_ == nullptr) ? host::kNever : next_;
+}
+
+void IntervalTimer::fire() {
+  next_ += periodNs_;
+  function_();
+}
+
+// ---------------------------------------------------------------------------
+//  EventResponder
+// ---------------------------------------------------------------------------
+
+static EventResponder *attachedResponders = nullptr;
+
+void EventResponder::attachInterrupt(EventResponderFunction function,
+                                     uint8_t priority) {
+  static_cast<void>(priority);
+  detach();
+  function_ = function;
+  next_ = attachedResponders;
+  attachedResponders = this;
+}
+
+void EventResponder::detach() {
+  for (EventResponder **p = &attachedResponders; *p != nullptr;
+       p = &(*p)->next_) {
+    if (*p == this) {
+      *p = next_;
+      break;
+    }
+  }
+  next_ = nullptr;
+  function_ = nullptr;
+  pending_ = false;
+}
+
+void EventResponder::triggerEvent(int status, void *data) {
+  static_cast<void>(status);
+  static_cast<void>(data);
+  if (function_ != nullptr) {
+    pending_ = true;
+  }
+}
+
+void EventResponder::runPending() {
+  for (EventResponder *r = attachedResponders; r != nullptr; r = r->next_) {
+    if (r->pending_) {
+      r->pending_ = false;
+      r->function_(*r);
+    }
+  }
+}
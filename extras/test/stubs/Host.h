@@ -0,0 +1,67 @@
+// Host.h defines the simulated time and event loop that the host stubs share.
+// Anything that produces interrupts, such as a timer or a peripheral model, is
+// an event source. Events run one at a time in time order, so an event
+// handler behaves like an ISR that can't be preempted.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_TEST_STUBS_HOST_H_
+#define TEENSYDMX_TEST_STUBS_HOST_H_
+
+// C++ includes
+#include <cstdint>
+
+namespace host {
+
+// Indicates that a source has no pending event.
+constexpr uint64_t kNever = UINT64_MAX;
+
+// Something that produces events at simulated times.
+class Source {
+ public:
+  Source() = default;
+  virtual ~Source();
+
+  // Returns the time of the next event, in nanoseconds, or kNever.
+  virtual uint64_t nextTime() const = 0;
+
+  // Handles the event that's due at `nextTime()`. The current time is set to
+  // that time before this is called.
+  virtual void fire() = 0;
+};
+
+// Adds or removes an event source. Adding a source twice has no effect.
+void addSource(Source *s);
+void removeSource(Source *s);
+
+// Returns the current simulated time, in nanoseconds.
+uint64_t now();
+
+// Runs events in time order up to and including time `t`, and then sets the
+// current time to `t`. If this is called from an event handler, for example
+// from a delay inside an ISR, then the time is simply advanced and other events
+// wait until the handler returns.
+void runUntil(uint64_t t);
+
+// Runs events for the given duration.
+inline void runFor(uint64_t ns) {
+  runUntil(now() + ns);
+}
+
+// Returns whether an event handler is running.
+bool inEvent();
+
+// The simulated interrupt controller. Vectors are set with
+// `attachInterruptVector()` and interrupts are enabled and disabled with the
+// NVIC_ENABLE_IRQ() and NVIC_DISABLE_IRQ() functions.
+bool irqEnabled(int irq);
+void (*irqVector(int irq))();
+
+// Called for `HardwareSerial::begin()` and `end()`. `baud` and `format` are
+// zero for `end()`.
+extern void (*serialHook)(int index, bool begin, uint32_t baud,
+                          uint16_t format);
+
+}  // namespace host
+
+#endif  // TEENSYDMX_TEST_STUBS_HOST_H_
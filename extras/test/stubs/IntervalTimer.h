@@ -0,0 +1,61 @@
+// IntervalTimer.h is a host stand-in for the Teensy core's periodic timer.
+// The callback runs in simulated time; see Host.h.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_TEST_STUBS_INTERVALTIMER_H_
+#define TEENSYDMX_TEST_STUBS_INTERVALTIMER_H_
+
+// C++ includes
+#include <cstdint>
+
+#include "Host.h"
+
+class IntervalTimer : private host::Source {
+ public:
+  IntervalTimer() = default;
+  ~IntervalTimer() override {
+    end();
+  }
+
+  // The core's timer is copyable. Copies start out stopped.
+  IntervalTimer(const IntervalTimer &) : Source() {}
+  IntervalTimer &operator=(const IntervalTimer &other) {
+    if (this != &other) {
+      end();
+    }
+    return *this;
+  }
+
+  // Starts or restarts the timer with a period in microseconds. The first call
+  // happens one period from now.
+  template <typename period_t>
+  bool begin(void (*function)(), period_t period) {
+    return start(function, static_cast<double>(period));
+  }
+
+  // Changes the period, starting with the next call.
+  template <typename period_t>
+  void update(period_t period) {
+    setPeriod(static_cast<double>(period));
+  }
+
+  void end();
+
+  void priority(uint8_t n) {
+    static_cast<void>(n);
+  }
+
+ private:
+  bool start(void (*function)(), double period);
+  void setPeriod(double period);
+
+  uint64_t nextTime() const override;
+  void fire() override;
+
+  void (*function_)() = nullptr;
+  uint64_t periodNs_ = 0;
+  uint64_t next_ = 0;
+};
+
+#endif  // TEENSYDMX_TEST_STUBS_INTERVALTIMER_H_
@@ -0,0 +1,557 @@
+// LPUARTModel.cpp implements the LPUART model.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#include "LPUARTModel.h"
+
+// C++ includes
+#include <algorithm>
+#include <cmath>
+
+#include "HardwareSerial.h"
+#include "imxrt.h"
+
+namespace host {
+
+// STAT flags that are cleared by writing a 1.
+static constexpr uint32_t kSTATW1C =
+    LPUART_STAT_LBKDIF | LPUART_STAT_RXEDGIF | LPUART_STAT_IDLE |
+    LPUART_STAT_OR | LPUART_STAT_NF | LPUART_STAT_FE | LPUART_STAT_PF;
+
+// STAT flags that come from the FIFO levels and are read-only.
+static constexpr uint32_t kSTATFIFO =
+    LPUART_STAT_TDRE | LPUART_STAT_TC | LPUART_STAT_RDRF;
+
+// The TXFIFOSIZE and RXFIFOSIZE values for a 4-word FIFO.
+static constexpr uint32_t kFIFOSizeBits =
+    LPUART_FIFO_TXFIFOSIZE(1) | LPUART_FIFO_RXFIFOSIZE(1);
+
+// ---------------------------------------------------------------------------
+//  LPUARTRegister
+// ---------------------------------------------------------------------------
+
+LPUARTRegister::operator uint32_t() const {
+  return model_->read(index_);
+}
+
+LPUARTRegister &LPUARTRegister::operator=(uint32_t v) {
+  model_->write(index_, v);
+  return *this;
+}
+
+// ---------------------------------------------------------------------------
+//  LPUARTModel
+// ---------------------------------------------------------------------------
+
+LPUARTModel::LPUARTModel(int irq) : irq_(irq) {
+  reset();
+}
+
+void LPUARTModel::reset() {
+  baud_ = LPUART_BAUD_OSR(15) | LPUART_BAUD_SBR(4);
+  stat_ = 0;
+  ctrl_ = 0;
+  fifo_ = kFIFOSizeBits;
+  water_ = 0;
+  std::fill_n(other_, kRegisterCount, 0);
+
+  txFIFO_.clear();
+  txBits_.clear();
+  txBitIndex_ = 0;
+  txBitTime_ = 0.0;
+  txCharStart_ = 0;
+  txShifting_ = false;
+  txLine_ = true;
+  txEdges_.clear();
+  txListener_ = nullptr;
+
+  rxFIFO_.clear();
+  rxLine_ = true;
+  rxLastRise_ = now();
+  rxInChar_ = false;
+  rxIdleArmed_ = false;
+  rxCharStart_ = 0;
+  rxBitTime_ = 0.0;
+  rxBitIndex_ = 0;
+  rxDataBits_ = 8;
+  rxData_ = 0;
+  rxIdleStart_ = 0;
+  rxIdleTime_ = 0;
+
+  irqDue_ = kNever;
+  isrCount_ = 0;
+  isrLatencyMin_ = kISRLatency;
+  isrLatencyMax_ = kISRLatency;
+  latencySeed_ = 1;
+
+  addSource(this);
+}
+
+void LPUARTModel::begin(uint32_t baud, uint16_t format) {
+  // Find the best oversampling ratio and divisor, the same way as the core
+  float base = static_cast<float>(kLPUARTClock) / static_cast<float>(baud);
+  float bestErr = 1e20f;
+  int bestDiv = 1;
+  int bestOSR = 4;
+  for (int osr = 4; osr <= 32; osr++) {
+    float div = base / static_cast<float>(osr);
+    int divInt = static_cast<int>(div + 0.5f);
+    divInt = std::min(std::max(divInt, 1), 8191);
+    float err = std::fabs((static_cast<float>(divInt) - div) / div);
+    if (err <= bestErr) {
+      bestErr = err;
+      bestDiv = divInt;
+      bestOSR = osr;
+    }
+  }
+
+  txFIFO_.clear();
+  rxFIFO_.clear();
+  stat_ = 0;
+
+  baud_ = LPUART_BAUD_OSR(bestOSR - 1) | LPUART_BAUD_SBR(bestDiv) |
+          ((bestOSR <= 8) ? LPUART_BAUD_BOTHEDGE : 0);
+  water_ = LPUART_WATER_RXWATER(2) | LPUART_WATER_TXWATER(2);
+  fifo_ |= LPUART_FIFO_TXFE | LPUART_FIFO_RXFE;
+
+  uint32_t ctrl = format & (LPUART_CTRL_PT | LPUART_CTRL_PE);
+  if ((format & 0x04) != 0) {
+    ctrl |= LPUART_CTRL_M;
+  }
+  if ((format & 0x0f) == 0x04) {
+    ctrl |= LPUART_CTRL_R9T8;
+  }
+  if ((format & 0x20) != 0) {
+    ctrl |= LPUART_CTRL_TXINV;
+  }
+  if ((format & 0x08) != 0) {
+    baud_ |= LPUART_BAUD_M10;
+  }
+  if ((format & 0x10) != 0) {
+    stat_ |= LPUART_STAT_RXINV;
+  }
+  if ((format & SERIAL_2STOP_BITS) != 0) {
+    baud_ |= LPUART_BAUD_SBNS;
+  }
+  write(kCTRL, ctrl | LPUART_CTRL_TE | LPUART_CTRL_RE | LPUART_CTRL_RIE |
+                   LPUART_CTRL_ILIE);
+  NVIC_ENABLE_IRQ(irq_);
+}
+
+void LPUARTModel::end() {
+  NVIC_DISABLE_IRQ(irq_);
+  txFIFO_.clear();
+  txShifting_ = false;
+  rxFIFO_.clear();
+  rxInChar_ = false;
+  write(kCTRL, 0);
+}
+
+double LPUARTModel::bitTime() const {
+  uint32_t sbr = baud_ & 0x1fff;
+  uint32_t osr = ((baud_ >> 24) & 0x1f) + 1;
+  if (sbr == 0) {
+    return 1e12;
+  }
+  return static_cast<double>(osr * sbr) * 1e9 / kLPUARTClock;
+}
+
+int LPUARTModel::dataBits() const {
+  if ((baud_ & LPUART_BAUD_M10) != 0) {
+    return 10;
+  }
+  if ((ctrl_ & LPUART_CTRL_M) != 0) {
+    return 9;
+  }
+  if ((ctrl_ & LPUART_CTRL_M7) != 0) {
+    return 7;
+  }
+  return 8;
+}
+
+int LPUARTModel::stopBits() const {
+  return ((baud_ & LPUART_BAUD_SBNS) != 0) ? 2 : 1;
+}
+
+size_t LPUARTModel::txDepth() const {
+  return ((fifo_ & LPUART_FIFO_TXFE) != 0) ? kFIFOSize : 1;
+}
+
+size_t LPUARTModel::rxDepth() const {
+  return ((fifo_ & LPUART_FIFO_RXFE) != 0) ? kFIFOSize : 1;
+}
+
+size_t LPUARTModel::txWater() const {
+  return ((fifo_ & LPUART_FIFO_TXFE) != 0) ? (water_ & 0x03) : 0;
+}
+
+size_t LPUARTModel::rxWater() const {
+  return ((fifo_ & LPUART_FIFO_RXFE) != 0) ? ((water_ >> 16) & 0x03) : 0;
+}
+
+uint32_t LPUARTModel::stat() const {
+  uint32_t s = stat_ & ~kSTATFIFO;
+  if (txFIFO_.size() <= txWater()) {
+    s |= LPUART_STAT_TDRE;
+  }
+  if (txFIFO_.empty() && !txShifting_) {
+    s |= LPUART_STAT_TC;
+  }
+  if (rxFIFO_.size() > rxWater()) {
+    s |= LPUART_STAT_RDRF;
+  }
+  return s;
+}
+
+uint32_t LPUARTModel::read(int reg) {
+  uint32_t v;
+  switch (reg) {
+    case kBAUD:
+      v = baud_;
+      break;
+    case kSTAT:
+      v = stat();
+      break;
+    case kCTRL:
+      v = ctrl_;
+      break;
+    case kDATA:
+      if (rxFIFO_.empty()) {
+        v = LPUART_DATA_RXEMPT;
+      } else {
+        RXWord w = rxFIFO_.front();
+        rxFIFO_.pop_front();
+        v = w.data | (w.frameError ? LPUART_DATA_FRETSC : 0);
+        if (rxFIFO_.empty()) {
+          v |= LPUART_DATA_RXEMPT;
+        }
+      }
+      break;
+    case kFIFO:
+      v = fifo_ | kFIFOSizeBits;
+      if (txFIFO_.empty()) {
+        v |= LPUART_FIFO_TXEMPT;
+      }
+      if (rxFIFO_.empty()) {
+        v |= LPUART_FIFO_RXEMPT;
+      }
+      break;
+    case kWATER:
+      v = water_ | LPUART_WATER_TXCOUNT(txFIFO_.size()) |
+          LPUART_WATER_RXCOUNT(rxFIFO_.size());
+      break;
+    default:
+      v = other_[reg];
+      break;
+  }
+  updateIRQ();
+  return v;
+}
+
+void LPUARTModel::write(int reg, uint32_t v) {
+  switch (reg) {
+    case kBAUD:
+      baud_ = v;
+      break;
+    case kSTAT:
+      stat_ = (stat_ & kSTATW1C & ~v) | (v & ~(kSTATW1C | kSTATFIFO));
+      break;
+    case kCTRL: {
+      uint32_t old = ctrl_;
+      ctrl_ = v;
+      if ((old & LPUART_CTRL_RE) != 0 && (v & LPUART_CTRL_RE) == 0) {
+        rxInChar_ = false;
+      }
+      if (!txShifting_ && !txFIFO_.empty() && (v & LPUART_CTRL_TE) != 0) {
+        txLoad();
+      }
+      updateTXLine();
+      break;
+    }
+    case kDATA:
+      if (txFIFO_.size() >= txDepth()) {
+        fifo_ |= LPUART_FIFO_TXOF;
+        break;
+      }
+      txFIFO_.push_back(v);
+      if (!txShifting_ && (ctrl_ & LPUART_CTRL_TE) != 0) {
+        txLoad();
+      }
+      break;
+    case kFIFO:
+      if ((v & LPUART_FIFO_TXFLUSH) != 0) {
+        txFIFO_.clear();
+      }
+      if ((v & LPUART_FIFO_RXFLUSH) != 0) {
+        rxFIFO_.clear();
+      }
+      fifo_ = v & ~(LPUART_FIFO_TXFLUSH | LPUART_FIFO_RXFLUSH |
+                    LPUART_FIFO_TXEMPT | LPUART_FIFO_RXEMPT | kFIFOSizeBits);
+      break;
+    case kWATER:
+      water_ = v & (LPUART_WATER_RXWATER(3) | LPUART_WATER_TXWATER(3));
+      break;
+    default:
+      other_[reg] = v;
+      break;
+  }
+  updateIRQ();
+}
+
+bool LPUARTModel::irqRequested() const {
+  uint32_t s = stat();
+  return ((ctrl_ & LPUART_CTRL_TIE) != 0 && (s & LPUART_STAT_TDRE) != 0) ||
+         ((ctrl_ & LPUART_CTRL_TCIE) != 0 && (s & LPUART_STAT_TC) != 0) ||
+         ((ctrl_ & LPUART_CTRL_RIE) != 0 && (s & LPUART_STAT_RDRF) != 0) ||
+         ((ctrl_ & LPUART_CTRL_ILIE) != 0 && (s & LPUART_STAT_IDLE) != 0) ||
+         ((ctrl_ & LPUART_CTRL_FEIE) != 0 && (s & LPUART_STAT_FE) != 0) ||
+         ((ctrl_ & LPUART_CTRL_ORIE) != 0 && (s & LPUART_STAT_OR) != 0) ||
+         ((ctrl_ & LPUART_CTRL_NEIE) != 0 && (s & LPUART_STAT_NF) != 0) ||
+         ((ctrl_ & LPUART_CTRL_PEIE) != 0 && (s & LPUART_STAT_PF) != 0);
+}
+
+void LPUARTModel::updateIRQ() {
+  if (!irqRequested()) {
+    irqDue_ = kNever;
+  } else if (irqDue_ == kNever) {
+    uint64_t latency = isrLatencyMin_;
+    if (isrLatencyMax_ > isrLatencyMin_) {
+      latencySeed_ = latencySeed_*1664525 + 1013904223;
+      latency += latencySeed_ % (isrLatencyMax_ - isrLatencyMin_ + 1);
+    }
+    irqDue_ = now() + latency;
+  }
+}
+
+uint64_t LPUARTModel::nextTime() const {
+  uint64_t t = std::min(txNextBit(), std::min(rxNextSample(), rxIdleDue()));
+  if (irqDue_ != kNever && irqEnabled(irq_) && irqVector(irq_) != nullptr) {
+    t = std::min(t, irqDue_);
+  }
+  return t;
+}
+
+void LPUARTModel::fire() {
+  uint64_t t = now();
+
+  if (txNextBit() <= t) {
+    txBitIndex_++;
+    if (txBitIndex_ >= static_cast<int>(txBits_.size())) {
+      txShifting_ = false;
+      if (!txFIFO_.empty() && (ctrl_ & LPUART_CTRL_TE) != 0) {
+        txLoad();
+      }
+    }
+    updateTXLine();
+  }
+  if (rxNextSample() <= t) {
+    rxSample();
+  }
+  if (rxIdleDue() <= t) {
+    stat_ |= LPUART_STAT_IDLE;
+    rxIdleArmed_ = false;
+  }
+  updateIRQ();
+
+  if (irqDue_ <= t && irqEnabled(irq_) && irqVector(irq_) != nullptr) {
+    isrCount_++;
+    irqVector(irq_)();
+    irqDue_ = kNever;
+    updateIRQ();
+  }
+}
+
+// ---------------------------------------------------------------------------
+//  TX
+// ---------------------------------------------------------------------------
+
+uint64_t LPUARTModel::txNextBit() const {
+  if (!txShifting_) {
+    return kNever;
+  }
+  return txCharStart_ +
+         static_cast<uint64_t>(std::llround((txBitIndex_ + 1)*txBitTime_));
+}
+
+void LPUARTModel::txLoad() {
+  uint32_t w = txFIFO_.front();
+  txFIFO_.pop_front();
+
+  int nData = dataBits();
+  int nBits = 1 + nData + stopBits();
+  txBits_.assign(nBits, true);
+  if ((w & LPUART_DATA_FRETSC) != 0) {
+    // An idle character if the top data bits are set, otherwise a break
+    bool idle = (w & (LPUART_DATA_R8T8 | LPUART_DATA_R9T9)) != 0;
+    std::fill(txBits_.begin(), txBits_.end(), idle);
+  } else {
+    txBits_[0] = false;  // Start bit
+    bool parity = false;
+    for (int i = 0; i < nData; i++) {
+      bool b = ((w >> i) & 0x01) != 0;
+      txBits_[1 + i] = b;
+      parity ^= b;
+    }
+    if ((ctrl_ & LPUART_CTRL_PE) != 0) {
+      parity ^= txBits_[nData];  // Replace the top bit with the parity
+      txBits_[nData] = parity ^ ((ctrl_ & LPUART_CTRL_PT) != 0);
+    }
+  }
+
+  txBitTime_ = bitTime();
+  txCharStart_ = now();
+  txBitIndex_ = 0;
+  txShifting_ = true;
+  updateTXLine();
+}
+
+void LPUARTModel::updateTXLine() {
+  bool raw = true;
+  if (txShifting_ && txBitIndex_ < static_cast<int>(txBits_.size())) {
+    raw = txBits_[txBitIndex_];
+  }
+  bool level = raw ^ ((ctrl_ & LPUART_CTRL_TXINV) != 0);
+  if (level == txLine_) {
+    return;
+  }
+  txLine_ = level;
+  txEdges_.push_back(Edge{now(), level});
+  if (txListener_ != nullptr) {
+    txListener_->lineChanged(level);
+  }
+}
+
+// ---------------------------------------------------------------------------
+//  RX
+// ---------------------------------------------------------------------------
+
+void LPUARTModel::lineChanged(bool level) {
+  if (level == rxLine_) {
+    return;
+  }
+  rxLine_ = level;
+  if (level) {
+    rxLastRise_ = now();
+    if ((ctrl_ & LPUART_CTRL_ILT) == 0) {
+      rxIdleStart_ = rxLastRise_;
+    } else {
+      rxIdleStart_ = std::max(rxIdleStart_, rxLastRise_);
+    }
+    return;
+  }
+
+  // Falling edge: look for a start bit
+  if (!rxInChar_ && (ctrl_ & LPUART_CTRL_RE) != 0) {
+    rxInChar_ = true;
+    rxCharStart_ = now();
+    rxBitTime_ = bitTime();
+    rxBitIndex_ = 0;
+    rxDataBits_ = dataBits();
+    rxData_ = 0;
+  }
+}
+
+uint64_t LPUARTModel::rxNextSample() const {
+  if (!rxInChar_) {
+    return kNever;
+  }
+  return rxCharStart_ +
+         static_cast<uint64_t>(std::llround((rxBitIndex_ + 0.5)*rxBitTime_));
+}
+
+uint64_t LPUARTModel::rxIdleDue() const {
+  if (!rxIdleArmed_ || rxInChar_ || !rxLine_) {
+    return kNever;
+  }
+  return std::max(rxIdleStart_, rxLastRise_) + rxIdleTime_;
+}
+
+void LPUARTModel::rxSample() {
+  bool level = rxLine_;
+  if (rxBitIndex_ == 0) {
+    if (level) {  // Not a start bit after all
+      rxInChar_ = false;
+      stat_ |= LPUART_STAT_NF;
+      return;
+    }
+  } else if (rxBitIndex_ <= rxDataBits_) {
+    if (level) {
+      rxData_ |= uint32_t{1} << (rxBitIndex_ - 1);
+    }
+  } else {
+    // The first stop bit
+    rxInChar_ = false;
+    rxReceive(rxData_, !level);
+
+    int nBits = 1 + rxDataBits_ + stopBits();
+    rxIdleTime_ = static_cast<uint64_t>(std::llround(nBits*rxBitTime_));
+    uint64_t charEnd =
+        rxCharStart_ +
+        static_cast<uint64_t>(std::llround((rxDataBits_ + 2)*rxBitTime_));
+    if ((ctrl_ & LPUART_CTRL_ILT) != 0) {
+      rxIdleStart_ = std::max(rxLastRise_, charEnd);
+    } else {
+      rxIdleStart_ = std::max(
+          rxLastRise_,
+          rxCharStart_ + static_cast<uint64_t>(std::llround(rxBitTime_)));
+    }
+    rxIdleArmed_ = true;
+
+    // A low line at the end of the character is the start of the next
+    // character only after a rising edge
+    return;
+  }
+  rxBitIndex_++;
+}
+
+void LPUARTModel::rxReceive(uint32_t data, bool frameError) {
+  if (rxFIFO_.size() >= rxDepth()) {
+    stat_ |= LPUART_STAT_OR;
+    return;
+  }
+  rxFIFO_.push_back(RXWord{data, frameError});
+  if (frameError) {
+    stat_ |= LPUART_STAT_FE;
+  }
+}
+
+// ---------------------------------------------------------------------------
+//  Instances
+// ---------------------------------------------------------------------------
+
+LPUARTModel &lpuart(int n) {
+  static LPUARTModel models[8]{
+      {IRQ_LPUART1}, {IRQ_LPUART2}, {IRQ_LPUART3}, {IRQ_LPUART4},
+      {IRQ_LPUART5}, {IRQ_LPUART6}, {IRQ_LPUART7}, {IRQ_LPUART8},
+  };
+  return models[n - 1];
+}
+
+LPUARTModel &lpuartForSerial(int index) {
+  // Serial1-8 are on these LPUARTs
+  static constexpr int kLPUARTs[8]{6, 4, 2, 3, 8, 1, 7, 5};
+  return lpuart(kLPUARTs[index]);
+}
+
+// Connects HardwareSerial::begin() and end() to the models.
+static void serialBeginEnd(int index, bool begin, uint32_t baud,
+                           uint16_t format) {
+  if (begin) {
+    lpuartForSerial(index).begin(baud, format);
+  } else {
+    lpuartForSerial(index).end();
+  }
+}
+
+static const bool serialHookSet = (serialHook = &serialBeginEnd, true);
+
+}  // namespace host
+
+IMXRT_LPUART_t &hostLPUARTRegisters(int n) {
+  static IMXRT_LPUART_t regs[8]{
+      {&host::lpuart(1)}, {&host::lpuart(2)}, {&host::lpuart(3)},
+      {&host::lpuart(4)}, {&host::lpuart(5)}, {&host::lpuart(6)},
+      {&host::lpuart(7)}, {&host::lpuart(8)},
+  };
+  return regs[n - 1];
+}
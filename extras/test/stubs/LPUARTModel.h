@@ -0,0 +1,244 @@
+// LPUARTModel.h defines a model of the i.MX RT LPUART that's good enough to
+// run the library's LPUART handlers against. It has the 4-word FIFOs, the
+// flags and interrupt conditions the handlers use, TX inversion, 7- to 10-bit
+// characters with one or two stop bits, and break and idle characters.
+//
+// The TX side shifts characters out one bit at a time in simulated time and
+// records every edge on the TX line. The RX side samples an RX line, driven
+// by the test or by another model's TX line, the way a real receiver does:
+// at the middle of each bit, looking for framing errors and idle lines.
+//
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_TEST_STUBS_LPUARTMODEL_H_
+#define TEENSYDMX_TEST_STUBS_LPUARTMODEL_H_
+
+// C++ includes
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+#include "Host.h"
+
+namespace host {
+
+// The LPUART functional clock, as set up by the Teensy 4 core.
+constexpr uint32_t kLPUARTClock = 24000000;
+
+// The default time from an interrupt condition to its ISR running, in
+// nanoseconds.
+constexpr uint64_t kISRLatency = 100;
+
+class LPUARTModel;
+
+// One edge on a line.
+struct Edge {
+  uint64_t time;  // In nanoseconds
+  bool level;     // The level after the edge
+};
+
+// Receives the level changes on a line.
+class LineListener {
+ public:
+  virtual ~LineListener() = default;
+  virtual void lineChanged(bool level) = 0;
+};
+
+// A 32-bit LPUART register. Reads and writes go to the model.
+class LPUARTRegister final {
+ public:
+  LPUARTRegister(LPUARTModel *model, int index) : model_(model), index_(index) {}
+
+  LPUARTRegister(const LPUARTRegister &) = delete;
+  LPUARTRegister &operator=(const LPUARTRegister &) = delete;
+
+  operator uint32_t() const;
+  LPUARTRegister &operator=(uint32_t v);
+
+  LPUARTRegister &operator|=(uint32_t v) {
+    return *this = (static_cast<uint32_t>(*this) | v);
+  }
+
+  LPUARTRegister &operator&=(uint32_t v) {
+    return *this = (static_cast<uint32_t>(*this) & v);
+  }
+
+ private:
+  LPUARTModel *const model_;
+  const int index_;
+};
+
+// The model for one LPUART.
+class LPUARTModel final : private Source, public LineListener {
+ public:
+  // Register indexes, in the order of the real register layout.
+  enum Registers {
+    kVERID,
+    kPARAM,
+    kGLOBAL,
+    kPINCFG,
+    kBAUD,
+    kSTAT,
+    kCTRL,
+    kDATA,
+    kMATCH,
+    kMODIR,
+    kFIFO,
+    kWATER,
+    kRegisterCount,
+  };
+
+  LPUARTModel(int irq);  // Not explicit so that arrays are easy to create
+  ~LPUARTModel() override = default;
+
+  LPUARTModel(const LPUARTModel &) = delete;
+  LPUARTModel &operator=(const LPUARTModel &) = delete;
+
+  // Resets to the power-on state and clears the recorded edges.
+  void reset();
+
+  // Configures the port the way the Teensy 4 core's HardwareSerial::begin()
+  // and end() do.
+  void begin(uint32_t baud, uint16_t format);
+  void end();
+
+  uint32_t read(int reg);
+  void write(int reg, uint32_t v);
+
+  // Returns the current TX line level, including any inversion.
+  bool txLevel() const {
+    return txLine_;
+  }
+
+  // Returns every edge on the TX line since the last `clearTXEdges()`.
+  const std::vector<Edge> &txEdges() const {
+    return txEdges_;
+  }
+
+  void clearTXEdges() {
+    txEdges_.clear();
+  }
+
+  // Sends TX line changes to the listener, for example another model's RX
+  // side, in addition to recording them.
+  void setTXListener(LineListener *listener) {
+    txListener_ = listener;
+  }
+
+  // Sets the RX line level at the current time.
+  void lineChanged(bool level) override;
+
+  // Returns the time of one bit at the current BAUD setting, in nanoseconds.
+  double bitTime() const;
+
+  // Returns the number of interrupts that ran this model's ISR.
+  uint64_t isrCount() const {
+    return isrCount_;
+  }
+
+  // Sets the range of the time from an interrupt condition to the ISR running,
+  // in nanoseconds. Each interrupt picks a pseudo-random time in the range.
+  void setISRLatency(uint64_t min, uint64_t max) {
+    isrLatencyMin_ = min;
+    isrLatencyMax_ = std::max(min, max);
+  }
+
+ private:
+  static constexpr int kFIFOSize = 4;
+
+  struct RXWord {
+    uint32_t data;
+    bool frameError;
+  };
+
+  // Source
+  uint64_t nextTime() const override;
+  void fire() override;
+
+  // Returns the number of data bits and the number of stop bits in a
+  // character at the current settings.
+  int dataBits() const;
+  int stopBits() const;
+
+  // Returns the FIFO depths and watermarks, taking into account whether the
+  // FIFOs are enabled.
+  size_t txDepth() const;
+  size_t rxDepth() const;
+  size_t txWater() const;
+  size_t rxWater() const;
+
+  // Returns the current STAT value, including the FIFO flags.
+  uint32_t stat() const;
+
+  // Returns whether an interrupt is being requested.
+  bool irqRequested() const;
+
+  // Notes a change that may have changed the interrupt request.
+  void updateIRQ();
+
+  // TX
+  uint64_t txNextBit() const;
+  void txLoad();
+  void updateTXLine();
+
+  // RX
+  uint64_t rxNextSample() const;
+  uint64_t rxIdleDue() const;
+  void rxSample();
+  void rxReceive(uint32_t data, bool frameError);
+
+  const int irq_;
+
+  uint32_t baud_;
+  uint32_t stat_;
+  uint32_t ctrl_;
+  uint32_t fifo_;
+  uint32_t water_;
+  uint32_t other_[kRegisterCount];
+
+  // TX state
+  std::deque<uint32_t> txFIFO_;
+  std::vector<bool> txBits_;  // The character being shifted out
+  int txBitIndex_;
+  double txBitTime_;
+  uint64_t txCharStart_;
+  bool txShifting_;
+  bool txLine_;
+  std::vector<Edge> txEdges_;
+  LineListener *txListener_;
+
+  // RX state
+  std::deque<RXWord> rxFIFO_;
+  bool rxLine_;
+  uint64_t rxLastRise_;
+  bool rxInChar_;
+  bool rxIdleArmed_;  // A character was received since the last IDLE
+  uint64_t rxCharStart_;
+  double rxBitTime_;
+  int rxBitIndex_;    // The next bit to sample; zero is the start bit
+  int rxDataBits_;
+  uint32_t rxData_;
+  uint64_t rxIdleStart_;  // Where idle counting started
+  uint64_t rxIdleTime_;   // How long the line must be idle
+
+  // Interrupts
+  uint64_t irqDue_;  // When a requested interrupt is serviced
+  uint64_t isrCount_;
+  uint64_t isrLatencyMin_;
+  uint64_t isrLatencyMax_;
+  uint32_t latencySeed_;  // For picking latencies
+};
+
+// Returns the model for LPUARTn, where n is 1-8.
+LPUARTModel &lpuart(int n);
+
+// Returns the model for the given Teensy serial port index, where zero is
+// Serial1.
+LPUARTModel &lpuartForSerial(int index);
+
+}  // namespace host
+
+#endif  // TEENSYDMX_TEST_STUBS_LPUARTMODEL_H_
@@ -0,0 +1,27 @@
+// Print.h is a host stand-in for the Teensy core's Print class.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_TEST_STUBS_PRINT_H_
+#define TEENSYDMX_TEST_STUBS_PRINT_H_
+
+// C++ includes
+#include <cstddef>
+#include <cstdint>
+
+class Print {
+ public:
+  virtual ~Print() = default;
+
+  virtual size_t write(uint8_t b) = 0;
+
+  virtual size_t write(const uint8_t *buf, size_t size) {
+    size_t n = 0;
+    while (n < size && write(buf[n]) == 1) {
+      n++;
+    }
+    return n;
+  }
+};
+
+#endif  // TEENSYDMX_TEST_STUBS_PRINT_H_
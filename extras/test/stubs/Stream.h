@@ -0,0 +1,33 @@
+// Stream.h is a host stand-in for the Teensy core's Stream class.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_TEST_STUBS_STREAM_H_
+#define TEENSYDMX_TEST_STUBS_STREAM_H_
+
+#include "Print.h"
+
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+
+  // Doesn't wait; stops at the first unavailable byte.
+  size_t readBytes(uint8_t *buf, size_t size) {
+    size_t n = 0;
+    while (n < size) {
+      int c = read();
+      if (c < 0) {
+        break;
+      }
+      buf[n++] = static_cast<uint8_t>(c);
+    }
+    return n;
+  }
+
+  void setTimeout(uint32_t timeout) {
+    static_cast<void>(timeout);
+  }
+};
+
+#endif  // TEENSYDMX_TEST_STUBS_STREAM_H_
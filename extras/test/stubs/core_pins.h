@@ -0,0 +1,46 @@
+// core_pins.h is a host stand-in for the Teensy core's pin and time functions.
+// Time is simulated; see HostClock.h.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_TEST_STUBS_CORE_PINS_H_
+#define TEENSYDMX_TEST_STUBS_CORE_PINS_H_
+
+// C++ includes
+#include <cstdint>
+
+#if defined(__IMXRT1062__) || defined(__IMXRT1052__)
+#include "imxrt.h"
+#endif  // __IMXRT1062__ || __IMXRT1052__
+
+#ifndef F_CPU
+#define F_CPU 600000000
+#endif  // !F_CPU
+
+#define INPUT 0
+#define OUTPUT 1
+#define LOW 0
+#define HIGH 1
+#define FALLING 2
+#define RISING 3
+#define CHANGE 4
+
+uint32_t micros();
+uint32_t millis();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+uint8_t digitalReadFast(uint8_t pin);
+void digitalWriteFast(uint8_t pin, uint8_t val);
+void attachInterrupt(uint8_t pin, void (*function)(), int mode);
+void detachInterrupt(uint8_t pin);
+
+// Returns a pin's mux register.
+volatile uint32_t *portConfigRegister(int pin);
+
+inline void __disable_irq() {}
+inline void __enable_irq() {}
+
+#endif  // TEENSYDMX_TEST_STUBS_CORE_PINS_H_
@@ -0,0 +1,215 @@
+// imxrt.h is a host stand-in for the Teensy 4 core's register definitions. It
+// only has what the library uses.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_TEST_STUBS_IMXRT_H_
+#define TEENSYDMX_TEST_STUBS_IMXRT_H_
+
+// C++ includes
+#include <cstdint>
+
+#include "LPUARTModel.h"
+
+extern "C" volatile uint32_t F_CPU_ACTUAL;
+extern "C" volatile uint32_t F_BUS_ACTUAL;
+
+// ---------------------------------------------------------------------------
+//  Interrupts
+// ---------------------------------------------------------------------------
+
+enum IRQ_NUMBER_t {
+  IRQ_LPUART1 = 20,
+  IRQ_LPUART2 = 21,
+  IRQ_LPUART3 = 22,
+  IRQ_LPUART4 = 23,
+  IRQ_LPUART5 = 24,
+  IRQ_LPUART6 = 25,
+  IRQ_LPUART7 = 26,
+  IRQ_LPUART8 = 27,
+  IRQ_QTIMER1 = 133,
+};
+
+// These go to the simulated interrupt controller in Host.h.
+void attachInterruptVector(IRQ_NUMBER_t irq, void (*function)());
+void NVIC_ENABLE_IRQ(int irq);
+void NVIC_DISABLE_IRQ(int irq);
+int NVIC_GET_PRIORITY(int irq);
+void NVIC_SET_PRIORITY(int irq, int priority);
+
+// ---------------------------------------------------------------------------
+//  Cycle counter
+// ---------------------------------------------------------------------------
+
+extern uint32_t ARM_DEMCR;
+extern uint32_t ARM_DWT_CTRL;
+#define ARM_DEMCR_TRCENA (1 << 24)
+#define ARM_DWT_CTRL_CYCCNTENA (1 << 0)
+
+// The cycle count at F_CPU_ACTUAL, from the simulated time.
+uint32_t hostCycleCount();
+#define ARM_DWT_CYCCNT (hostCycleCount())
+
+// ---------------------------------------------------------------------------
+//  LPUART
+// ---------------------------------------------------------------------------
+
+// The registers are backed by the LPUART models in LPUARTModel.h.
+struct IMXRT_LPUART_t {
+  IMXRT_LPUART_t(host::LPUARTModel *m)
+      : VERID{m, host::LPUARTModel::kVERID},
+        PARAM{m, host::LPUARTModel::kPARAM},
+        GLOBAL{m, host::LPUARTModel::kGLOBAL},
+        PINCFG{m, host::LPUARTModel::kPINCFG},
+        BAUD{m, host::LPUARTModel::kBAUD},
+        STAT{m, host::LPUARTModel::kSTAT},
+        CTRL{m, host::LPUARTModel::kCTRL},
+        DATA{m, host::LPUARTModel::kDATA},
+        MATCH{m, host::LPUARTModel::kMATCH},
+        MODIR{m, host::LPUARTModel::kMODIR},
+        FIFO{m, host::LPUARTModel::kFIFO},
+        WATER{m, host::LPUARTModel::kWATER} {}
+
+  host::LPUARTRegister VERID;
+  host::LPUARTRegister PARAM;
+  host::LPUARTRegister GLOBAL;
+  host::LPUARTRegister PINCFG;
+  host::LPUARTRegister BAUD;
+  host::LPUARTRegister STAT;
+  host::LPUARTRegister CTRL;
+  host::LPUARTRegister DATA;
+  host::LPUARTRegister MATCH;
+  host::LPUARTRegister MODIR;
+  host::LPUARTRegister FIFO;
+  host::LPUARTRegister WATER;
+};
+
+// Returns the registers for LPUARTn, where n is 1-8.
+IMXRT_LPUART_t &hostLPUARTRegisters(int n);
+
+#define IMXRT_LPUART1 (hostLPUARTRegisters(1))
+#define IMXRT_LPUART2 (hostLPUARTRegisters(2))
+#define IMXRT_LPUART3 (hostLPUARTRegisters(3))
+#define IMXRT_LPUART4 (hostLPUARTRegisters(4))
+#define IMXRT_LPUART5 (hostLPUARTRegisters(5))
+#define IMXRT_LPUART6 (hostLPUARTRegisters(6))
+#define IMXRT_LPUART7 (hostLPUARTRegisters(7))
+#define IMXRT_LPUART8 (hostLPUARTRegisters(8))
+
+#define LPUART_BAUD_MAEN1 (1u << 31)
+#define LPUART_BAUD_MAEN2 (1u << 30)
+#define LPUART_BAUD_M10 (1u << 29)
+#define LPUART_BAUD_OSR(n) (uint32_t(((n) & 0x1f)) << 24)
+#define LPUART_BAUD_BOTHEDGE (1u << 17)
+#define LPUART_BAUD_SBNS (1u << 13)
+#define LPUART_BAUD_SBR(n) (uint32_t(((n) & 0x1fff)) << 0)
+
+#define LPUART_STAT_LBKDIF (1u << 31)
+#define LPUART_STAT_RXEDGIF (1u << 30)
+#define LPUART_STAT_MSBF (1u << 29)
+#define LPUART_STAT_RXINV (1u << 28)
+#define LPUART_STAT_RWUID (1u << 27)
+#define LPUART_STAT_BRK13 (1u << 26)
+#define LPUART_STAT_LBKDE (1u << 25)
+#define LPUART_STAT_RAF (1u << 24)
+#define LPUART_STAT_TDRE (1u << 23)
+#define LPUART_STAT_TC (1u << 22)
+#define LPUART_STAT_RDRF (1u << 21)
+#define LPUART_STAT_IDLE (1u << 20)
+#define LPUART_STAT_OR (1u << 19)
+#define LPUART_STAT_NF (1u << 18)
+#define LPUART_STAT_FE (1u << 17)
+#define LPUART_STAT_PF (1u << 16)
+
+#define LPUART_CTRL_R8T9 (1u << 31)
+#define LPUART_CTRL_R9T8 (1u << 30)
+#define LPUART_CTRL_TXDIR (1u << 29)
+#define LPUART_CTRL_TXINV (1u << 28)
+#define LPUART_CTRL_ORIE (1u << 27)
+#define LPUART_CTRL_NEIE (1u << 26)
+#define LPUART_CTRL_FEIE (1u << 25)
+#define LPUART_CTRL_PEIE (1u << 24)
+#define LPUART_CTRL_TIE (1u << 23)
+#define LPUART_CTRL_TCIE (1u << 22)
+#define LPUART_CTRL_RIE (1u << 21)
+#define LPUART_CTRL_ILIE (1u << 20)
+#define LPUART_CTRL_TE (1u << 19)
+#define LPUART_CTRL_RE (1u << 18)
+#define LPUART_CTRL_RWU (1u << 17)
+#define LPUART_CTRL_SBK (1u << 16)
+#define LPUART_CTRL_MA1IE (1u << 15)
+#define LPUART_CTRL_MA2IE (1u << 14)
+#define LPUART_CTRL_M7 (1u << 11)
+#define LPUART_CTRL_IDLECFG(n) (uint32_t(((n) & 0x07)) << 8)
+#define LPUART_CTRL_LOOPS (1u << 7)
+#define LPUART_CTRL_DOZEEN (1u << 6)
+#define LPUART_CTRL_RSRC (1u << 5)
+#define LPUART_CTRL_M (1u << 4)
+#define LPUART_CTRL_WAKE (1u << 3)
+#define LPUART_CTRL_ILT (1u << 2)
+#define LPUART_CTRL_PE (1u << 1)
+#define LPUART_CTRL_PT (1u << 0)
+
+#define LPUART_DATA_NOISY (1u << 15)
+#define LPUART_DATA_PARITYE (1u << 14)
+#define LPUART_DATA_FRETSC (1u << 13)
+#define LPUART_DATA_RXEMPT (1u << 12)
+#define LPUART_DATA_IDLINE (1u << 11)
+#define LPUART_DATA_R9T9 (1u << 9)
+#define LPUART_DATA_R8T8 (1u << 8)
+
+#define LPUART_FIFO_TXEMPT (1u << 23)
+#define LPUART_FIFO_RXEMPT (1u << 22)
+#define LPUART_FIFO_TXOF (1u << 17)
+#define LPUART_FIFO_RXUF (1u << 16)
+#define LPUART_FIFO_TXFLUSH (1u << 15)
+#define LPUART_FIFO_RXFLUSH (1u << 14)
+#define LPUART_FIFO_TXFE (1u << 7)
+#define LPUART_FIFO_TXFIFOSIZE(n) (uint32_t(((n) & 0x07)) << 4)
+#define LPUART_FIFO_RXFE (1u << 3)
+#define LPUART_FIFO_RXFIFOSIZE(n) (uint32_t(((n) & 0x07)) << 0)
+
+#define LPUART_WATER_RXCOUNT(n) (uint32_t(((n) & 0x07)) << 24)
+#define LPUART_WATER_RXWATER(n) (uint32_t(((n) & 0x03)) << 16)
+#define LPUART_WATER_TXCOUNT(n) (uint32_t(((n) & 0x07)) << 8)
+#define LPUART_WATER_TXWATER(n) (uint32_t(((n) & 0x03)) << 0)
+
+// ---------------------------------------------------------------------------
+//  Quad timer and clock gating, for InputCapture
+// ---------------------------------------------------------------------------
+
+typedef struct {
+  volatile uint16_t COMP1;
+  volatile uint16_t COMP2;
+  volatile uint16_t CAPT;
+  volatile uint16_t LOAD;
+  volatile uint16_t HOLD;
+  volatile uint16_t CNTR;
+  volatile uint16_t CTRL;
+  volatile uint16_t SCTRL;
+  volatile uint16_t CMPLD1;
+  volatile uint16_t CMPLD2;
+  volatile uint16_t CSCTRL;
+  volatile uint16_t FILT;
+  volatile uint16_t DMA;
+  volatile uint16_t unused1[2];
+  volatile uint16_t ENBL;
+} IMXRT_TMR_CH_t;
+
+typedef struct {
+  IMXRT_TMR_CH_t CH[4];
+} IMXRT_TMR_t;
+
+extern IMXRT_TMR_t IMXRT_TMR1;
+
+extern volatile uint32_t CCM_CCGR6;
+#define CCM_CCGR_ON 3
+#define CCM_CCGR6_QTIMER1(n) (uint32_t(((n) & 0x03)) << 26)
+
+#define TMR_CTRL_CM(n) (uint16_t(((n) & 0x07) << 13))
+#define TMR_CTRL_PCS(n) (uint16_t(((n) & 0x0f) << 9))
+#define TMR_CTRL_SCS(n) (uint16_t(((n) & 0x03) << 7))
+#define TMR_SCTRL_IEF (uint16_t(1 << 11))
+#define TMR_SCTRL_CAPTURE_MODE(n) (uint16_t(((n) & 0x03) << 6))
+
+#endif  // TEENSYDMX_TEST_STUBS_IMXRT_H_
@@ -0,0 +1,14 @@
+// util/atomic.h is a host stand-in for the Teensy core's ATOMIC_BLOCK.
+// Simulated interrupts only run between statements of the test program, so
+// there's nothing to disable.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_TEST_STUBS_UTIL_ATOMIC_H_
+#define TEENSYDMX_TEST_STUBS_UTIL_ATOMIC_H_
+
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_BLOCK(type) \
+  for (int atomicBlockOnce_ = 1; atomicBlockOnce_ != 0; atomicBlockOnce_ = 0)
+
+#endif  // TEENSYDMX_TEST_STUBS_UTIL_ATOMIC_H_
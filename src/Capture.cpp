@@ -0,0 +1,311 @@
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#include "Capture.h"
+
+// C++ includes
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+
+#include <core_pins.h>
+
+namespace qindesign {
+namespace teensydmx {
+
+// Flag bits in a frame record.
+static constexpr uint8_t kFlagIsShort = 0x01;
+
+// Stores a 16-bit value in little-endian order.
+static inline uint8_t *put16(uint8_t *p, uint16_t v) {
+  p[0] = static_cast<uint8_t>(v);
+  p[1] = static_cast<uint8_t>(v >> 8);
+  return p + 2;
+}
+
+// Stores a 32-bit value in little-endian order.
+static inline uint8_t *put32(uint8_t *p, uint32_t v) {
+  p[0] = static_cast<uint8_t>(v);
+  p[1] = static_cast<uint8_t>(v >> 8);
+  p[2] = static_cast<uint8_t>(v >> 16);
+  p[3] = static_cast<uint8_t>(v >> 24);
+  return p + 4;
+}
+
+// Loads a 16-bit little-endian value.
+static inline uint16_t get16(const uint8_t *p) {
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+// Loads a 32-bit little-endian value.
+static inline uint32_t get32(const uint8_t *p) {
+  return uint32_t{p[0]} | (uint32_t{p[1]} << 8) |
+         (uint32_t{p[2]} << 16) | (uint32_t{p[3]} << 24);
+}
+
+// ---------------------------------------------------------------------------
+//  MemoryCaptureSource
+// ---------------------------------------------------------------------------
+
+size_t MemoryCaptureSource::read(uint8_t *buf, size_t len) {
+  size_t n = std::min(len, size_ - pos_);
+  std::memcpy(buf, &buf_[pos_], n);
+  pos_ += n;
+  return n;
+}
+
+// ---------------------------------------------------------------------------
+//  RingBufferCapture
+// ---------------------------------------------------------------------------
+
+size_t RingBufferCapture::available() const {
+  size_t head = head_;
+  size_t tail = tail_;
+  return (head >= tail) ? head - tail : size_ - tail + head;
+}
+
+bool RingBufferCapture::write(const uint8_t *buf, size_t len) {
+  // One byte is always left empty to distinguish full from empty
+  size_t head = head_;
+  if (size_ == 0 || len > size_ - 1 - available()) {
+    droppedCount_ = droppedCount_ + 1;
+    return false;
+  }
+
+  size_t n = std::min(len, size_ - head);
+  std::memcpy(&buf_[head], buf, n);
+  std::memcpy(&buf_[0], &buf[n], len - n);
+  head += len;
+  if (head >= size_) {
+    head -= size_;
+  }
+  std::atomic_signal_fence(std::memory_order_release);
+  head_ = head;
+  return true;
+}
+
+size_t RingBufferCapture::read(uint8_t *buf, size_t len) {
+  len = std::min(len, available());
+  std::atomic_signal_fence(std::memory_order_acquire);
+
+  size_t tail = tail_;
+  size_t n = std::min(len, size_ - tail);
+  std::memcpy(buf, &buf_[tail], n);
+  std::memcpy(&buf[n], &buf_[0], len - n);
+  tail += len;
+  if (tail >= size_) {
+    tail -= size_;
+  }
+  std::atomic_signal_fence(std::memory_order_release);
+  tail_ = tail;
+  return len;
+}
+
+// ---------------------------------------------------------------------------
+//  CaptureWriter
+// ---------------------------------------------------------------------------
+
+bool CaptureWriter::begin() {
+  uint8_t header[kCaptureHeaderSize]{};
+  std::copy_n(&kCaptureMagic[0], sizeof(kCaptureMagic), &header[0]);
+  header[4] = kCaptureVersion;
+  return sink_.write(header, sizeof(header));
+}
+
+bool CaptureWriter::writeFrame(const uint8_t *buf, int size,
+                               const Receiver::PacketStats &stats) {
+  if (size < 1 || kMaxDMXPacketSize < size) {
+    droppedCount_++;
+    return false;
+  }
+
+  // Build the whole record first so that a sink sees it in one write and can
+  // keep or reject it as a unit
+  uint8_t record[kCaptureRecordHeaderSize + kMaxDMXPacketSize];
+  uint8_t *p = put16(record, static_cast<uint16_t>(size));
+  p = put32(p, stats.frameTimestamp);
+  p = put32(p, stats.breakToBreakTime);
+  p = put32(p, stats.packetTime);
+  p = put32(p, stats.breakPlusMABTime);
+  p = put32(p, stats.breakTime);
+  p = put32(p, stats.mabTime);
+  *(p++) = stats.isShort ? kFlagIsShort : 0;
+  std::memcpy(p, buf, size);
+
+  if (!sink_.write(record, kCaptureRecordHeaderSize + size)) {
+    droppedCount_++;
+    return false;
+  }
+  frameCount_++;
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+//  CaptureReader
+// ---------------------------------------------------------------------------
+
+bool CaptureReader::fill(size_t len) {
+  if (recordLen_ < len) {
+    recordLen_ += source_.read(&record_[recordLen_], len - recordLen_);
+  }
+  return recordLen_ >= len;
+}
+
+bool CaptureReader::begin() {
+  // Start over, unless a previous call only read part of the header
+  if (version_ != 0) {
+    version_ = 0;
+    recordLen_ = 0;
+  }
+  if (!fill(kCaptureHeaderSize)) {
+    return false;
+  }
+  recordLen_ = 0;
+
+  const uint8_t *header = record_;
+  if (!std::equal(&kCaptureMagic[0], &kCaptureMagic[sizeof(kCaptureMagic)],
+                  &header[0])) {
+    return false;
+  }
+  if (header[4] != kCaptureVersion) {
+    return false;
+  }
+  version_ = header[4];
+  return true;
+}
+
+int CaptureReader::readFrame(CaptureFrame *frame) {
+  if (version_ == 0) {
+    return -2;
+  }
+
+  // Keep whatever's been read in the record buffer until the whole record is
+  // there; a corrupt size leaves the header in place so that nothing more
+  // is read
+  if (!fill(kCaptureRecordHeaderSize)) {
+    if (!source_.atEnd()) {
+      return -1;
+    }
+    return (recordLen_ == 0) ? 0 : -2;
+  }
+  const uint8_t *h = record_;
+  int size = get16(&h[0]);
+  if (size < 1 || kMaxDMXPacketSize < size) {
+    return -2;
+  }
+  if (!fill(kCaptureRecordHeaderSize + size)) {
+    return source_.atEnd() ? -2 : -1;
+  }
+  recordLen_ = 0;
+
+  std::memcpy(frame->data, &record_[kCaptureRecordHeaderSize], size);
+  Receiver::PacketStats &stats = frame->stats;
+  stats = Receiver::PacketStats{};
+  stats.size = size;
+  stats.frameTimestamp   = get32(&h[2]);
+  stats.breakToBreakTime = get32(&h[6]);
+  stats.packetTime       = get32(&h[10]);
+  stats.breakPlusMABTime = get32(&h[14]);
+  stats.breakTime        = get32(&h[18]);
+  stats.mabTime          = get32(&h[22]);
+  stats.isShort = (h[26] & kFlagIsShort) != 0;
+  return size;
+}
+
+// ---------------------------------------------------------------------------
+//  CaptureReplayer
+// ---------------------------------------------------------------------------
+
+void CaptureReplayer::begin(Sender &sender) {
+  sender_ = &sender;
+  sender.pause();
+  havePending_ = false;
+  started_ = false;
+}
+
+bool CaptureReplayer::poll() {
+  if (sender_ == nullptr) {
+    return false;
+  }
+
+  if (!havePending_) {
+    int result = reader_.readFrame(&pending_);
+    if (result == -1) {
+      // Wait for more data
+      return true;
+    }
+    if (result <= 0) {
+      sender_ = nullptr;
+      return false;
+    }
+    havePending_ = true;
+  }
+
+  // Wait for the previous frame to go out and for the original inter-frame
+  // time to elapse
+  if (sender_->isTransmitting()) {
+    return true;
+  }
+  uint32_t t = micros();
+  if (started_) {
+    uint32_t delay = pending_.stats.frameTimestamp - lastFrameTimestamp_;
+    if (t - lastSendTime_ < delay) {
+      return true;
+    }
+  }
+
+  int size = pending_.stats.size;
+  sender_->setPacketSizeAndData(size, 0, pending_.data, size);
+  sender_->resumeFor(1);
+  lastFrameTimestamp_ = pending_.stats.frameTimestamp;
+  lastSendTime_ = t;
+  started_ = true;
+  havePending_ = false;
+  frameCount_++;
+  return true;
+}
+
+void CaptureReplayer::feedFrame(const CaptureFrame &frame, Responder &r,
+                                uint8_t *outBuf) {
+  // A response ends the packet at that byte
+  int size = frame.stats.size;
+  for (int len = 1; len <= size; len++) {
+    if (r.processByte(frame.data, len, outBuf) > 0) {
+      size = len;
+      break;
+    }
+  }
+  r.receivePacket(frame.data, size);
+}
+
+int CaptureReplayer::feed(uint8_t startCode, Responder &r) {
+  // Responses go nowhere, but the responder still needs somewhere to put them
+  int outBufSize = r.outputBufferSize();
+  std::unique_ptr<uint8_t[]> outBuf{
+      new uint8_t[(outBufSize > 0) ? outBufSize : 1]};
+  // Allocation may have failed on small systems
+  if (outBuf == nullptr) {
+    return 0;
+  }
+
+  int count = 0;
+  if (havePending_) {
+    havePending_ = false;
+    if (pending_.data[0] == startCode) {
+      feedFrame(pending_, r, outBuf.get());
+      count++;
+    }
+  }
+  while (reader_.readFrame(&pending_) > 0) {
+    if (pending_.data[0] == startCode) {
+      feedFrame(pending_, r, outBuf.get());
+      count++;
+    }
+  }
+  frameCount_ += count;
+  return count;
+}
+
+}  // namespace teensydmx
+}  // namespace qindesign
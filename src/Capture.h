@@ -0,0 +1,361 @@
+// Capture.h defines a compact file format for recording received DMX frames,
+// along with ways to write, read, and replay captures.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_CAPTURE_H_
+#define TEENSYDMX_CAPTURE_H_
+
+// C++ includes
+#include <cstddef>
+#include <cstdint>
+
+#include <Print.h>
+#include <Stream.h>
+
+#include "Responder.h"
+#include "TeensyDMX.h"
+
+namespace qindesign {
+namespace teensydmx {
+
+// Capture format, version 1. All multi-byte values are little-endian.
+//
+// Header, 8 bytes:
+// * Magic: "TDMX"
+// * Version: 1 byte
+// * Reserved: 3 bytes, zero
+//
+// Followed by any number of frame records, each 27 bytes plus the frame data:
+// * Size: 2 bytes, the number of slots including the start code, 1-513
+// * Frame timestamp: 4 bytes, the BREAK start time, in microseconds
+// * BREAK-to-BREAK time: 4 bytes, in microseconds
+// * Packet time: 4 bytes, in microseconds
+// * BREAK plus MAB time: 4 bytes, in microseconds
+// * BREAK time: 4 bytes, in microseconds
+// * MAB time: 4 bytes, in microseconds
+// * Flags: 1 byte, bit 0 is set for a short packet
+// * Data: "Size" bytes
+//
+// The timing values are the ones from the frame's `Receiver::PacketStats`.
+constexpr uint8_t kCaptureMagic[4]{'T', 'D', 'M', 'X'};
+constexpr uint8_t kCaptureVersion = 1;
+constexpr size_t kCaptureHeaderSize = 8;
+constexpr size_t kCaptureRecordHeaderSize = 27;
+
+// One captured frame.
+struct CaptureFrame {
+  Receiver::PacketStats stats;
+  uint8_t data[kMaxDMXPacketSize];
+};
+
+// ---------------------------------------------------------------------------
+//  Sinks and sources
+// ---------------------------------------------------------------------------
+
+// Where capture bytes get written.
+class CaptureSink {
+ public:
+  virtual ~CaptureSink() = default;
+
+  // Writes all the bytes and returns whether successful. A failed write should
+  // ideally not write anything.
+  virtual bool write(const uint8_t *buf, size_t len) = 0;
+};
+
+// Where capture bytes get read from.
+class CaptureSource {
+ public:
+  virtual ~CaptureSource() = default;
+
+  // Reads up to `len` bytes and returns the number actually read. A return
+  // value less than `len` means there's no more data available right now.
+  // `CaptureReader` keeps any partial record, so reading can continue where it
+  // left off once more data is available.
+  virtual size_t read(uint8_t *buf, size_t len) = 0;
+
+  // Returns whether there's no more data and never will be, for example at
+  // the end of a file. A source that's still being filled, such as a ring
+  // buffer or a serial port, never ends. The default returns `false`.
+  virtual bool atEnd() {
+    return false;
+  }
+};
+
+// Writes to any `Print`, for example a file on an SD card or a serial port.
+class PrintCaptureSink final : public CaptureSink {
+ public:
+  explicit PrintCaptureSink(Print &p)
+      : print_(p) {}
+
+  ~PrintCaptureSink() override = default;
+
+  bool write(const uint8_t *buf, size_t len) override {
+    return print_.write(buf, len) == len;
+  }
+
+ private:
+  Print &print_;
+};
+
+// Reads from any `Stream`, for example a file on an SD card.
+//
+// This uses `Stream::readBytes`, which waits for up to the stream's timeout,
+// one second by default, whenever fewer than the requested bytes are
+// available. With a serial port or other slow stream, that blocks
+// `CaptureReplayer::poll()` and ruins the replay timing. Set the stream's
+// timeout to zero with `setTimeout(0)` to read only what's already available.
+//
+// A stream has no end-of-data indication of its own, so `isFinite` says
+// whether running out of bytes means the end, as for a file, or only that
+// more are on the way, as for a serial port.
+class StreamCaptureSource final : public CaptureSource {
+ public:
+  explicit StreamCaptureSource(Stream &s, bool isFinite = true)
+      : stream_(s),
+        isFinite_(isFinite) {}
+
+  ~StreamCaptureSource() override = default;
+
+  size_t read(uint8_t *buf, size_t len) override {
+    return stream_.readBytes(buf, len);
+  }
+
+  bool atEnd() override {
+    return isFinite_ && stream_.available() <= 0;
+  }
+
+ private:
+  Stream &stream_;
+  const bool isFinite_;
+};
+
+// Reads from a block of memory, for example a capture stored in flash.
+class MemoryCaptureSource final : public CaptureSource {
+ public:
+  MemoryCaptureSource(const uint8_t *buf, size_t size)
+      : buf_(buf),
+        size_(size),
+        pos_(0) {}
+
+  ~MemoryCaptureSource() override = default;
+
+  size_t read(uint8_t *buf, size_t len) override;
+
+  bool atEnd() override {
+    return pos_ >= size_;
+  }
+
+  // Starts reading from the beginning again.
+  void rewind() {
+    pos_ = 0;
+  }
+
+ private:
+  const uint8_t *buf_;
+  size_t size_;
+  size_t pos_;
+};
+
+// A ring buffer that's both a sink and a source, using memory supplied by the
+// caller. Writes are all-or-nothing: if there isn't enough space for all the
+// bytes then nothing is written and the write is counted as dropped.
+//
+// One writer and one reader can use this concurrently without a lock, for
+// example a writer in a `Receiver::onPacketReady` function and a reader in the
+// main loop that saves the data somewhere.
+class RingBufferCapture final : public CaptureSink, public CaptureSource {
+ public:
+  RingBufferCapture(uint8_t *buf, size_t size)
+      : buf_(buf),
+        size_(size),
+        head_(0),
+        tail_(0),
+        droppedCount_(0) {}
+
+  ~RingBufferCapture() override = default;
+
+  bool write(const uint8_t *buf, size_t len) override;
+  size_t read(uint8_t *buf, size_t len) override;
+
+  // Returns the number of bytes available for reading.
+  size_t available() const;
+
+  // Returns the number of writes dropped because there wasn't enough space.
+  uint32_t droppedCount() const {
+    return droppedCount_;
+  }
+
+ private:
+  uint8_t *buf_;
+  size_t size_;
+  volatile size_t head_;  // Total bytes written, modulo the size; written
+                          // only by the writer
+  volatile size_t tail_;  // Total bytes read, modulo the size; written only by
+                          // the reader
+  volatile uint32_t droppedCount_;
+};
+
+// ---------------------------------------------------------------------------
+//  Writing and reading
+// ---------------------------------------------------------------------------
+
+// Writes a capture to a sink.
+class CaptureWriter final {
+ public:
+  explicit CaptureWriter(CaptureSink &sink)
+      : sink_(sink),
+        frameCount_(0),
+        droppedCount_(0) {}
+
+  ~CaptureWriter() = default;
+
+  // Writes the header. This returns whether successful.
+  bool begin();
+
+  // Writes one frame. The size must be in the range 1-513. This returns
+  // whether successful; failures are counted by `droppedCount()`.
+  //
+  // A typical use is to call this with the data and stats from
+  // `Receiver::readPacket`.
+  bool writeFrame(const uint8_t *buf, int size,
+                  const Receiver::PacketStats &stats);
+
+  // Returns the number of frames written.
+  uint32_t frameCount() const {
+    return frameCount_;
+  }
+
+  // Returns the number of frames that couldn't be written.
+  uint32_t droppedCount() const {
+    return droppedCount_;
+  }
+
+ private:
+  CaptureSink &sink_;
+  uint32_t frameCount_;
+  uint32_t droppedCount_;
+};
+
+// Reads a capture from a source.
+class CaptureReader final {
+ public:
+  explicit CaptureReader(CaptureSource &source)
+      : source_(source),
+        version_(0),
+        record_{0},
+        recordLen_(0) {}
+
+  ~CaptureReader() = default;
+
+  // Reads and validates the header. This returns whether the source contains
+  // a supported capture. If the source doesn't have the whole header yet then
+  // the bytes read so far are kept and the next call continues from there.
+  bool begin();
+
+  // Reads the next frame. Only the timing values stored in the capture are set
+  // in the frame's stats. This returns one of:
+  // * The frame size, 1-513, if a frame was read.
+  // * Zero at the end of the capture, when the source has ended exactly at
+  //   a frame boundary.
+  // * -1 if the next frame isn't complete yet. A partial frame is kept, and
+  //   the next call continues from there, so a source that runs dry part way
+  //   through a frame doesn't lose its place.
+  // * -2 if the data is corrupt, the source ended part way through a frame,
+  //   or `begin()` hasn't succeeded. Once the data is found to be corrupt,
+  //   this always returns -2.
+  int readFrame(CaptureFrame *frame);
+
+  // Returns the capture version, or zero if `begin()` hasn't succeeded.
+  int version() const {
+    return version_;
+  }
+
+ private:
+  // Reads from the source until the record buffer holds `len` bytes. This
+  // returns whether it does.
+  bool fill(size_t len);
+
+  CaptureSource &source_;
+  int version_;
+
+  // The header or record being read, and how much of it has been read so far.
+  uint8_t record_[kCaptureRecordHeaderSize + kMaxDMXPacketSize];
+  size_t recordLen_;
+};
+
+// ---------------------------------------------------------------------------
+//  Replay
+// ---------------------------------------------------------------------------
+
+// Replays a capture into a `Sender`, using the original BREAK-to-BREAK timing,
+// or into a `Responder`, the way a `Receiver` calls it.
+//
+// For a `Sender`, call `begin`, and then call `poll()` often, for example every
+// time through the main loop. The sender is paused and each frame is sent with
+// `resumeFor(1)` once the time between its BREAK and the previous frame's BREAK
+// has elapsed. The timing is therefore only as accurate as the polling rate.
+class CaptureReplayer final {
+ public:
+  explicit CaptureReplayer(CaptureReader &reader)
+      : reader_(reader),
+        sender_(nullptr),
+        havePending_(false),
+        started_(false),
+        lastFrameTimestamp_(0),
+        lastSendTime_(0),
+        frameCount_(0),
+        pending_{} {}
+
+  ~CaptureReplayer() = default;
+
+  // Starts replaying into the given sender. This pauses the sender. The sender
+  // should already have been started with `begin()`.
+  void begin(Sender &sender);
+
+  // Sends the next frame if it's time. If the source has run dry part way
+  // through the capture, this keeps waiting for more data. This returns
+  // `false` when the capture has been fully replayed, if the data is corrupt,
+  // or if `begin` wasn't called.
+  bool poll();
+
+  // Returns the number of frames sent or fed so far.
+  uint32_t frameCount() const {
+    return frameCount_;
+  }
+
+  // Feeds all the available frames, as fast as possible, to the given
+  // responder, skipping frames whose start code the responder doesn't want.
+  // This returns the number of frames fed. This is useful for running offline
+  // regressions against real-world traffic.
+  //
+  // Each frame is passed to `Responder::processByte` one byte at a time and
+  // then to `Responder::receivePacket`, as a `Receiver` does. If
+  // `processByte` asks to respond, the packet ends at that byte, but the
+  // response isn't sent anywhere. There's no reader, so `eatPacket()` doesn't
+  // matter here. To run frames through the whole receive path instead, with
+  // their timing, the host tests can send them into a simulated `Receiver`.
+  //
+  // The `startCode` argument is the start code the responder would have been
+  // registered with using `Receiver::setResponder`.
+  int feed(uint8_t startCode, Responder &r);
+
+ private:
+  CaptureReader &reader_;
+  Sender *sender_;
+  bool havePending_;
+  bool started_;
+  uint32_t lastFrameTimestamp_;
+  uint32_t lastSendTime_;
+  uint32_t frameCount_;
+  CaptureFrame pending_;
+
+  // Passes one frame to a responder, as a `Receiver` would.
+  static void feedFrame(const CaptureFrame &frame, Responder &r,
+                        uint8_t *outBuf);
+};
+
+}  // namespace teensydmx
+}  // namespace qindesign
+
+#endif  // TEENSYDMX_CAPTURE_H_
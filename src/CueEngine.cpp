@@ -0,0 +1,180 @@
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#include "CueEngine.h"
+
+// C++ includes
+#include <algorithm>
+
+#include <util/atomic.h>
+
+namespace qindesign {
+namespace teensydmx {
+
+CueEngine::CueEngine(int startChannel, int count)
+    : startChannel_(std::min(std::max(startChannel, 1), kMaxDMXPacketSize - 1)),
+      count_(std::min(std::max(count, 0), kMaxDMXPacketSize - startChannel_)),
+      request_(Requests::kNone),
+      requestStack_(nullptr),
+      requestCue_(0),
+      stack_(nullptr),
+      cue_(0),
+      state_(States::kStopped),
+      elapsed_(0),
+      from_{0},
+      to_{0} {}
+
+bool CueEngine::play(const CueStack &stack, int cue) {
+  if (stack.cues == nullptr || cue < 0 || stack.count <= cue) {
+    return false;
+  }
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    requestStack_ = &stack;
+    requestCue_ = cue;
+    request_ = Requests::kPlay;
+  }
+  return true;
+}
+
+void CueEngine::go() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (request_ == Requests::kNone) {
+      request_ = Requests::kGo;
+    }
+  }
+}
+
+bool CueEngine::goTo(int cue) {
+  bool retval = false;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    // A pending play request just changes its starting cue
+    if (request_ == Requests::kPlay) {
+      if (0 <= cue && cue < requestStack_->count) {
+        requestCue_ = cue;
+        retval = true;
+      }
+    } else if (state_ != States::kStopped && request_ != Requests::kStop) {
+      if (0 <= cue && cue < stack_->count) {
+        requestCue_ = cue;
+        request_ = Requests::kGoTo;
+        retval = true;
+      }
+    }
+  }
+  return retval;
+}
+
+void CueEngine::stop() {
+  request_ = Requests::kStop;
+}
+
+void CueEngine::renderScene(const Scene &scene, uint8_t *out,
+                            int startChannel, int count) {
+  // Apply the chain of scenes from the outermost base inwards
+  const Scene *chain[Scene::kMaxDepth];
+  int depth = 0;
+  for (const Scene *s = &scene; s != nullptr && depth < Scene::kMaxDepth;
+       s = s->base) {
+    chain[depth++] = s;
+  }
+
+  std::fill_n(out, count, uint8_t{0});
+  while (--depth >= 0) {
+    const Scene *s = chain[depth];
+    for (int i = 0; i < s->count; i++) {
+      unsigned index = s->entries[i].channel - startChannel;
+      if (index < static_cast<unsigned>(count)) {
+        out[index] = s->entries[i].value;
+      }
+    }
+  }
+}
+
+void CueEngine::startCue(int cue, const uint8_t *buf) {
+  cue_ = cue;
+  std::copy_n(buf, count_, from_);
+  const Scene *scene = stack_->cues[cue].scene;
+  if (scene != nullptr) {
+    renderScene(*scene, to_, startChannel_, count_);
+  } else {
+    std::fill_n(to_, count_, uint8_t{0});
+  }
+  elapsed_ = 0;
+  state_ = States::kFading;
+}
+
+void CueEngine::writeFade(uint8_t *buf) const {
+  // Fraction of the fade done, in 16.16 fixed-point
+  int32_t p = (elapsed_ << 16) / stack_->cues[cue_].fadeFrames;
+  for (int i = 0; i < count_; i++) {
+    int32_t delta = to_[i] - from_[i];
+    buf[i] = static_cast<uint8_t>(from_[i] + ((delta*p + 0x8000) >> 16));
+  }
+}
+
+void CueEngine::followCue(uint8_t *buf) {
+  int next = cue_ + 1;
+  if (next >= stack_->count) {
+    if (stack_->loopTo < 0 || stack_->count <= stack_->loopTo) {
+      state_ = States::kStopped;
+      return;
+    }
+    next = stack_->loopTo;
+  }
+  startCue(next, buf);
+}
+
+void CueEngine::advanceFade(uint8_t *buf) {
+  const Cue &cue = stack_->cues[cue_];
+  if (++elapsed_ < cue.fadeFrames) {
+    writeFade(buf);
+    return;
+  }
+
+  // Land exactly on the scene
+  std::copy_n(to_, count_, buf);
+  elapsed_ = 0;
+  state_ = (cue.holdFrames == Cue::kWaitForGo) ? States::kWaiting
+                                               : States::kHolding;
+}
+
+void CueEngine::processFrame(uint8_t *buf, int size) {
+  uint8_t *out = &buf[startChannel_];
+
+  // Apply any request
+  Requests request = request_;
+  request_ = Requests::kNone;
+  switch (request) {
+    case Requests::kPlay:
+      stack_ = requestStack_;
+      startCue(requestCue_, out);
+      break;
+    case Requests::kGoTo:
+      if (state_ != States::kStopped) {
+        startCue(requestCue_, out);
+      }
+      break;
+    case Requests::kGo:
+      if (state_ != States::kStopped) {
+        followCue(out);
+      }
+      break;
+    case Requests::kStop:
+      state_ = States::kStopped;
+      break;
+    default:
+      break;
+  }
+
+  if (state_ == States::kHolding &&
+      ++elapsed_ >= stack_->cues[cue_].holdFrames) {
+    followCue(out);
+  }
+  if (state_ == States::kFading) {
+    advanceFade(out);
+  }
+}
+
+}  // namespace teensydmx
+}  // namespace qindesign
@@ -0,0 +1,212 @@
+// CueEngine.h defines a frame processor that plays back stacks of preloaded
+// cues, for standalone operation without a console. Scenes are stored as
+// sparse channel lists that can build on other scenes, and are meant to live in
+// flash.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_CUEENGINE_H_
+#define TEENSYDMX_CUEENGINE_H_
+
+// C++ includes
+#include <cstddef>
+#include <cstdint>
+
+#include "FrameProcessor.h"
+#include "TeensyDMX.h"
+
+namespace qindesign {
+namespace teensydmx {
+
+// One channel value in a scene.
+struct SceneEntry final {
+  uint16_t channel;  // 1-512
+  uint8_t value;
+};
+
+// A scene, a sparse list of channel values. Channels not listed are zero,
+// unless the scene has a base scene, in which case the entries are applied on
+// top of the base. This allows similar scenes to share storage: store the
+// common look once and each variation as only the channels that differ.
+//
+// The entries and scenes are meant to be `const` so that they can live in
+// flash. For example:
+// ```
+// const SceneEntry kWarmEntries[]{{1, 255}, {2, 180}, {3, 60}};
+// const Scene kWarm{kWarmEntries};
+// const SceneEntry kWarmBlueEntries[]{{3, 255}};
+// const Scene kWarmBlue{kWarmBlueEntries, &kWarm};
+// ```
+struct Scene final {
+  // The maximum depth of a chain of base scenes. Bases beyond this depth are
+  // ignored, which also guards against cycles.
+  static constexpr int kMaxDepth = 8;
+
+  // Creates a scene from an array of entries.
+  template <size_t N>
+  constexpr Scene(const SceneEntry (&entries)[N], const Scene *base = nullptr)
+      : entries(entries),
+        count(N),
+        base(base) {}
+
+  // Creates a scene from a pointer to entries, for example if they're built at
+  // runtime. The base is required so that this can't be confused with the
+  // array version.
+  constexpr Scene(const SceneEntry *entries, int count, const Scene *base)
+      : entries(entries),
+        count(count),
+        base(base) {}
+
+  const SceneEntry *entries;
+  int count;
+  const Scene *base;
+};
+
+// A cue: a scene, how long to fade to it, and how long to hold it before
+// following on to the next cue. Times are in frames.
+struct Cue final {
+  // A hold time meaning "wait for `CueEngine::go()`".
+  static constexpr uint16_t kWaitForGo = UINT16_MAX;
+
+  const Scene *scene;
+  uint16_t fadeFrames;
+  uint16_t holdFrames;  // kWaitForGo to wait
+};
+
+// An ordered list of cues. After the last cue, playback either stops or loops
+// back to the `loopTo` cue.
+struct CueStack final {
+  // Creates a stack from an array of cues.
+  template <size_t N>
+  constexpr CueStack(const Cue (&cues)[N], int loopTo = -1)
+      : cues(cues),
+        count(N),
+        loopTo(loopTo) {}
+
+  // Creates a stack from a pointer to cues. The loop setting is required so
+  // that this can't be confused with the array version.
+  constexpr CueStack(const Cue *cues, int count, int loopTo)
+      : cues(cues),
+        count(count),
+        loopTo(loopTo) {}
+
+  const Cue *cues;
+  int count;
+  int loopTo;  // Negative to stop after the last cue
+};
+
+// Plays cue stacks. Each cue crossfades the engine's channels from whatever
+// they held when the cue started to the cue's scene, using the same linear
+// interpolation every frame, and then holds. The engine is evaluated by the
+// sender's ISR, so playback is locked to the transmitted frames and needs
+// nothing from the main loop.
+//
+// To use it, add it to a sender with `Sender::addFrameProcessor` and call
+// `play`. Requests made with `play`, `go`, `goTo`, and `stop` take effect at
+// the next frame.
+//
+// The engine controls a contiguous range of channels, set in the constructor;
+// channels outside the range are left alone. It uses two buffers of the size of
+// the range, about 1kB for all 512 channels, in addition to the scenes, which
+// take 4 bytes per entry.
+class CueEngine final : public FrameProcessor {
+ public:
+  // Playback states.
+  enum class States {
+    kStopped,  // Not playing
+    kFading,   // Fading to the current cue
+    kHolding,  // Holding the current cue
+    kWaiting,  // Holding the current cue until `go()`
+  };
+
+  // Creates an engine that controls `count` channels starting at
+  // `startChannel`. These are clamped to the range 1-512.
+  explicit CueEngine(int startChannel = 1, int count = kMaxDMXPacketSize - 1);
+
+  ~CueEngine() = default;
+
+  // Starts playing a cue stack at the given cue. The stack must stay valid for
+  // as long as it's playing. This returns `false` if the stack is empty or the
+  // cue index isn't in the stack, and `true` otherwise.
+  bool play(const CueStack &stack, int cue = 0);
+
+  // Goes to the next cue immediately, without waiting for the current fade or
+  // hold to finish. After the last cue, this follows the stack's loop setting.
+  // This does nothing if stopped or if a `play` or `goTo` request hasn't yet
+  // taken effect.
+  void go();
+
+  // Goes to the given cue in the current stack. This returns `false` if
+  // stopped or if the index isn't in the stack, and `true` otherwise.
+  bool goTo(int cue);
+
+  // Stops playback, leaving the channels at their current values.
+  void stop();
+
+  // Returns the current playback state.
+  States state() const {
+    return state_;
+  }
+
+  // Returns the index of the current cue, or -1 if stopped.
+  int currentCue() const {
+    return (state_ == States::kStopped) ? -1 : cue_;
+  }
+
+  // Writes the values of `count` channels of a scene, including those of its
+  // base scenes, into `out`, starting at `startChannel`. In other words,
+  // `out[0]` receives the value for `startChannel`. Channels the scene doesn't
+  // list are set to zero.
+  static void renderScene(const Scene &scene, uint8_t *out,
+                          int startChannel, int count);
+
+  // Advances playback by one frame. This is called by the sender.
+  void processFrame(uint8_t *buf, int size) override;
+
+ private:
+  // Requests from the main loop.
+  enum class Requests {
+    kNone,
+    kPlay,
+    kGoTo,
+    kGo,
+    kStop,
+  };
+
+  // Starts a cue, with `buf` being the current output.
+  void startCue(int cue, const uint8_t *buf);
+
+  // Starts the cue after the current one, following the stack's loop setting.
+  // This stops playback after the last cue if the stack doesn't loop.
+  void followCue(uint8_t *buf);
+
+  // Advances the current fade by one frame and writes the values into `buf`.
+  // At the end of the fade, this starts holding.
+  void advanceFade(uint8_t *buf);
+
+  // Writes the interpolated values for the current fade into `buf`.
+  void writeFade(uint8_t *buf) const;
+
+  const int startChannel_;
+  const int count_;
+
+  // Requests, applied at the next frame
+  volatile Requests request_;
+  const CueStack *volatile requestStack_;
+  volatile int requestCue_;
+
+  // Playback
+  const CueStack *stack_;
+  int cue_;
+  volatile States state_;
+  uint32_t elapsed_;  // Frames into the fade or hold
+
+  // Crossfade endpoints, indexed from the start channel
+  uint8_t from_[kMaxDMXPacketSize - 1];
+  uint8_t to_[kMaxDMXPacketSize - 1];
+};
+
+}  // namespace teensydmx
+}  // namespace qindesign
+
+#endif  // TEENSYDMX_CUEENGINE_H_
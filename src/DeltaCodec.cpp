@@ -0,0 +1,281 @@
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#include "DeltaCodec.h"
+
+// C++ includes
+#include <cstring>
+
+namespace qindesign {
+namespace teensydmx {
+
+// Size of the common frame header.
+static constexpr int kHeaderSize = 3;
+
+// Size of a delta range header. Unchanged gaps no bigger than this are merged
+// into the surrounding ranges because that's never larger than starting a
+// new range.
+static constexpr int kRangeHeaderSize = 4;
+
+// Maximum number of slots in one PackBits run.
+static constexpr int kMaxRun = 128;
+
+// Stores a 16-bit value in little-endian order.
+static inline uint8_t *put16(uint8_t *p, int v) {
+  p[0] = static_cast<uint8_t>(v);
+  p[1] = static_cast<uint8_t>(v >> 8);
+  return p + 2;
+}
+
+// Loads a 16-bit little-endian value.
+static inline int get16(const uint8_t *p) {
+  return p[0] | (p[1] << 8);
+}
+
+// ---------------------------------------------------------------------------
+//  DeltaEncoder
+// ---------------------------------------------------------------------------
+
+int DeltaEncoder::encode(const uint8_t *frame, int size, uint8_t *out) {
+  if (size < 1 || kMaxDMXPacketSize < size) {
+    return 0;
+  }
+
+  int n = 0;
+  if (prevSize_ == size &&
+      (keyframeInterval_ <= 0 || framesSinceKeyframe_ < keyframeInterval_)) {
+    n = encodeDelta(frame, size, out);
+  }
+  if (n > 0) {
+    if (keyframeInterval_ > 0) {
+      framesSinceKeyframe_++;
+    }
+    lastWasKeyframe_ = false;
+    return n;
+  }
+
+  n = encodeKeyframe(frame, size, out);
+  std::memcpy(prev_, frame, size);
+  prevSize_ = size;
+  framesSinceKeyframe_ = 1;
+  lastWasKeyframe_ = true;
+  return n;
+}
+
+int DeltaEncoder::encodeKeyframe(const uint8_t *frame, int size,
+                                 uint8_t *out) {
+  out[0] = kDeltaKeyframe;
+  uint8_t *p = put16(&out[1], size);
+
+  int i = 0;
+  while (i < size) {
+    // Repeated run
+    int run = 1;
+    while (i + run < size && run < kMaxRun && frame[i + run] == frame[i]) {
+      run++;
+    }
+    if (run >= 3) {
+      *(p++) = static_cast<uint8_t>(1 - run);
+      *(p++) = frame[i];
+      i += run;
+      continue;
+    }
+
+    // Literal run, up to the start of the next repeated run
+    uint8_t *count = p++;
+    int start = i;
+    while (i < size && i - start < kMaxRun) {
+      if (i + 2 < size && frame[i] == frame[i + 1] &&
+          frame[i] == frame[i + 2]) {
+        break;
+      }
+      *(p++) = frame[i++];
+    }
+    *count = static_cast<uint8_t>(i - start - 1);
+  }
+
+  return p - out;
+}
+
+int DeltaEncoder::encodeDelta(const uint8_t *frame, int size, uint8_t *out) {
+  out[0] = kDeltaFrame;
+  put16(&out[1], size);
+  uint8_t *p = &out[kHeaderSize + 1];
+  int count = 0;
+  int lastEnd = 0;
+
+  int i = 0;
+  while (i < size) {
+    // Skip unchanged slots a word at a time, then a byte at a time
+    if (i + 4 <= size) {
+      uint32_t a;
+      uint32_t b;
+      std::memcpy(&a, &frame[i], 4);
+      std::memcpy(&b, &prev_[i], 4);
+      if (a == b) {
+        i += 4;
+        continue;
+      }
+    }
+    if (frame[i] == prev_[i]) {
+      i++;
+      continue;
+    }
+
+    // Find the end of the range, merging small unchanged gaps
+    int start = i;
+    int end = i + 1;
+    for (int j = end; j < size; j++) {
+      if (frame[j] != prev_[j]) {
+        end = j + 1;
+      } else if (j + 1 - end > kRangeHeaderSize) {
+        break;
+      }
+    }
+
+    // Give up if this wouldn't be smaller than the raw frame
+    int len = end - start;
+    if (count >= 255 || (p - out) + kRangeHeaderSize + len >= size) {
+      return 0;
+    }
+    p = put16(p, start - lastEnd);
+    p = put16(p, len);
+    std::memcpy(p, &frame[start], len);
+    std::memcpy(&prev_[start], &frame[start], len);
+    p += len;
+    count++;
+    lastEnd = end;
+    i = end;
+  }
+
+  out[kHeaderSize] = static_cast<uint8_t>(count);
+  return p - out;
+}
+
+// ---------------------------------------------------------------------------
+//  DeltaDecoder
+// ---------------------------------------------------------------------------
+
+int DeltaDecoder::decode(const uint8_t *in, int len, int *consumed) {
+  if (len < kHeaderSize) {
+    return -1;
+  }
+  int size = get16(&in[1]);
+  if (size < 1 || kMaxDMXPacketSize < size) {
+    reset();
+    return -2;
+  }
+
+  int pos = kHeaderSize;
+
+  switch (in[0]) {
+    case kDeltaKeyframe: {
+      // Validate everything before changing the frame
+      int i = 0;
+      while (i < size) {
+        if (pos >= len) {
+          return -1;
+        }
+        int n = static_cast<int8_t>(in[pos++]);
+        int dataLen = 0;
+        if (n >= 0) {
+          n++;
+          dataLen = n;
+        } else if (n != -128) {
+          n = 1 - n;
+          dataLen = 1;
+        } else {
+          continue;
+        }
+        if (i + n > size) {
+          reset();
+          return -2;
+        }
+        if (pos + dataLen > len) {
+          return -1;
+        }
+        pos += dataLen;
+        i += n;
+      }
+
+      pos = kHeaderSize;
+      i = 0;
+      while (i < size) {
+        int n = static_cast<int8_t>(in[pos++]);
+        if (n >= 0) {
+          n++;
+          std::memcpy(&frame_[i], &in[pos], n);
+          pos += n;
+          i += n;
+        } else if (n != -128) {
+          n = 1 - n;
+          std::memset(&frame_[i], in[pos++], n);
+          i += n;
+        }
+      }
+      size_ = size;
+      break;
+    }
+
+    case kDeltaFrame: {
+      // Validate everything before changing the frame
+      if (len < kHeaderSize + 1) {
+        return -1;
+      }
+      int count = in[pos++];
+      int dataStart = pos;
+      int i = 0;
+      for (int r = 0; r < count; r++) {
+        if (pos + kRangeHeaderSize > len) {
+          return -1;
+        }
+        int n = get16(&in[pos + 2]);
+        i += get16(&in[pos]) + n;
+        pos += kRangeHeaderSize;
+        if (i > size) {
+          reset();
+          return -2;
+        }
+        if (pos + n > len) {
+          return -1;
+        }
+        pos += n;
+      }
+
+      if (size_ == 0) {
+        if (consumed != nullptr) {
+          *consumed = pos;
+        }
+        return 0;
+      }
+      if (size_ != size) {
+        reset();
+        return -2;
+      }
+
+      pos = dataStart;
+      i = 0;
+      for (int r = 0; r < count; r++) {
+        int n = get16(&in[pos + 2]);
+        i += get16(&in[pos]);
+        pos += kRangeHeaderSize;
+        std::memcpy(&frame_[i], &in[pos], n);
+        pos += n;
+        i += n;
+      }
+      break;
+    }
+
+    default:
+      reset();
+      return -2;
+  }
+
+  if (consumed != nullptr) {
+    *consumed = pos;
+  }
+  return size_;
+}
+
+}  // namespace teensydmx
+}  // namespace qindesign
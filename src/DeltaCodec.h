@@ -0,0 +1,167 @@
+// DeltaCodec.h defines a compact encoding for logging streams of DMX frames.
+// Each frame is stored as the ranges that changed since the previous frame,
+// with a periodic run-length encoded keyframe so that a log can be decoded
+// starting from the middle.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_DELTACODEC_H_
+#define TEENSYDMX_DELTACODEC_H_
+
+// C++ includes
+#include <cstdint>
+
+#include "TeensyDMX.h"
+
+namespace qindesign {
+namespace teensydmx {
+
+// Encoded frame format. All multi-byte values are little-endian.
+//
+// Every encoded frame starts with a 3-byte header:
+// * Type: 1 byte, kDeltaKeyframe or kDeltaFrame
+// * Size: 2 bytes, the number of slots including the start code, 1-513
+//
+// A keyframe is followed by the whole frame, compressed with PackBits
+// run-length encoding. Each run starts with a count byte, n, interpreted as a
+// signed value:
+// * 0 to 127: n+1 literal bytes follow
+// * -1 to -127: the next byte is repeated 1-n times
+// * -128: ignored
+//
+// A delta frame is followed by a range count, 1 byte, and then that many
+// changed ranges, each having:
+// * Skip: 2 bytes, the number of unchanged slots since the end of the previous
+//   range, or since the start of the frame for the first range
+// * Length: 2 bytes, the number of changed slots
+// * Data: "Length" bytes
+//
+// A frame that hasn't changed is therefore 4 bytes. A delta frame is only
+// emitted if the size didn't change.
+constexpr uint8_t kDeltaKeyframe = 0x01;
+constexpr uint8_t kDeltaFrame    = 0x02;
+
+// The size of the largest possible encoded frame.
+constexpr int kMaxDeltaEncodedSize =
+    3 + kMaxDMXPacketSize + (kMaxDMXPacketSize + 127)/128;
+
+// Encodes frames. This keeps a copy of the previous frame.
+//
+// Encoding a frame is a single pass over its bytes and doesn't allocate memory.
+// Unchanged spans are compared four slots at a time.
+class DeltaEncoder final {
+ public:
+  // Creates a new encoder that emits a keyframe every `keyframeInterval`
+  // frames. An interval of zero or less means that only the first frame and
+  // frames whose size changes will be keyframes.
+  explicit DeltaEncoder(int keyframeInterval = 44)
+      : keyframeInterval_(keyframeInterval),
+        framesSinceKeyframe_(0),
+        prevSize_(0),
+        lastWasKeyframe_(false),
+        prev_{} {}
+
+  ~DeltaEncoder() = default;
+
+  // Support common use of this object
+  DeltaEncoder(const DeltaEncoder &) = default;
+  DeltaEncoder(DeltaEncoder &&) = default;
+  DeltaEncoder &operator=(const DeltaEncoder &) = default;
+  DeltaEncoder &operator=(DeltaEncoder &&) = default;
+
+  // Makes the next frame a keyframe. This is useful, for example, when starting
+  // a new log file.
+  void reset() {
+    prevSize_ = 0;
+  }
+
+  // Encodes a frame into `out`, which must have space for at least
+  // `kMaxDeltaEncodedSize` bytes. This returns the encoded size, or zero if
+  // `size` isn't in the range 1-513.
+  int encode(const uint8_t *frame, int size, uint8_t *out);
+
+  // Returns whether the last encoded frame was a keyframe.
+  bool lastWasKeyframe() const {
+    return lastWasKeyframe_;
+  }
+
+ private:
+  // Encodes a keyframe and returns its size.
+  int encodeKeyframe(const uint8_t *frame, int size, uint8_t *out);
+
+  // Encodes a delta frame, updates the previous frame, and returns the encoded
+  // size. This returns zero if the frame wouldn't be smaller than the raw data,
+  // in which case a keyframe should be used instead; the previous frame may
+  // then be partially updated.
+  int encodeDelta(const uint8_t *frame, int size, uint8_t *out);
+
+  int keyframeInterval_;
+  int framesSinceKeyframe_;
+  int prevSize_;  // Zero means there's no previous frame
+  bool lastWasKeyframe_;
+  uint8_t prev_[kMaxDMXPacketSize];
+};
+
+// Decodes frames produced by `DeltaEncoder`. This keeps a copy of the current
+// frame.
+class DeltaDecoder final {
+ public:
+  constexpr DeltaDecoder()
+      : size_(0),
+        frame_{} {}
+
+  ~DeltaDecoder() = default;
+
+  // Support common use of this object
+  DeltaDecoder(const DeltaDecoder &) = default;
+  DeltaDecoder(DeltaDecoder &&) = default;
+  DeltaDecoder &operator=(const DeltaDecoder &) = default;
+  DeltaDecoder &operator=(DeltaDecoder &&) = default;
+
+  // Forgets the current frame, so that decoding resumes at the next keyframe.
+  // This is useful after seeking.
+  void reset() {
+    size_ = 0;
+  }
+
+  // Decodes one encoded frame from the start of `in`, which contains `len`
+  // bytes. This returns one of:
+  // * The decoded frame size, 1-513, if a frame was decoded. The frame is
+  //   available from `frame()`.
+  // * Zero if a delta frame was skipped because there hasn't yet been
+  //   a keyframe.
+  // * -1 if the data is incomplete. This doesn't change anything, so the call
+  //   can be repeated once more data is available.
+  // * -2 if the data is corrupt. This resets the decoder, so decoding resumes
+  //   at the next keyframe. The caller has to find the next frame itself, for
+  //   example from its own record framing.
+  //
+  // For the first two results, the number of encoded bytes consumed is stored
+  // in `consumed`, if not NULL.
+  int decode(const uint8_t *in, int len, int *consumed = nullptr);
+
+  // Returns whether a keyframe has been seen, i.e. whether frames can
+  // be decoded.
+  bool synced() const {
+    return size_ > 0;
+  }
+
+  // Returns the current frame's size, or zero if not synced.
+  int size() const {
+    return size_;
+  }
+
+  // Returns the current frame data.
+  const uint8_t *frame() const {
+    return frame_;
+  }
+
+ private:
+  int size_;  // Zero means not synced
+  uint8_t frame_[kMaxDMXPacketSize];
+};
+
+}  // namespace teensydmx
+}  // namespace qindesign
+
+#endif  // TEENSYDMX_DELTACODEC_H_
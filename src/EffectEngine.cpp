@@ -0,0 +1,231 @@
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#include "EffectEngine.h"
+
+#include <util/atomic.h>
+
+namespace qindesign {
+namespace teensydmx {
+
+// One cycle of a sine wave, starting and ending at its lowest point:
+// 127.5 - 127.5*cos(2πi/256).
+static const uint8_t kSineTable[256]{
+      0,   0,   0,   0,   1,   1,   1,   2,   2,   3,   4,   5,
+      5,   6,   7,   9,  10,  11,  12,  14,  15,  17,  18,  20,
+     21,  23,  25,  27,  29,  31,  33,  35,  37,  40,  42,  44,
+     47,  49,  52,  54,  57,  59,  62,  65,  67,  70,  73,  76,
+     79,  82,  85,  88,  90,  93,  97, 100, 103, 106, 109, 112,
+    115, 118, 121, 124, 127, 131, 134, 137, 140, 143, 146, 149,
+    152, 155, 158, 162, 165, 167, 170, 173, 176, 179, 182, 185,
+    188, 190, 193, 196, 198, 201, 203, 206, 208, 211, 213, 215,
+    218, 220, 222, 224, 226, 228, 230, 232, 234, 235, 237, 238,
+    240, 241, 243, 244, 245, 246, 248, 249, 250, 250, 251, 252,
+    253, 253, 254, 254, 254, 255, 255, 255, 255, 255, 255, 255,
+    254, 254, 254, 253, 253, 252, 251, 250, 250, 249, 248, 246,
+    245, 244, 243, 241, 240, 238, 237, 235, 234, 232, 230, 228,
+    226, 224, 222, 220, 218, 215, 213, 211, 208, 206, 203, 201,
+    198, 196, 193, 190, 188, 185, 182, 179, 176, 173, 170, 167,
+    165, 162, 158, 155, 152, 149, 146, 143, 140, 137, 134, 131,
+    128, 124, 121, 118, 115, 112, 109, 106, 103, 100,  97,  93,
+     90,  88,  85,  82,  79,  76,  73,  70,  67,  65,  62,  59,
+     57,  54,  52,  49,  47,  44,  42,  40,  37,  35,  33,  31,
+     29,  27,  25,  23,  21,  20,  18,  17,  15,  14,  12,  11,
+     10,   9,   7,   6,   5,   5,   4,   3,   2,   2,   1,   1,
+      1,   0,   0,   0,
+};
+
+// Returns a*b/255, rounded, for a and b in the range 0-255.
+static inline uint8_t mul8(uint32_t a, uint32_t b) {
+  uint32_t x = a*b + 128;
+  return static_cast<uint8_t>((x + (x >> 8)) >> 8);
+}
+
+// One step of Marsaglia's xorshift32 generator.
+static inline uint32_t xorshift32(uint32_t x) {
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x;
+}
+
+EffectEngine::EffectEngine()
+    : slots_{} {}
+
+bool EffectEngine::isValid(const Effect &e) {
+  if (e.startChannel < 1 || kMaxDMXPacketSize <= e.startChannel) {
+    return false;
+  }
+  if (e.groupCount < 1 || kMaxDMXPacketSize <= e.groupCount ||
+      e.groupSize < 1 || kMaxDMXPacketSize <= e.groupSize) {
+    return false;
+  }
+  if (kMaxDMXPacketSize < e.startChannel + e.groupCount*e.groupSize) {
+    return false;
+  }
+  if (e.periodFrames == 0) {
+    return false;
+  }
+  if (e.waveform == Waveform::kRainbow && e.groupSize < 3) {
+    return false;
+  }
+  return true;
+}
+
+int EffectEngine::add(const Effect &effect) {
+  if (!isValid(effect)) {
+    return -1;
+  }
+
+  int slot = -1;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    for (int i = 0; i < kMaxEffects; i++) {
+      if (!slots_[i].used) {
+        Slot &s = slots_[i];
+        s.effect = effect;
+        s.time = uint64_t{effect.phase} << 16;
+        s.step = (uint64_t{1} << 32) / effect.periodFrames;
+        s.used = true;
+        slot = i;
+        break;
+      }
+    }
+  }
+  return slot;
+}
+
+bool EffectEngine::update(int slot, const Effect &effect) {
+  if (slot < 0 || kMaxEffects <= slot || !isValid(effect)) {
+    return false;
+  }
+
+  bool retval = false;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    Slot &s = slots_[slot];
+    if (s.used) {
+      s.effect = effect;
+      s.step = (uint64_t{1} << 32) / effect.periodFrames;
+      retval = true;
+    }
+  }
+  return retval;
+}
+
+bool EffectEngine::remove(int slot) {
+  if (slot < 0 || kMaxEffects <= slot) {
+    return false;
+  }
+
+  bool retval = false;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    retval = slots_[slot].used;
+    slots_[slot].used = false;
+  }
+  return retval;
+}
+
+void EffectEngine::clear() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    for (Slot &s : slots_) {
+      s.used = false;
+    }
+  }
+}
+
+bool EffectEngine::isUsed(int slot) const {
+  if (slot < 0 || kMaxEffects <= slot) {
+    return false;
+  }
+  return slots_[slot].used;
+}
+
+uint8_t EffectEngine::waveValue(const Effect &effect, uint16_t phase,
+                                uint32_t cycle, int group) {
+  switch (effect.waveform) {
+    case Waveform::kSine: {
+      // Interpolate between table entries
+      int i = phase >> 8;
+      uint32_t f = phase & 0xff;
+      uint32_t a = kSineTable[i];
+      uint32_t b = kSineTable[(i + 1) & 0xff];
+      return static_cast<uint8_t>((a*(256 - f) + b*f + 128) >> 8);
+    }
+
+    case Waveform::kSaw:
+      return static_cast<uint8_t>(phase >> 8);
+
+    case Waveform::kSquare:
+      return (phase < effect.duty) ? 255 : 0;
+
+    case Waveform::kRandom: {
+      uint32_t x = effect.seed ^ (cycle*0x9e3779b9) ^
+                   (static_cast<uint32_t>(group)*0x85ebca6b);
+      if (x == 0) {
+        x = 1;
+      }
+      return static_cast<uint8_t>(xorshift32(xorshift32(x)) >> 24);
+    }
+
+    case Waveform::kRainbow:
+    default:
+      return static_cast<uint8_t>(phase >> 8);
+  }
+}
+
+void EffectEngine::hsvToRGB(uint16_t hue, uint8_t sat, uint8_t val,
+                            uint8_t *rgb) {
+  // Six 256-step sectors around the wheel
+  uint32_t h = (uint32_t{hue}*6) >> 8;
+  uint32_t f = h & 0xff;
+  uint8_t p = mul8(val, 255 - sat);
+  uint8_t q = mul8(val, 255 - mul8(sat, f));
+  uint8_t t = mul8(val, 255 - mul8(sat, 255 - f));
+
+  switch (h >> 8) {
+    case 0:  rgb[0] = val; rgb[1] = t;   rgb[2] = p;   break;
+    case 1:  rgb[0] = q;   rgb[1] = val; rgb[2] = p;   break;
+    case 2:  rgb[0] = p;   rgb[1] = val; rgb[2] = t;   break;
+    case 3:  rgb[0] = p;   rgb[1] = q;   rgb[2] = val; break;
+    case 4:  rgb[0] = t;   rgb[1] = p;   rgb[2] = val; break;
+    default: rgb[0] = val; rgb[1] = p;   rgb[2] = q;   break;
+  }
+}
+
+void EffectEngine::evaluate(const Slot &slot, uint8_t *buf) {
+  const Effect &e = slot.effect;
+  int ch = e.startChannel;
+
+  for (int g = 0; g < e.groupCount; g++, ch += e.groupSize) {
+    uint64_t t = slot.time + (uint64_t{g*uint32_t{e.phaseSpread}} << 16);
+    uint16_t phase = static_cast<uint16_t>(t >> 16);
+
+    if (e.waveform == Waveform::kRainbow) {
+      hsvToRGB(phase, e.saturation, e.high, &buf[ch]);
+      continue;
+    }
+
+    uint8_t w = waveValue(e, phase, static_cast<uint32_t>(t >> 32), g);
+    uint8_t v;
+    if (e.low <= e.high) {
+      v = e.low + mul8(e.high - e.low, w);
+    } else {
+      v = e.low - mul8(e.low - e.high, w);
+    }
+    for (int i = 0; i < e.groupSize; i++) {
+      buf[ch + i] = v;
+    }
+  }
+}
+
+void EffectEngine::processFrame(uint8_t *buf, int size) {
+  for (Slot &s : slots_) {
+    if (!s.used) {
+      continue;
+    }
+    evaluate(s, buf);
+    s.time += s.step;
+  }
+}
+
+}  // namespace teensydmx
+}  // namespace qindesign
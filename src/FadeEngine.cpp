@@ -0,0 +1,343 @@
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#include "FadeEngine.h"
+
+// C++ includes
+#include <atomic>
+
+namespace qindesign {
+namespace teensydmx {
+
+// Returns the bitmap word index for a channel.
+static inline int wordOf(int channel) {
+  return channel >> 5;
+}
+
+// Returns the bitmap bit for a channel.
+static inline uint32_t bitOf(int channel) {
+  return uint32_t{1} << (channel & 31);
+}
+
+FadeEngine::FadeEngine()
+    : value_{0},
+      step_{0},
+      target_{0},
+      remaining_{0},
+      pending_{0},
+      active_{0},
+      wide_{0},
+      stagedTarget_{0},
+      stagedFrames_{0},
+      stagedStarts_{0},
+      stagedStops_{0},
+      stagedWide_{0},
+      staged_(false) {}
+
+uint16_t FadeEngine::framesFor(uint32_t ms, float frameRate) {
+  if (ms == 0 || !(frameRate > 0.0f)) {
+    return 0;
+  }
+  float frames = ms*frameRate/1000.0f + 0.5f;
+  if (!(frames < 65535.0f)) {  // Also catches NaN
+    return 65535;
+  }
+  return static_cast<uint16_t>(frames);
+}
+
+bool FadeEngine::fadeTo(int channel, uint8_t value, uint16_t frames) {
+  if (channel < 1 || kMaxDMXPacketSize <= channel) {
+    return false;
+  }
+
+  beginStaging();
+  stageFade(channel, value, frames, false);
+  endStaging();
+  return true;
+}
+
+bool FadeEngine::fadeTo(int startChannel, const uint8_t *values, int len,
+                        uint16_t frames) {
+  if (len < 0 || startChannel < 1 || kMaxDMXPacketSize <= startChannel) {
+    return false;
+  }
+  if (values == nullptr || kMaxDMXPacketSize < startChannel + len) {
+    return false;
+  }
+
+  beginStaging();
+  for (int i = 0; i < len; i++) {
+    stageFade(startChannel + i, values[i], frames, false);
+  }
+  endStaging();
+  return true;
+}
+
+bool FadeEngine::fadeRangeTo(int startChannel, int len, uint8_t value,
+                             uint16_t frames) {
+  if (len < 0 || startChannel < 1 || kMaxDMXPacketSize <= startChannel) {
+    return false;
+  }
+  if (kMaxDMXPacketSize < startChannel + len) {
+    return false;
+  }
+
+  beginStaging();
+  for (int i = 0; i < len; i++) {
+    stageFade(startChannel + i, value, frames, false);
+  }
+  endStaging();
+  return true;
+}
+
+bool FadeEngine::fade16BitTo(int channel, uint16_t value, uint16_t frames) {
+  if (channel < 1 || kMaxDMXPacketSize - 1 <= channel) {
+    return false;
+  }
+
+  beginStaging();
+  stageFade(channel, value, frames, true);
+  endStaging();
+  return true;
+}
+
+bool FadeEngine::fade16BitTo(int startChannel, const uint16_t *values, int len,
+                             uint16_t frames) {
+  if (len < 0 || startChannel < 1 || kMaxDMXPacketSize <= startChannel) {
+    return false;
+  }
+  if (values == nullptr || kMaxDMXPacketSize < startChannel + len*2) {
+    return false;
+  }
+
+  beginStaging();
+  for (int i = 0; i < len; i++) {
+    stageFade(startChannel + i*2, values[i], frames, true);
+  }
+  endStaging();
+  return true;
+}
+
+bool FadeEngine::stop(int startChannel, int len) {
+  if (len < 0 || startChannel < 1 || kMaxDMXPacketSize <= startChannel) {
+    return false;
+  }
+  if (kMaxDMXPacketSize < startChannel + len) {
+    return false;
+  }
+
+  beginStaging();
+  for (int i = 0; i < len; i++) {
+    stageStop(startChannel + i);
+  }
+  endStaging();
+  return true;
+}
+
+void FadeEngine::stopAll() {
+  beginStaging();
+  for (int w = 0; w < kBitmapSize; w++) {
+    stagedStarts_[w] = 0;
+    stagedStops_[w] = ~uint32_t{0};
+    stagedWide_[w] = 0;
+  }
+  endStaging();
+}
+
+bool FadeEngine::isFading(int channel) const {
+  if (channel < 1 || kMaxDMXPacketSize <= channel) {
+    return false;
+  }
+  int w = wordOf(channel);
+  uint32_t mask = bitOf(channel);
+  if ((stagedStarts_[w] & mask) != 0) {
+    return true;
+  }
+  if ((stagedStops_[w] & mask) != 0) {
+    return false;
+  }
+  return ((pending_[w] | active_[w]) & mask) != 0;
+}
+
+bool FadeEngine::isActive() const {
+  for (int w = 0; w < kBitmapSize; w++) {
+    if ((stagedStarts_[w] |
+         ((pending_[w] | active_[w]) & ~stagedStops_[w])) != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void FadeEngine::beginStaging() {
+  // Take the staged changes back so the ISR won't merge them while they're
+  // being added to
+  staged_ = false;
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+void FadeEngine::endStaging() {
+  std::atomic_signal_fence(std::memory_order_release);
+  staged_ = true;
+}
+
+bool FadeEngine::isWide(int channel) const {
+  int w = wordOf(channel);
+  uint32_t mask = bitOf(channel);
+  if ((stagedStarts_[w] & mask) != 0) {
+    return (stagedWide_[w] & mask) != 0;
+  }
+  if ((stagedStops_[w] & mask) != 0) {
+    return false;
+  }
+  return (wide_[w] & mask) != 0;
+}
+
+void FadeEngine::stageFade(int channel, uint16_t target, uint16_t frames,
+                           bool wide) {
+  int w = wordOf(channel);
+  uint32_t mask = bitOf(channel);
+
+  // A 16-bit pair covers the next channel, so stop any fades that overlap
+  if (isWide(channel - 1)) {
+    stageStop(channel - 1);
+  }
+  if (wide) {
+    stageStop(channel + 1);
+  }
+
+  // Any staged stop stays, so that the merge still stops the channel first
+  stagedTarget_[channel] = target;
+  stagedFrames_[channel] = frames;
+  stagedStarts_[w] |= mask;
+  if (wide) {
+    stagedWide_[w] |= mask;
+  } else {
+    stagedWide_[w] &= ~mask;
+  }
+}
+
+void FadeEngine::stageStop(int channel) {
+  int w = wordOf(channel);
+  uint32_t mask = bitOf(channel);
+  stagedStarts_[w] &= ~mask;
+  stagedWide_[w] &= ~mask;
+  stagedStops_[w] |= mask;
+}
+
+void FadeEngine::mergeStaged() {
+  std::atomic_signal_fence(std::memory_order_acquire);
+  for (int w = 0; w < kBitmapSize; w++) {
+    uint32_t stops = stagedStops_[w];
+    uint32_t starts = stagedStarts_[w];
+    if ((stops | starts) == 0) {
+      continue;
+    }
+    uint32_t stagedWide = stagedWide_[w];
+    uint32_t active = active_[w] & ~stops;
+    uint32_t wide = wide_[w] & ~stops;
+
+    // The current value doesn't apply if the width changes
+    active &= ~(starts & (wide ^ stagedWide));
+    wide = (wide & ~starts) | (stagedWide & starts);
+
+    uint32_t bits = starts;
+    while (bits != 0) {
+      int b = __builtin_ctz(bits);
+      bits &= ~(uint32_t{1} << b);
+      int ch = (w << 5) + b;
+      target_[ch] = stagedTarget_[ch];
+      remaining_[ch] = stagedFrames_[ch];
+    }
+
+    pending_[w] = (pending_[w] & ~stops) | starts;
+    active_[w] = active;
+    wide_[w] = wide;
+    stagedStarts_[w] = 0;
+    stagedStops_[w] = 0;
+    stagedWide_[w] = 0;
+  }
+  staged_ = false;
+}
+
+void FadeEngine::processFrame(uint8_t *buf, int size) {
+  if (staged_) {
+    mergeStaged();
+  }
+
+  // Only walk the channels in the packet
+  if (size > kMaxDMXPacketSize) {
+    size = kMaxDMXPacketSize;
+  }
+  int words = (size + 31)/32;
+  uint32_t lastMask = ((size & 31) == 0) ? ~uint32_t{0}
+                                         : bitOf(size) - 1;
+
+  for (int w = 0; w < words; w++) {
+    uint32_t pending = pending_[w];
+    uint32_t active = active_[w];
+    uint32_t bits = pending | active;
+    uint32_t outside = 0;
+    if (w == words - 1) {
+      outside = bits & ~lastMask;
+      bits &= lastMask;
+    }
+    if (bits == 0) {
+      continue;
+    }
+    uint32_t wide = wide_[w];
+    uint32_t stillActive = bits;
+
+    while (bits != 0) {
+      int b = __builtin_ctz(bits);
+      uint32_t mask = uint32_t{1} << b;
+      bits &= ~mask;
+      int ch = (w << 5) + b;
+
+      // Start a new fade from the current value
+      if ((pending & mask) != 0) {
+        uint32_t start;
+        if ((active & mask) != 0) {
+          start = value_[ch];
+        } else if ((wide & mask) != 0) {
+          start = ((uint32_t{buf[ch]} << 8) | buf[ch + 1]) << 16;
+        } else {
+          start = uint32_t{buf[ch]} << 16;
+        }
+        value_[ch] = start;
+        if (remaining_[ch] > 1) {
+          int64_t delta = int64_t{uint32_t{target_[ch]} << 16} - start;
+          step_[ch] = static_cast<int32_t>(delta / remaining_[ch]);
+        }
+      }
+
+      // Advance, landing exactly on the target at the end
+      uint32_t v;
+      if (remaining_[ch] <= 1) {
+        v = uint32_t{target_[ch]} << 16;
+        remaining_[ch] = 0;
+        stillActive &= ~mask;
+      } else {
+        v = value_[ch] + step_[ch];
+        remaining_[ch]--;
+      }
+      value_[ch] = v;
+
+      // Round to the nearest output value
+      v = (v + 0x8000) >> 16;
+      if ((wide & mask) != 0) {
+        buf[ch] = static_cast<uint8_t>(v >> 8);
+        buf[ch + 1] = static_cast<uint8_t>(v);
+      } else {
+        buf[ch] = static_cast<uint8_t>(v);
+      }
+    }
+
+    // Fades past the end of the packet wait until it grows
+    pending_[w] = pending & outside;
+    active_[w] = stillActive | (active & outside);
+  }
+}
+
+}  // namespace teensydmx
+}  // namespace qindesign
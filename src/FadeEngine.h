@@ -0,0 +1,153 @@
+// FadeEngine.h defines a frame processor that fades channels to target values
+// over a number of frames. The fades are computed by the sender's ISR, so
+// they're locked to the transmitted frames and the main loop doesn't need to do
+// anything while they run.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_FADEENGINE_H_
+#define TEENSYDMX_FADEENGINE_H_
+
+// C++ includes
+#include <cstdint>
+
+#include "FrameProcessor.h"
+#include "TeensyDMX.h"
+
+namespace qindesign {
+namespace teensydmx {
+
+// Fades channels linearly from their current values to target values. Each
+// channel, or 16-bit coarse/fine channel pair, has its own 16.16 fixed-point
+// interpolator that advances by one step per transmitted frame and lands
+// exactly on the target at the last frame.
+//
+// To use it, add it to a sender with `Sender::addFrameProcessor` and then start
+// fades with the `fadeTo` functions. A fade starts from whatever value the
+// channel holds at the next frame boundary, so it continues smoothly from any
+// fade already in progress. While a channel is fading, its value is rewritten
+// every frame, so values set directly on the sender only stick once the fade is
+// done or stopped.
+//
+// Channels are 1-512; the start code can't be faded. This uses about 8kB of
+// memory, so it may not fit on smaller systems such as the Teensy LC.
+//
+// The functions here don't disable interrupts. Changes are staged and then
+// picked up by the sender's ISR at the next frame boundary, so they should all
+// be called from the same context, for example the main loop, and not from an
+// ISR.
+class FadeEngine final : public FrameProcessor {
+ public:
+  FadeEngine();
+
+  ~FadeEngine() = default;
+
+  // Converts a time, in milliseconds, to the nearest number of frames at the
+  // given frame rate, for example from `Sender::timing().frameRate()`. This
+  // saturates at 65535.
+  static uint16_t framesFor(uint32_t ms, float frameRate);
+
+  // Fades a channel to the given value over `frames` frames. Zero frames sets
+  // the value at the next frame. This returns `false` if the channel isn't in
+  // the range 1-512, and `true` otherwise.
+  bool fadeTo(int channel, uint8_t value, uint16_t frames);
+
+  // Fades a range of channels to the given values over `frames` frames. This
+  // returns `false` if any part of the range isn't in the range 1-512, if the
+  // length is negative, or if `values` is NULL, and `true` otherwise.
+  bool fadeTo(int startChannel, const uint8_t *values, int len,
+              uint16_t frames);
+
+  // Fades a range of channels to the same value over `frames` frames. This
+  // returns `false` if any part of the range isn't in the range 1-512 or if the
+  // length is negative, and `true` otherwise.
+  bool fadeRangeTo(int startChannel, int len, uint8_t value, uint16_t frames);
+
+  // Fades a 16-bit value, stored in big-endian order in a coarse/fine channel
+  // pair starting at `channel`, over `frames` frames. Both channels are
+  // interpolated together, so the fine channel wraps correctly. This returns
+  // `false` if the channel isn't in the range 1-511, and `true` otherwise.
+  bool fade16BitTo(int channel, uint16_t value, uint16_t frames);
+
+  // Fades a range of 16-bit values. `len` is the number of values, each taking
+  // two channels. This returns `false` if any part of the range isn't in the
+  // range 1-512, if the length is negative, or if `values` is NULL, and `true`
+  // otherwise.
+  bool fade16BitTo(int startChannel, const uint16_t *values, int len,
+                   uint16_t frames);
+
+  // Stops any fades in the given range of channels, leaving them at their
+  // current values. This returns `false` if any part of the range isn't in the
+  // range 1-512 or if the length is negative, and `true` otherwise.
+  bool stop(int startChannel, int len);
+
+  // Stops all fades, leaving the channels at their current values.
+  void stopAll();
+
+  // Returns whether the channel is fading or about to start fading. For
+  // a 16-bit pair, this is only true for the coarse channel.
+  bool isFading(int channel) const;
+
+  // Returns whether any channel is fading or about to start fading.
+  bool isActive() const;
+
+  // Advances all the fades by one frame. This is called by the sender. Only
+  // channels inside the packet, ones less than `size`, are advanced; fades
+  // past the end wait until the packet grows. A 16-bit pair is advanced if its
+  // coarse channel is inside.
+  void processFrame(uint8_t *buf, int size) override;
+
+ private:
+  // The number of 32-bit words in each channel bitmap.
+  static constexpr int kBitmapSize = (kMaxDMXPacketSize + 31)/32;
+
+  // Takes back any staged changes so that the ISR won't use them while more
+  // are being staged.
+  void beginStaging();
+
+  // Hands the staged changes to the ISR.
+  void endStaging();
+
+  // Returns whether the channel is the coarse channel of a 16-bit pair,
+  // including staged changes.
+  bool isWide(int channel) const;
+
+  // Stages a fade. The channel must be valid. This applies the 16-bit pair
+  // rules so that the ISR only has to copy the changes in.
+  void stageFade(int channel, uint16_t target, uint16_t frames, bool wide);
+
+  // Stages stopping a fade.
+  void stageStop(int channel);
+
+  // Merges the staged changes into the channel state. This is called from the
+  // ISR.
+  void mergeStaged();
+
+  // Channel state, indexed by channel. For a pending fade, the target and
+  // remaining frames hold the new fade's parameters, and the step is computed
+  // when it starts.
+  uint32_t value_[kMaxDMXPacketSize];      // 16.16 fixed-point
+  int32_t step_[kMaxDMXPacketSize];        // 16.16 fixed-point
+  uint16_t target_[kMaxDMXPacketSize];
+  uint16_t remaining_[kMaxDMXPacketSize];  // Frames remaining
+
+  // Channel bitmaps
+  volatile uint32_t pending_[kBitmapSize];  // Starting at the next frame
+  volatile uint32_t active_[kBitmapSize];   // Currently fading
+  volatile uint32_t wide_[kBitmapSize];     // 16-bit pairs
+
+  // Staged changes, merged by the ISR at the start of the next frame. The ISR
+  // only touches these while `staged_` is set. For each channel, a stop is
+  // applied before a start.
+  uint16_t stagedTarget_[kMaxDMXPacketSize];
+  uint16_t stagedFrames_[kMaxDMXPacketSize];
+  volatile uint32_t stagedStarts_[kBitmapSize];
+  volatile uint32_t stagedStops_[kBitmapSize];
+  volatile uint32_t stagedWide_[kBitmapSize];
+  volatile bool staged_;
+};
+
+}  // namespace teensydmx
+}  // namespace qindesign
+
+#endif  // TEENSYDMX_FADEENGINE_H_
@@ -0,0 +1,36 @@
+// FrameProcessor.h defines a generic interface for changing a Sender's channel
+// values at each frame boundary.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_FRAMEPROCESSOR_H_
+#define TEENSYDMX_FRAMEPROCESSOR_H_
+
+// C++ includes
+#include <cstdint>
+
+namespace qindesign {
+namespace teensydmx {
+
+// FrameProcessor defines an interface to something that computes channel
+// values once per transmitted frame, for example fades or effects. Processors
+// are added to a sender with `Sender::addFrameProcessor`.
+class FrameProcessor {
+ public:
+  virtual ~FrameProcessor() = default;
+
+  // Updates the channel values for the next frame. This is called after each
+  // packet is sent and before the values for the next packet are captured.
+  // `buf` holds all the sender's channel values, including the start code at
+  // index zero, and `size` is the current packet size. Any changes stick, as if
+  // they were made with `Sender::set`.
+  //
+  // This is called from an ISR, so it should be fast. The sender's UART
+  // interrupts are blocked for the duration of the call.
+  virtual void processFrame(uint8_t *buf, int size) = 0;
+};
+
+}  // namespace teensydmx
+}  // namespace qindesign
+
+#endif  // TEENSYDMX_FRAMEPROCESSOR_H_
@@ -7,6 +7,8 @@
 
 #include <core_pins.h>
 
+#include "util/CycleCounter.h"
+
 namespace qindesign {
 namespace teensydmx {
 
@@ -85,8 +87,11 @@ int LPUARTReceiveHandler::priority() const {
 }
 
 void LPUARTReceiveHandler::irqHandler() const {
+  util::ISRProfiler::Scope profile{receiver_->isrProfiler_};
+
   uint32_t status = port_->STAT;
 
+  uint32_t eventCycles = util::cycleCount();
   uint32_t eventTime = micros();
 
   // A framing error likely indicates a BREAK, but it could also mean that there
@@ -113,7 +118,7 @@ void LPUARTReceiveHandler::irqHandler() const {
 
     // 32-bit data, so only look at the bottom 8 bits
     if ((port_->DATA & 0xff) == 0) {
-      receiver_->receivePotentialBreak(eventTime);
+      receiver_->receivePotentialBreak(eventTime, eventCycles);
     } else {
       receiver_->receiveBadBreak();
     }
@@ -125,21 +130,23 @@ void LPUARTReceiveHandler::irqHandler() const {
   if ((status & (LPUART_STAT_RDRF | LPUART_STAT_IDLE)) != 0) {
     uint8_t avail = (port_->WATER >> 24) & 0x07;  // RXCOUNT
     if (avail == 0) {
-      receiver_->receiveIdle(eventTime);
+      receiver_->receiveIdle(eventTime, eventCycles);
       if ((status & LPUART_STAT_IDLE) != 0) {
         port_->STAT |= LPUART_STAT_IDLE;  // Clear the flag
       }
     } else {
       bool idle = ((status & LPUART_STAT_IDLE) != 0);
       uint32_t timestamp = eventTime - kCharTime*avail;
-      if (avail < ((port_->WATER >> 16) & 0x03)) {  // RXWATER
+      // RDRF only means "more than RXWATER", so anything else was found by
+      // IDLE, a character after the last one ended
+      if (avail <= ((port_->WATER >> 16) & 0x03)) {  // RXWATER
         timestamp -= kCharTime;
       }
       while (avail-- > 0) {
         receiver_->receiveByte(port_->DATA, timestamp += kCharTime);
       }
       if (idle) {  // Also capture any IDLE event
-        receiver_->receiveIdle(eventTime);
+        receiver_->receiveIdle(eventTime, eventCycles);
         port_->STAT |= LPUART_STAT_IDLE;  // Clear the flag
       }
     }
@@ -149,7 +156,7 @@ void LPUARTReceiveHandler::irqHandler() const {
   if ((status & LPUART_STAT_RDRF) != 0) {
     receiver_->receiveByte(port_->DATA, eventTime);
   } else if ((status & LPUART_STAT_IDLE) != 0) {
-    receiver_->receiveIdle(eventTime);
+    receiver_->receiveIdle(eventTime, eventCycles);
     port_->STAT |= LPUART_STAT_IDLE;  // Clear the flag
   }
 #endif  // __IMXRT1062__ || __IMXRT1052__
@@ -85,6 +85,26 @@ void LPUARTSendHandler::setCompleting() const {
       (port_->CTRL | (LPUART_CTRL_TE | LPUART_CTRL_TCIE)) & ~LPUART_CTRL_TIE;
 }
 
+void LPUARTSendHandler::applyInterSlotPadding() const {
+#if defined(__IMXRT1062__) || defined(__IMXRT1052__)
+  // 9-bit data adds one MARK bit and 10-bit data adds two
+  uint32_t baud = port_->BAUD & ~LPUART_BAUD_M10;
+  uint32_t ctrl = port_->CTRL & ~LPUART_CTRL_M;
+  switch (sender_->packetInterSlotPadBits_) {
+    case 1:
+      ctrl |= LPUART_CTRL_M;
+      break;
+    case 2:
+      baud |= LPUART_BAUD_M10;
+      break;
+    default:
+      break;
+  }
+  port_->BAUD = baud;
+  port_->CTRL = ctrl;
+#endif  // __IMXRT1062__ || __IMXRT1052__
+}
+
 void LPUARTSendHandler::setIRQState(bool flag) const {
   if (flag) {
     NVIC_ENABLE_IRQ(irq_);
@@ -98,8 +118,11 @@ int LPUARTSendHandler::priority() const {
 }
 
 void LPUARTSendHandler::breakTimerCallback() const {
+  util::ISRProfiler::Scope profile{sender_->isrProfiler_};
+
   if (sender_->state_ == Sender::XmitStates::kBreak) {
     port_->CTRL &= ~LPUART_CTRL_TXINV;
+    sender_->breakEnded();
     sender_->state_ = Sender::XmitStates::kMAB;
     if (sender_->intervalTimer_.restart(sender_->adjustedMABTime_)) {
       return;
@@ -111,8 +134,10 @@ void LPUARTSendHandler::breakTimerCallback() const {
     // We shouldn't delay as an alternative because that might
     // mean we delay too long, however the MAB is most likely to
     // be too short in this case
+    sender_->timerFailed();
   }
   sender_->intervalTimer_.end();
+  sender_->mabEnded();
   sender_->state_ = Sender::XmitStates::kData;
   setActive();
 }
@@ -121,21 +146,31 @@ void LPUARTSendHandler::breakTimerPreCallback() const {
   // Invert the line as close as possible to the timer start
   port_->CTRL |= LPUART_CTRL_TXINV;
   setInactive();
-  sender_->breakStartTime_ = micros();
+  sender_->breakStarted();
 }
 
 void LPUARTSendHandler::interSlotTimerCallback() const {
+  util::ISRProfiler::Scope profile{sender_->isrProfiler_};
+
   sender_->intervalTimer_.end();
   sender_->state_ = Sender::XmitStates::kData;
   setActive();
 }
 
 void LPUARTSendHandler::rateTimerCallback() const {
+  util::ISRProfiler::Scope profile{sender_->isrProfiler_};
+
   sender_->intervalTimer_.end();
   setActive();
 }
 
 void LPUARTSendHandler::irqHandler() const {
+  util::ISRProfiler::Scope profile{sender_->isrProfiler_};
+
+  sender_->trace(util::TraceEventType::kSendIRQ,
+                 static_cast<int>(sender_->state_),
+                 sender_->inactiveBufIndex_);
+
   uint32_t status = port_->STAT;
   uint32_t control = port_->CTRL;
 
@@ -159,10 +194,13 @@ void LPUARTSendHandler::irqHandler() const {
         } else {
           // Not using a timer or starting it failed;
           // revert to the original way
+          if (sender_->breakUseTimer_) {
+            sender_->timerFailed();
+          }
           breakSerialParams_.apply(port_);
           port_->DATA = 0;
           setCompleting();
-          sender_->breakStartTime_ = micros();
+          sender_->breakStarted();
         }
         break;
 
@@ -173,18 +211,43 @@ void LPUARTSendHandler::irqHandler() const {
 
       case Sender::XmitStates::kData:
 #if defined(__IMXRT1062__) || defined(__IMXRT1052__)
-        if (sender_->interSlotTime_ == 0) {
+        if (sender_->packetInterSlotSerial_) {
+          // Pad each slot with MARK bits and follow it with idle characters
+          // so that the FIFO can still be used
+          uint32_t padding = 0;
+          if (sender_->packetInterSlotPadBits_ > 0) {
+            padding = (sender_->packetInterSlotPadBits_ > 1)
+                          ? (LPUART_DATA_R8T8 | LPUART_DATA_R9T9)
+                          : LPUART_DATA_R8T8;
+          }
           do {
+            if (sender_->interSlotIdleRemaining_ > 0) {
+              sender_->interSlotIdleRemaining_--;
+              port_->DATA = LPUART_DATA_FRETSC | LPUART_DATA_R9T9;  // Idle
+              continue;
+            }
             if (sender_->inactiveBufIndex_ >= sender_->inactivePacketSize_) {
               setCompleting();
               break;
             }
-            port_->DATA = sender_->inactiveBuf_[sender_->inactiveBufIndex_++];
+            port_->DATA = sender_->nextSlot() | padding;
+            if (sender_->inactiveBufIndex_ < sender_->inactivePacketSize_) {
+              sender_->interSlotIdleRemaining_ =
+                  sender_->packetInterSlotIdleChars_;
+            }
+          } while (((port_->WATER >> 8) & 0x07) < fifoSize_);  // TXCOUNT
+        } else if (sender_->packetInterSlotTime_ == 0) {
+          do {
+            if (sender_->inactiveBufIndex_ >= sender_->inactivePacketSize_) {
+              setCompleting();
+              break;
+            }
+            port_->DATA = sender_->nextSlot();
           } while (((port_->WATER >> 8) & 0x07) < fifoSize_);  // TXCOUNT
         } else {
           // Don't use the FIFO
           if (sender_->inactiveBufIndex_ < sender_->inactivePacketSize_) {
-            port_->DATA = sender_->inactiveBuf_[sender_->inactiveBufIndex_++];
+            port_->DATA = sender_->nextSlot();
             if (sender_->inactiveBufIndex_ < sender_->inactivePacketSize_) {
               sender_->state_ = Sender::XmitStates::kInterSlot;
             }
@@ -193,10 +256,10 @@ void LPUARTSendHandler::irqHandler() const {
         }
 #else  // No FIFO
         if (sender_->inactiveBufIndex_ < sender_->inactivePacketSize_) {
-          port_->DATA = sender_->inactiveBuf_[sender_->inactiveBufIndex_++];
+          port_->DATA = sender_->nextSlot();
           if (sender_->inactiveBufIndex_ >= sender_->inactivePacketSize_) {
             setCompleting();
-          } else if (sender_->interSlotTime_ != 0) {
+          } else if (sender_->packetInterSlotTime_ != 0) {
             sender_->state_ = Sender::XmitStates::kInterSlot;
             setCompleting();
           }
@@ -212,6 +275,13 @@ void LPUARTSendHandler::irqHandler() const {
           setInactive();
           return;
         }
+
+        // Wait for an external trigger, if enabled
+        if (sender_->waitForTrigger()) {
+          setInactive();
+          return;
+        }
+
         if (sender_->resumeCounter_ > 0) {
           if (--sender_->resumeCounter_ == 0) {
             sender_->paused_ = true;
@@ -220,19 +290,16 @@ void LPUARTSendHandler::irqHandler() const {
 
         sender_->transmitting_ = true;
         sender_->state_ = Sender::XmitStates::kBreak;
+        applyInterSlotPadding();
 
-        // Delay so that we can achieve the specified refresh rate
-        // including the MBB
-        uint32_t timeSinceBreak = micros() - sender_->breakStartTime_;
+        // Delay so that we can achieve the specified refresh rate or
+        // trigger phase, including the MBB
         if (sender_->breakToBreakTime_ == UINT32_MAX) {
           // Infinite BREAK to BREAK time
           setInactive();
           return;
         }
-        uint32_t delay = sender_->adjustedMBBTime_;
-        if (timeSinceBreak + delay < sender_->breakToBreakTime_) {
-          delay = sender_->breakToBreakTime_ - timeSinceBreak;
-        }
+        uint32_t delay = sender_->nextBreakDelay();
         if (delay > 0) {
           setInactive();
           if (sender_->intervalTimer_.begin(
@@ -240,6 +307,7 @@ void LPUARTSendHandler::irqHandler() const {
                   delay)) {
             return;
           }
+          sender_->timerFailed();
         }
         // Starting the timer failed or no delay is necessary
         setActive();
@@ -257,11 +325,13 @@ void LPUARTSendHandler::irqHandler() const {
       case Sender::XmitStates::kBreak:
         sender_->state_ = Sender::XmitStates::kData;
         slotsSerialParams_.apply(port_);
+        applyInterSlotPadding();
         break;
 
       case Sender::XmitStates::kMAB:  // Shouldn't be needed
         sender_->state_ = Sender::XmitStates::kData;
         slotsSerialParams_.apply(port_);
+        applyInterSlotPadding();
         break;
 
       case Sender::XmitStates::kData:
@@ -272,9 +342,10 @@ void LPUARTSendHandler::irqHandler() const {
         setInactive();
         if (sender_->intervalTimer_.begin(
                 [this]() { interSlotTimerCallback(); },
-                sender_->adjustedInterSlotTime_)) {
+                sender_->packetAdjustedInterSlotTime_)) {
           return;
         }
+        sender_->timerFailed();
         sender_->state_ = Sender::XmitStates::kData;
         break;
 
@@ -74,6 +74,10 @@ class LPUARTSendHandler final : public SendHandler {
   void setInactive() const;
   void setCompleting() const;
 
+  // Sets the data size for the slots so that each slot carries the packet's
+  // inter-slot padding bits. This is only needed for the Teensy 4.
+  void applyInterSlotPadding() const;
+
   // Timer handling
   void breakTimerCallback() const;      // When the timer triggers
   void breakTimerPreCallback() const;   // Just before the timer starts
@@ -49,6 +49,12 @@ class ReceiveHandler {
   // Sends a synchronous BREAK and MAB.
   virtual void txBreak(uint32_t breakTime, uint32_t mabTime) const = 0;
 
+  // Sets the receiver that owns this handler. This is used when the receiver
+  // is moved.
+  void setReceiver(Receiver *receiver) {
+    receiver_ = receiver;
+  }
+
  protected:
   ReceiveHandler(int serialIndex, Receiver *receiver)
       : serialIndex_(serialIndex),
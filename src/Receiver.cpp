@@ -12,6 +12,7 @@
 #include <util/atomic.h>
 
 #include "Responder.h"
+#include "util/CycleCounter.h"
 
 namespace qindesign {
 namespace teensydmx {
@@ -171,20 +172,43 @@ Receiver::Receiver(HardwareSerial &uart)
       activeBuf_(buf1_),
       inactiveBuf_(buf2_),
       activeBufIndex_(0),
+      rxChecksum_(0),
       packetSize_(0),
       lastBreakStartTime_(0),
       breakStartTime_(0),
+      lastBreakStartCycles_(0),
+      breakStartCycles_(0),
+      charTimeCycles_(0),
+      nsPerCycleQ16_(0),
       lastSlotEndTime_(0),
       connected_(false),
       connectChangeFunc_{nullptr},
+      packetReadyEvent_{},
+      packetReadyFunc_{nullptr},
+      packetReadyPending_(false),
+      packetReadyMissedCount_(0),
+      sipVerify_(false),
+      sipBuf_{},
+      verifiedBuf_(nullptr),
+      verifiedPacketSize_(0),
+      sipCandidateSize_(0),
+      sipCandidateChecksum_(0),
+      sipStats_{},
       responderCount_(0),
+      responderCapacity_(0),
       responderOutBufLen_(0),
       setTXNotRXFunc_(nullptr),
       rxWatchPin_(-1),
       seenMABStart_(false),
       seenMABEnd_(false),
       mabStartTime_(0),
-      mabEndTime_(0) {
+      mabEndTime_(0),
+      mabStartCycles_(0),
+      mabEndCycles_(0),
+      rxCapture_{},
+      rxCaptureArmCycles_(0),
+      cyclesPerTickQ16_(0),
+      capturePeriodCycles_(0) {
   switch(serialIndex_) {
 #if defined(HAS_KINETISK_UART0)
     case 0:
@@ -304,6 +328,105 @@ Receiver::Receiver(HardwareSerial &uart)
   }
 }
 
+// Stops a receiver so that its ISRs, timer, and packet-ready event no longer
+// run for it, and returns it as an rvalue. This is used by the move
+// constructor.
+static Receiver &&stopForMove(Receiver &r) {
+  r.end();
+  return std::move(r);
+}
+
+Receiver::Receiver(Receiver &&other)
+    : TeensyDMX(stopForMove(other)),
+      receiveHandler_(std::move(other.receiveHandler_)),
+      txEnabled_(other.txEnabled_),
+      began_(false),
+      state_{RecvStates::kIdle},
+      keepShortPackets_(other.keepShortPackets_),
+      buf1_{0},
+      buf2_{0},
+      activeBuf_(other.activeBuf_),
+      inactiveBuf_(other.inactiveBuf_),
+      activeBufIndex_(0),
+      rxChecksum_(0),
+      packetSize_(other.packetSize_),
+      packetStats_(other.packetStats_),
+      lastBreakStartTime_(0),
+      breakStartTime_(0),
+      lastBreakStartCycles_(0),
+      breakStartCycles_(0),
+      charTimeCycles_(other.charTimeCycles_),
+      nsPerCycleQ16_(other.nsPerCycleQ16_),
+      lastSlotEndTime_(0),
+      connected_(false),
+      connectChangeFunc_{other.connectChangeFunc_},
+      packetReadyEvent_{},
+      packetReadyFunc_{nullptr},
+      packetReadyPending_(false),
+      packetReadyMissedCount_(other.packetReadyMissedCount_),
+      errorStats_(other.errorStats_),
+      sipVerify_(other.sipVerify_),
+      sipBuf_(std::move(other.sipBuf_)),
+      verifiedBuf_(other.verifiedBuf_),
+      verifiedPacketSize_(other.verifiedPacketSize_),
+      sipCandidateSize_(0),
+      sipCandidateChecksum_(0),
+      sipStats_(other.sipStats_),
+#ifdef TEENSYDMX_CHECK_INVARIANTS
+      invariantViolationCount_(other.invariantViolationCount_),
+      lastInvariantViolation_(other.lastInvariantViolation_),
+#endif  // TEENSYDMX_CHECK_INVARIANTS
+      timingStats_(other.timingStats_),
+      breakToBreakHistogram_(std::move(other.breakToBreakHistogram_)),
+      responders_(std::move(other.responders_)),
+      responderStarts_(std::move(other.responderStarts_)),
+      responderCount_(other.responderCount_),
+      responderCapacity_(other.responderCapacity_),
+      responderOutBuf_(std::move(other.responderOutBuf_)),
+      responderOutBufLen_(other.responderOutBufLen_),
+      setTXNotRXFunc_(other.setTXNotRXFunc_),
+      rxWatchPin_(other.rxWatchPin_),
+      seenMABStart_(false),
+      seenMABEnd_(false),
+      mabStartTime_(0),
+      mabEndTime_(0),
+      mabStartCycles_(0),
+      mabEndCycles_(0),
+      rxCapture_(std::move(other.rxCapture_)),
+      rxCaptureArmCycles_(0),
+      cyclesPerTickQ16_(other.cyclesPerTickQ16_),
+      capturePeriodCycles_(other.capturePeriodCycles_),
+      intervalTimer_(std::move(other.intervalTimer_)) {
+  std::copy_n(other.buf1_, kMaxDMXPacketSize, buf1_);
+  std::copy_n(other.buf2_, kMaxDMXPacketSize, buf2_);
+
+  // The receive buffers are part of the object, but the SIP buffer isn't
+  auto moveBuf = [this, &other](auto *buf) -> decltype(buf) {
+    if (buf == other.buf1_) {
+      return buf1_;
+    }
+    if (buf == other.buf2_) {
+      return buf2_;
+    }
+    return buf;
+  };
+  activeBuf_ = moveBuf(activeBuf_);
+  inactiveBuf_ = moveBuf(inactiveBuf_);
+  verifiedBuf_ = moveBuf(verifiedBuf_);
+
+  if (receiveHandler_ != nullptr) {
+    receiveHandler_->setReceiver(this);
+  }
+
+  // The other's event may still be linked into the event list and its context
+  // is the other receiver, so detach it there and attach this one here
+  void (*f)(Receiver *r) = other.packetReadyFunc_;
+  other.packetReadyFunc_ = nullptr;
+  other.packetReadyEvent_.detach();
+  other.packetReadyPending_ = false;
+  onPacketReady(f);
+}
+
 Receiver::~Receiver() {
   end();
 }
@@ -335,8 +458,24 @@ void Receiver::begin() {
   resetPacketCount();
   packetSize_ = 0;
   lastBreakStartTime_ = 0;
+  lastBreakStartCycles_ = 0;
   packetStats_ = PacketStats{};
+
+  // High-resolution timing
+  util::enableCycleCounter();
+  charTimeCycles_ = util::usToCycles(kCharTime);
+  nsPerCycleQ16_ = util::nsPerCycleQ16();
   errorStats_ = ErrorStats{};
+  timingStats_ = TimingStats{};
+  sipStats_ = SIPStats{};
+  sipCandidateSize_ = 0;
+  isrProfiler_.reset();
+  breakToBreakHistogram_.reset();
+  packetReadyMissedCount_ = 0;
+#ifdef TEENSYDMX_CHECK_INVARIANTS
+  invariantViolationCount_ = 0;
+  lastInvariantViolation_ = Invariant::kNone;
+#endif  // TEENSYDMX_CHECK_INVARIANTS
 
   // Set up the instance for the ISRs
   Receiver *r = rxInstances[serialIndex_];
@@ -378,6 +517,10 @@ void Receiver::end() {
     rxInstances[serialIndex_] = nullptr;
   }
 
+  // Drop any packet-ready event that hasn't run yet
+  packetReadyEvent_.clearEvent();
+  packetReadyPending_ = false;
+
   setConnected(false);
 }
 
@@ -473,47 +616,246 @@ uint32_t Receiver::lastPacketTimestamp() const {
   return packetStats_.timestamp;
 }
 
+// Checks a SIP's size and its own checksum. The byte count in slot 1 doesn't
+// include the start code and is also the index of the SIP checksum, which is
+// the complement of the 8-bit sum of the slots before it.
+static bool checkSIP(const uint8_t *buf, int size) {
+  int count = buf[1];
+  if (count < 5 || size <= count) {
+    return false;
+  }
+  uint8_t sum = 0;
+  for (int i = 0; i < count; i++) {
+    sum += buf[i];
+  }
+  return static_cast<uint8_t>(~sum) == buf[count];
+}
+
+int Receiver::verifySIP() {
+  int candidateSize = sipCandidateSize_;
+  sipCandidateSize_ = 0;
+
+  int size = activeBufIndex_;
+  if (size <= 0 || activeBuf_[0] != Sender::kSIPStartCode) {
+    if (candidateSize > 0) {
+      sipStats_.unverifiedCount++;
+    }
+
+    // This packet may be checked by the next SIP
+    if (size > 0 && activeBuf_[0] == 0) {
+      sipCandidateSize_ = size;
+      sipCandidateChecksum_ = rxChecksum_;
+    }
+    return 0;
+  }
+
+  sipStats_.sipCount++;
+  if (size < Sender::kSIPSize || !checkSIP(activeBuf_, size)) {
+    sipStats_.badSIPCount++;
+    if (candidateSize > 0) {
+      sipStats_.unverifiedCount++;
+    }
+    return 0;
+  }
+  if (candidateSize <= 0) {
+    return 0;
+  }
+
+  uint16_t checksum = (uint16_t{activeBuf_[3]} << 8) | activeBuf_[4];
+  if (checksum != static_cast<uint16_t>(~sipCandidateChecksum_)) {
+    sipStats_.mismatchCount++;
+    return 0;
+  }
+  sipStats_.verifiedCount++;
+  return candidateSize;
+}
+
+bool Receiver::setSIPVerify(bool flag) {
+  uint8_t *buf = nullptr;
+  if (flag && sipBuf_ == nullptr) {
+    buf = new uint8_t[kMaxDMXPacketSize]{0};
+    // Allocation may have failed on small systems
+    if (buf == nullptr) {
+      return false;
+    }
+  }
+
+  Lock lock{*this};
+  //{
+    if (buf != nullptr) {
+      sipBuf_.reset(buf);
+      verifiedBuf_ = buf;
+    }
+    if (flag && !sipVerify_) {
+      sipCandidateSize_ = 0;
+    }
+    sipVerify_ = flag;
+  //}
+  return true;
+}
+
+int Receiver::readVerifiedPacket(uint8_t *buf, int startChannel, int len) {
+  if (len <= 0 || startChannel < 0 || kMaxDMXPacketSize <= startChannel) {
+    return 0;
+  }
+
+  int retval = -1;
+  Lock lock{*this};
+  //{
+    int size = verifiedPacketSize_;
+    if (size > 0) {
+      if (startChannel >= size) {
+        retval = 0;
+      } else {
+        if (startChannel + len > size) {
+          len = size - startChannel;
+        }
+        std::copy_n(&verifiedBuf_[startChannel], len, &buf[0]);
+        retval = len;
+      }
+      verifiedPacketSize_ = 0;
+    }
+  //}
+  return retval;
+}
+
+Receiver::SIPStats Receiver::sipStats() const {
+  Lock lock{*this};
+  std::atomic_signal_fence(std::memory_order_acquire);
+  return sipStats_;
+}
+
+void Receiver::resetSIPStats() {
+  Lock lock{*this};
+  sipStats_ = SIPStats{};
+  std::atomic_signal_fence(std::memory_order_release);
+}
+
 Receiver::ErrorStats Receiver::errorStats() const {
   Lock lock{*this};
   std::atomic_signal_fence(std::memory_order_acquire);
   return errorStats_;
 }
 
+Receiver::TimingStats Receiver::timingStats() const {
+  Lock lock{*this};
+  std::atomic_signal_fence(std::memory_order_acquire);
+  return timingStats_;
+}
+
+void Receiver::resetTimingStats() {
+  Lock lock{*this};
+  timingStats_ = TimingStats{};
+  std::atomic_signal_fence(std::memory_order_release);
+}
+
+void Receiver::setBreakToBreakHistogram(uint32_t minTime, uint32_t bucketWidth,
+                                        int bucketCount) {
+  Lock lock{*this};
+  breakToBreakHistogram_.configure(minTime, bucketWidth, bucketCount);
+  std::atomic_signal_fence(std::memory_order_release);
+}
+
+util::Histogram Receiver::breakToBreakHistogram() const {
+  Lock lock{*this};
+  std::atomic_signal_fence(std::memory_order_acquire);
+  return breakToBreakHistogram_;
+}
+
+void Receiver::resetBreakToBreakHistogram() {
+  Lock lock{*this};
+  breakToBreakHistogram_.reset();
+  std::atomic_signal_fence(std::memory_order_release);
+}
+
+float Receiver::refreshRateEstimate() const {
+  float median = breakToBreakHistogram().percentile(50.0f);
+  if (median <= 0.0f) {
+    return 0.0f;
+  }
+  return 1000000.0f / median;
+}
+
 Responder *Receiver::setResponder(uint8_t startCode, Responder *r) {
-  // For a null responder, delete any current one for this start code
-  if (r == nullptr) {
-    Lock lock{*this};
+  Lock lock{*this};
 
-    if (responders_ == nullptr) {
-      return nullptr;
+  // Remove the whole chain for this start code, remembering its head
+  Responder *old = nullptr;
+  if (responders_ != nullptr) {
+    int first = responderStarts_[startCode];
+    int last = responderStarts_[startCode + 1];
+    if (first < last) {
+      old = responders_[first];
     }
+    eraseResponders(startCode, first, last);
+  }
 
-    // Replace any previous responder
-    Responder *old = responders_[startCode];
-    if (old != nullptr) {
-      responderCount_--;
-    }
+  // For a null responder, there's nothing more to do
+  if (r == nullptr) {
+    releaseRespondersIfEmpty();
+    return old;
+  }
+
+  if (!insertResponder(startCode, r)) {
+    return nullptr;
+  }
+  return old;
+}
+
+bool Receiver::addResponder(uint8_t startCode, Responder *r) {
+  if (r == nullptr) {
+    return false;
+  }
+
+  Lock lock{*this};
 
-    // When no more responders, delete all the buffers
-    if (responderCount_ == 0) {
-      responderOutBuf_ = nullptr;
-      responders_ = nullptr;
+  // Don't add the same responder twice
+  if (responders_ != nullptr) {
+    for (int i = responderStarts_[startCode];
+         i < responderStarts_[startCode + 1]; i++) {
+      if (responders_[i] == r) {
+        return true;
+      }
     }
+  }
 
-    return old;
+  return insertResponder(startCode, r);
+}
+
+bool Receiver::removeResponder(uint8_t startCode, Responder *r) {
+  if (r == nullptr) {
+    return false;
   }
 
   Lock lock{*this};
 
-  // Allocate this first because it's done once. The output buffer may get
-  // reallocated, and so letting that be the last thing deleted avoids
-  // potential fragmentation.
   if (responders_ == nullptr) {
-    responders_.reset(new Responder *[256]);
+    return false;
+  }
+
+  for (int i = responderStarts_[startCode];
+       i < responderStarts_[startCode + 1]; i++) {
+    if (responders_[i] == r) {
+      eraseResponders(startCode, i, i + 1);
+      releaseRespondersIfEmpty();
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Receiver::insertResponder(uint8_t startCode, Responder *r) {
+  // Allocate this first because it's done once. The output buffer and chain
+  // array may get reallocated, and so letting those be the last things deleted
+  // avoids potential fragmentation.
+  if (responderStarts_ == nullptr) {
+    responderStarts_.reset(new uint16_t[257]);
     // Allocation may have failed on small systems
-    if (responders_ == nullptr) {
-      return nullptr;
+    if (responderStarts_ == nullptr) {
+      clearResponders();
+      return false;
     }
+    std::fill_n(&responderStarts_[0], 257, uint16_t{0});
   }
 
   // Initialize the output buffer
@@ -522,26 +864,74 @@ Responder *Receiver::setResponder(uint8_t startCode, Responder *r) {
     responderOutBuf_.reset(new uint8_t[outBufSize]);
     // Allocation may have failed on small systems
     if (responderOutBuf_ == nullptr) {
-      responderOutBufLen_ = 0;
-      responders_ = nullptr;
-      responderCount_ = 0;
-      return nullptr;
+      clearResponders();
+      return false;
     }
     responderOutBufLen_ = outBufSize;
   }
 
-  // If a responder is already set then the output buffer should be the
-  // correct size
-  Responder *old = responders_[startCode];
-  responders_[startCode] = r;
-  if (old == nullptr) {
-    responderCount_++;
+  // Grow the chain array, a few entries at a time
+  if (responders_ == nullptr || responderCount_ >= responderCapacity_) {
+    int capacity = responderCapacity_ + 4;
+    Responder **newResponders = new Responder *[capacity];
+    // Allocation may have failed on small systems
+    if (newResponders == nullptr) {
+      clearResponders();
+      return false;
+    }
+    if (responders_ != nullptr) {
+      std::copy_n(&responders_[0], responderCount_, &newResponders[0]);
+    }
+    responders_.reset(newResponders);
+    responderCapacity_ = capacity;
+  }
+
+  // Insert at the end of this start code's chain
+  int pos = responderStarts_[startCode + 1];
+  std::copy_backward(&responders_[pos], &responders_[responderCount_],
+                     &responders_[responderCount_ + 1]);
+  responders_[pos] = r;
+  for (int i = startCode + 1; i <= 256; i++) {
+    responderStarts_[i]++;
   }
+  responderCount_++;
 
-  return old;
+  return true;
+}
+
+void Receiver::eraseResponders(uint8_t startCode, int first, int last) {
+  int n = last - first;
+  if (n <= 0) {
+    return;
+  }
+  std::copy(&responders_[last], &responders_[responderCount_],
+            &responders_[first]);
+  for (int i = startCode + 1; i <= 256; i++) {
+    responderStarts_[i] -= n;
+  }
+  responderCount_ -= n;
+}
+
+void Receiver::releaseRespondersIfEmpty() {
+  // When no more responders, delete all the buffers
+  if (responderCount_ == 0) {
+    clearResponders();
+  }
+}
+
+void Receiver::clearResponders() {
+  responderOutBuf_ = nullptr;
+  responderOutBufLen_ = 0;
+  responders_ = nullptr;
+  responderCount_ = 0;
+  responderCapacity_ = 0;
+  responderStarts_ = nullptr;
 }
 
 void Receiver::completePacket(RecvStates newState) {
+  trace(util::TraceEventType::kReceiveCompletePacket,
+        static_cast<int>(newState), activeBufIndex_);
+
   uint32_t t = millis();
   state_ = newState;  // Should only be kIdle or kDataIdle
 
@@ -558,8 +948,10 @@ void Receiver::completePacket(RecvStates newState) {
   // packets" feature is disabled; otherwise, don't discard the data but mark it
   // as "short".
   // Do this check after first checking activeBufIndex_ because a positive value
-  // means that the following start and end time variables are valid
-  if (lastSlotEndTime_ - breakStartTime_ < kMinDMXPacketTime) {
+  // means that the following start and end time variables are valid.
+  // Use lastBreakStartTime_ because breakStartTime_ already belongs to the
+  // next packet when a new BREAK completes this one.
+  if (lastSlotEndTime_ - lastBreakStartTime_ < kMinDMXPacketTime) {
     errorStats_.shortPacketCount++;
     if (keepShortPackets_) {
       packetStats_.isShort = true;
@@ -571,13 +963,20 @@ void Receiver::completePacket(RecvStates newState) {
     packetStats_.isShort = false;
   }
 
-  // Swap the buffers
-  if (activeBuf_ == buf1_) {
-    activeBuf_ = buf2_;
-    inactiveBuf_ = buf1_;
+  // Swap the buffers. A packet verified by this SIP moves from the inactive
+  // buffer to the verified buffer, and the old verified buffer takes its turn
+  // at receiving.
+  int verifiedSize = sipVerify_ ? verifySIP() : 0;
+  if (verifiedSize > 0) {
+    uint8_t *buf = verifiedBuf_;
+    verifiedBuf_ = const_cast<uint8_t *>(inactiveBuf_);
+    verifiedPacketSize_ = verifiedSize;
+    inactiveBuf_ = activeBuf_;
+    activeBuf_ = buf;
   } else {
-    activeBuf_ = buf1_;
-    inactiveBuf_ = buf2_;
+    uint8_t *buf = activeBuf_;
+    activeBuf_ = const_cast<uint8_t *>(inactiveBuf_);
+    inactiveBuf_ = buf;
   }
 
   incPacketCount();
@@ -586,21 +985,50 @@ void Receiver::completePacket(RecvStates newState) {
   packetStats_.size = packetSize_ = activeBufIndex_;
   packetStats_.extraSize = 0;
   packetStats_.timestamp = t;
-  packetStats_.frameTimestamp = breakStartTime_;
-  packetStats_.packetTime = lastSlotEndTime_ - breakStartTime_;
+  packetStats_.frameTimestamp = lastBreakStartTime_;
+  packetStats_.packetTime = lastSlotEndTime_ - lastBreakStartTime_;
   packetStats_.breakPlusMABTime = packetStats_.nextBreakPlusMABTime;
   packetStats_.breakTime = packetStats_.nextBreakTime;
   packetStats_.mabTime = packetStats_.nextMABTime;
+  packetStats_.breakTimeNs = packetStats_.nextBreakTimeNs;
+  packetStats_.mabTimeNs = packetStats_.nextMABTimeNs;
+
+  // Running timing stats, only for kept packets
+  if (packetSize_ > 0) {
+    if (packetStats_.breakTime != 0) {
+      timingStats_.breakTime.add(packetStats_.breakTime);
+    }
+    if (packetStats_.mabTime != 0) {
+      timingStats_.mabTime.add(packetStats_.mabTime);
+    }
+    if (packetStats_.breakToBreakTime != 0) {
+      timingStats_.breakToBreakTime.add(packetStats_.breakToBreakTime);
+      breakToBreakHistogram_.add(packetStats_.breakToBreakTime);
+    }
+    timingStats_.packetTime.add(packetStats_.packetTime);
+  }
 
-  // Let the responder, if any, process the packet
+  // Let the responders, if any, process the packet
   if (responders_ != nullptr) {
-    Responder *r = responders_[inactiveBuf_[0]];
-    if (r != nullptr) {
-      r->receivePacket(inactiveBuf_, packetSize_);
+    const uint8_t *buf = inactiveBuf_;
+    int size = packetSize_;
+    bool eat = false;
+    for (int i = responderStarts_[buf[0]]; i < responderStarts_[buf[0] + 1];
+         i++) {
+      Responder *r = responders_[i];
+      r->receivePacket(buf, size);
       if (r->eatPacket()) {
-        packetStats_.extraSize = packetStats_.size = packetSize_ = 0;
+        eat = true;
       }
     }
+    if (eat) {
+      packetStats_.extraSize = packetStats_.size = packetSize_ = 0;
+    }
+  }
+
+  // Let any packet-ready function know, outside this ISR
+  if (packetSize_ > 0) {
+    postPacketReady();
   }
   std::atomic_signal_fence(std::memory_order_release);
 
@@ -608,14 +1036,22 @@ void Receiver::completePacket(RecvStates newState) {
 }
 
 void Receiver::idleTimerCallback() {
+  util::ISRProfiler::Scope profile{isrProfiler_};
+  InvariantCheck check{*this};
+
   intervalTimer_.end();
   completePacket(RecvStates::kIdle);
   setConnected(false);
 }
 
-void Receiver::receiveIdle(uint32_t eventTime) {
+void Receiver::receiveIdle(uint32_t eventTime, uint32_t eventCycles) {
+  trace(util::TraceEventType::kReceiveIdle, static_cast<int>(state_),
+        activeBufIndex_);
+  InvariantCheck check{*this};
+
   switch (state_) {
     case RecvStates::kBreak:
+      pollRXCapture();
       if (seenMABStart_) {
         if (!seenMABEnd_) {
           if (rxWatchPin_ >= 0) {
@@ -638,6 +1074,7 @@ void Receiver::receiveIdle(uint32_t eventTime) {
         // We can infer what the rise time is here
         seenMABStart_ = true;
         mabStartTime_ = eventTime - kCharTime;
+        mabStartCycles_ = eventCycles - charTimeCycles_;
         receiveHandler_->setILT(true);  // IDLE detection to "after stop bit"
       }
       break;
@@ -666,7 +1103,12 @@ void Receiver::receiveIdle(uint32_t eventTime) {
                        kMaxDMXIdleTime - kCharTime);
 }
 
-void Receiver::receivePotentialBreak(uint32_t eventTime) {
+void Receiver::receivePotentialBreak(uint32_t eventTime,
+                                     uint32_t eventCycles) {
+  trace(util::TraceEventType::kReceivePotentialBreak,
+        static_cast<int>(state_), activeBufIndex_);
+  InvariantCheck check{*this};
+
   intervalTimer_.end();
 
   // A potential BREAK is detected when a stop bit is expected but not
@@ -675,6 +1117,7 @@ void Receiver::receivePotentialBreak(uint32_t eventTime) {
   // Note that breakStartTime_ only represents a potential BREAK start
   // time until we receive the first character.
   breakStartTime_ = eventTime - kCharTime;
+  breakStartCycles_ = eventCycles - charTimeCycles_;
 
   state_ = RecvStates::kBreak;
 
@@ -686,10 +1129,18 @@ void Receiver::receivePotentialBreak(uint32_t eventTime) {
   if (rxWatchPin_ >= 0) {
     seenMABStart_ = false;
     attachInterrupt(rxWatchPin_, rxPinRoseISRs[serialIndex_], RISING);
+  } else if (rxCapture_.active()) {
+    seenMABStart_ = false;
+    rxCaptureArmCycles_ = util::cycleCount();
+    rxCapture_.arm();
   }
 }
 
 void Receiver::receiveBadBreak() {
+  trace(util::TraceEventType::kReceiveBadBreak, static_cast<int>(state_),
+        activeBufIndex_);
+  InvariantCheck check{*this};
+
   intervalTimer_.end();
 
   // Not a BREAK
@@ -708,6 +1159,10 @@ void Receiver::receiveBadBreak() {
 }
 
 void Receiver::receiveByte(uint8_t b, uint32_t eopTime) {
+  trace(util::TraceEventType::kReceiveByte, static_cast<int>(state_),
+        activeBufIndex_);
+  InvariantCheck check{*this};
+
   intervalTimer_.end();
 
   // Bad BREAKs are detected when BREAK + MAB + character time is too short
@@ -722,6 +1177,9 @@ void Receiver::receiveByte(uint8_t b, uint32_t eopTime) {
       // potential completePacket()
       uint32_t breakTime = 0;
       uint32_t mabTime = 0;
+      uint32_t breakTimeNs = 0;
+      uint32_t mabTimeNs = 0;
+      pollRXCapture();
       if (seenMABStart_) {
         seenMABStart_ = false;
         if (seenMABEnd_) {
@@ -731,6 +1189,8 @@ void Receiver::receiveByte(uint8_t b, uint32_t eopTime) {
             receiveBadBreak();
             return;
           }
+          mabTimeNs = util::cyclesToNs(mabEndCycles_ - mabStartCycles_,
+                                       nsPerCycleQ16_);
         } else {
           if (rxWatchPin_ >= 0) {
             detachInterrupt(rxWatchPin_);
@@ -741,8 +1201,11 @@ void Receiver::receiveByte(uint8_t b, uint32_t eopTime) {
             return;
           }
           mabTime = eopTime - kCharTime - mabStartTime_;
+          mabTimeNs = mabTime * 1000;  // Inferred, so no better resolution
         }
         breakTime = mabStartTime_ - breakStartTime_;
+        breakTimeNs = util::cyclesToNs(mabStartCycles_ - breakStartCycles_,
+                                       nsPerCycleQ16_);
         if (mabTime >= kMaxDMXIdleTime) {
           completePacket(RecvStates::kIdle);
           setConnected(false);
@@ -768,6 +1231,8 @@ void Receiver::receiveByte(uint8_t b, uint32_t eopTime) {
         // Complete any un-flushed bytes
         uint32_t dt = breakStartTime_ - lastBreakStartTime_;
         packetStats_.breakToBreakTime = dt;
+        packetStats_.breakToBreakTimeNs = util::cyclesToNs(
+            breakStartCycles_ - lastBreakStartCycles_, nsPerCycleQ16_);
 
         // In the following checks, the packet time limits are the same as the
         // BREAK-to-BREAK time limits
@@ -785,6 +1250,7 @@ void Receiver::receiveByte(uint8_t b, uint32_t eopTime) {
         completePacket(RecvStates::kIdle);
       } else {
         packetStats_.breakToBreakTime = 0;
+        packetStats_.breakToBreakTimeNs = 0;
         activeBufIndex_ = 0;
       }
 
@@ -795,8 +1261,11 @@ void Receiver::receiveByte(uint8_t b, uint32_t eopTime) {
       packetStats_.nextBreakPlusMABTime = eopTime - kCharTime - breakStartTime_;
       packetStats_.nextBreakTime = breakTime;
       packetStats_.nextMABTime = mabTime;
+      packetStats_.nextBreakTimeNs = breakTimeNs;
+      packetStats_.nextMABTimeNs = mabTimeNs;
 
       lastBreakStartTime_ = breakStartTime_;
+      lastBreakStartCycles_ = breakStartCycles_;
       setConnected(true);
       state_ = RecvStates::kData;
       break;
@@ -866,27 +1335,42 @@ void Receiver::receiveByte(uint8_t b, uint32_t eopTime) {
                             // has been reached.
                             // Using this is necessary so that the responder's
                             // processByte is called before its receivePacket.
+  if (activeBufIndex_ == 0) {
+    rxChecksum_ = 0;
+  }
+  rxChecksum_ += b;
   activeBuf_[activeBufIndex_++] = b;
   if (activeBufIndex_ == kMaxDMXPacketSize) {
     packetFull = true;
   }
 
   // See if a responder needs to process the byte and respond
-  Responder *r = nullptr;
+  int first = 0;
+  int last = 0;
   if (responders_ != nullptr) {
-    r = responders_[activeBuf_[0]];
+    first = responderStarts_[activeBuf_[0]];
+    last = responderStarts_[activeBuf_[0] + 1];
   }
-  if (r == nullptr) {
+  if (first >= last) {
     if (packetFull) {
       completePacket(RecvStates::kDataIdle);
     }
     return;
   }
 
-  // Let the responder process the data
-  int respLen =
-      r->processByte(activeBuf_, activeBufIndex_, responderOutBuf_.get());
-  if (respLen <= 0) {
+  // Let the responders process the data, in chain order; the first one to
+  // return a response claims it
+  Responder *r = nullptr;
+  int respLen = 0;
+  for (int i = first; i < last; i++) {
+    respLen = responders_[i]->processByte(activeBuf_, activeBufIndex_,
+                                          responderOutBuf_.get());
+    if (respLen > 0) {
+      r = responders_[i];
+      break;
+    }
+  }
+  if (r == nullptr) {
     if (packetFull) {
       // If the responder isn't done by now, it's too late for this packet
       // because the maximum packet size has been reached
@@ -931,8 +1415,61 @@ void Receiver::receiveByte(uint8_t b, uint32_t eopTime) {
   setTXNotRX(false);
 }
 
+void Receiver::onPacketReady(void (*f)(Receiver *r)) {
+  if (f == nullptr) {
+    packetReadyFunc_ = nullptr;
+    packetReadyEvent_.detach();
+    packetReadyPending_ = false;
+    return;
+  }
+
+  // Attach before setting the function so that the ISR never posts an event
+  // to an unattached responder
+  if (packetReadyFunc_ == nullptr) {
+    packetReadyEvent_.setContext(this);
+    packetReadyEvent_.attachInterrupt(&packetReadyHandler);
+  }
+  packetReadyFunc_ = f;
+}
+
+void Receiver::postPacketReady() {
+  if (packetReadyFunc_ == nullptr) {
+    return;
+  }
+  if (packetReadyPending_) {
+    packetReadyMissedCount_ = packetReadyMissedCount_ + 1;
+    return;
+  }
+  packetReadyPending_ = true;
+  packetReadyEvent_.triggerEvent();
+}
+
+void Receiver::packetReadyHandler(EventResponderRef ev) {
+  Receiver *r = static_cast<Receiver *>(ev.getContext());
+  if (r == nullptr) {
+    return;
+  }
+
+  // Clear the flag before calling so that a packet completing while the
+  // function runs posts a new event
+  r->packetReadyPending_ = false;
+  void (*f)(Receiver *r) = r->packetReadyFunc_;
+  if (f != nullptr) {
+    f(r);
+  }
+}
+
 void Receiver::setConnected(bool flag) {
   if (connected_ != flag) {
+    // A connection can only follow a valid BREAK, and a disconnection while
+    // running can only follow ending the packet
+    if (flag) {
+      if (state_ != RecvStates::kBreak) {
+        invariantViolated(Invariant::kConnectCause);
+      }
+    } else if (began_ && state_ != RecvStates::kIdle) {
+      invariantViolated(Invariant::kDisconnectCause);
+    }
     connected_ = flag;
     void (*f)(Receiver *r) = connectChangeFunc_;
     if (f != nullptr) {
@@ -958,6 +1495,9 @@ void Receiver::setIRQState(bool flag) const {
 
 void Receiver::setRXWatchPin(int pin) {
   ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (pin >= 0) {
+      rxCapture_.end();
+    }
     if (pin < 0) {
       if (rxWatchPin_ >= 0) {
         detachInterrupt(rxWatchPin_);
@@ -976,8 +1516,75 @@ void Receiver::setRXWatchPin(int pin) {
   }
 }
 
+bool Receiver::setRXCapturePin(int pin) {
+  bool retval = true;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    seenMABStart_ = false;
+    if (pin < 0) {
+      rxCapture_.end();
+    } else if (pin != rxCapture_.pin()) {
+      if (rxWatchPin_ >= 0) {
+        detachInterrupt(rxWatchPin_);
+        rxWatchPin_ = -1;
+      }
+      if (rxCapture_.begin(pin)) {
+        uint32_t ticksPerSec = util::InputCapture::ticksPerSecond();
+        cyclesPerTickQ16_ = static_cast<uint32_t>(
+            (uint64_t{util::cyclesPerSecond()} << 16) / ticksPerSec);
+        capturePeriodCycles_ = static_cast<uint32_t>(
+            (uint64_t{util::InputCapture::kPeriodTicks} * cyclesPerTickQ16_) >>
+            16);
+      } else {
+        retval = false;
+      }
+    }
+  }
+  return retval;
+}
+
+void Receiver::pollRXCapture() {
+  if (!rxCapture_.active()) {
+    return;
+  }
+
+  uint32_t riseTicks;
+  uint32_t fallTicks;
+  int edges = rxCapture_.read(&riseTicks, &fallTicks);
+  if (edges <= 0) {
+    return;
+  }
+
+  // If a whole counter period has passed since arming then the values are
+  // ambiguous, so don't use them
+  if (util::cycleCount() - rxCaptureArmCycles_ >= capturePeriodCycles_) {
+    return;
+  }
+
+  if (!seenMABStart_) {
+    mabStartCycles_ = rxCaptureArmCycles_ +
+                      static_cast<uint32_t>(
+                          (uint64_t{riseTicks} * cyclesPerTickQ16_) >> 16);
+    mabStartTime_ = breakStartTime_ +
+                    util::cyclesToNs(mabStartCycles_ - breakStartCycles_,
+                                     nsPerCycleQ16_) / 1000;
+    seenMABStart_ = true;
+    seenMABEnd_ = false;
+    receiveHandler_->setILT(true);  // Set IDLE detection to "after stop bit"
+  }
+  if (edges >= 2 && !seenMABEnd_) {
+    mabEndCycles_ = rxCaptureArmCycles_ +
+                    static_cast<uint32_t>(
+                        (uint64_t{fallTicks} * cyclesPerTickQ16_) >> 16);
+    mabEndTime_ = breakStartTime_ +
+                  util::cyclesToNs(mabEndCycles_ - breakStartCycles_,
+                                   nsPerCycleQ16_) / 1000;
+    seenMABEnd_ = true;
+  }
+}
+
 void Receiver::rxPinFell_isr() {
   if (seenMABStart_) {
+    mabEndCycles_ = util::cycleCount();
     mabEndTime_ = micros();
     seenMABEnd_ = true;
   }
@@ -986,6 +1593,7 @@ void Receiver::rxPinFell_isr() {
 
 void Receiver::rxPinRose_isr() {
   if (!seenMABStart_) {
+    mabStartCycles_ = util::cycleCount();
     mabStartTime_ = micros();
     seenMABStart_ = true;
     seenMABEnd_ = false;
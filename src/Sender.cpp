@@ -5,8 +5,11 @@
 
 // C++ includes
 #include <algorithm>
+#include <atomic>
 #include <limits>
 
+#include <core_pins.h>
+
 namespace qindesign {
 namespace teensydmx {
 
@@ -41,6 +44,7 @@ constexpr uint32_t kSerialFormatTXINVBit = 0x20;
 #ifndef TEENSYDMX_USE_PERIODICTIMER
 // Empirically observed BREAK generation adjustment constants, for 180us. The
 // timer adjust values are added to the requested BREAK to get the actual BREAK.
+// These are the defaults; see `Sender::setTimerCalibration`.
 #if defined(__MK20DX128__) || defined(__MK20DX256__)
 constexpr uint32_t kBreakTimerAdjust = 1;
 #elif defined(__MKL26Z64__)
@@ -58,6 +62,7 @@ constexpr uint32_t kBreakTimerAdjust = 0;
 
 // Empirically observed MAB generation adjustment constants, for 20us. The timer
 // adjust values are subtracted from the requested MAB to get the actual MAB.
+// These are the defaults; see `Sender::setTimerCalibration`.
 #if defined(__MK20DX128__) || defined(__MK20DX256__)
 constexpr uint32_t kMABTimerAdjust = 7;
 #elif defined(__MKL26Z64__)
@@ -75,6 +80,7 @@ constexpr uint32_t kMABTimerAdjust = 0;
 // Empirically observed inter-slot timer adjustment constants, for 40us. The
 // timer adjust values are subtracted from the requested value to get the
 // actual value.
+// These are the defaults; see `Sender::setTimerCalibration`.
 #if defined(__MK20DX128__) || defined(__MK20DX256__)
 constexpr uint32_t kInterSlotTimerAdjust = 9;
 #elif defined(__MKL26Z64__)
@@ -89,6 +95,10 @@ constexpr uint32_t kInterSlotTimerAdjust = 2;
 constexpr uint32_t kInterSlotTimerAdjust = 0;
 #endif  // Which chip?
 
+// The number of times txStats() copies the stats without locking before it
+// gives up and copies them with the UART IRQs disabled.
+constexpr int kTXStatsReadTries = 4;
+
 // Empirically observed MBB timer adjustment constants. The timer adjust values
 // are subtracted from the requested value to get the actual value.
 // kMBBTimerMin: When the delay is zero
@@ -122,6 +132,51 @@ constexpr uint32_t kMBBTimerMinAdjusted = 0;
 constexpr uint32_t kMBBTimerAdjust = 0;
 #endif  // Which chip?
 
+// The longest BREAK-to-BREAK period the refresh rate schedule supports, in
+// microseconds. This keeps signed time differences valid.
+constexpr uint32_t kMaxBreakToBreakPeriod = INT32_MAX;
+
+extern const uint32_t kBitTime;
+
+// The number of bits in a slot, including the start and stop bits.
+constexpr uint32_t kSlotBits = 11;
+
+// The most MARK bits the UART can append to a slot, using 9- or 10-bit data.
+constexpr uint32_t kMaxInterSlotPadBits = 2;
+
+// Works out how the UART can produce an inter-slot MARK time of at least `t`
+// microseconds: `padBits` extra MARK bits in each slot, plus `idleChars` idle
+// characters after it, each one a slot long, including the padding. This
+// chooses the shortest such time, and then the fewest idle characters.
+static void serialInterSlot(uint32_t t, uint8_t *padBits, int *idleChars) {
+  uint32_t bits = (t + kBitTime - 1) / kBitTime;
+  uint32_t best = UINT32_MAX;
+  for (uint32_t p = 0; p <= kMaxInterSlotPadBits; p++) {
+    uint32_t charBits = kSlotBits + p;
+    uint32_t k = 0;
+    if (bits > p) {
+      k = (bits - p + charBits - 1) / charBits;
+    }
+    uint32_t total = p + k*charBits;
+    if (total < best || (total == best && static_cast<int>(k) < *idleChars)) {
+      best = total;
+      *padBits = p;
+      *idleChars = k;
+    }
+  }
+}
+
+// Returns the timer value for the given MBB time.
+static uint32_t adjustMBBTime(uint32_t t) {
+  if (t <= kMBBTimerMin) {
+    return 0;
+  }
+  if (t <= kMBBTimerMinAdjusted + kMBBTimerAdjust) {
+    return kMBBTimerMinAdjusted;
+  }
+  return t - kMBBTimerAdjust;
+}
+
 // TX ISR routines
 #if defined(HAS_KINETISK_UART0) || defined(HAS_KINETISL_UART0)
 void uart0_tx_isr();
@@ -207,15 +262,57 @@ Sender::Sender(HardwareSerial &uart)
       breakBaud_(kDefaultBreakBaud),
       breakFormat_(kDefaultBreakFormat),
       breakUseTimer_(false),
+      timerCalibration_(defaultTimerCalibration()),
       interSlotTime_(0),
       adjustedInterSlotTime_(0),
+      packetInterSlotTime_(0),
+      packetAdjustedInterSlotTime_(0),
+      interSlotUseTimer_(true),
+      packetInterSlotSerial_(false),
+      packetInterSlotPadBits_(0),
+      packetInterSlotIdleChars_(0),
+      interSlotIdleRemaining_(0),
       activePacketSize_(kMaxDMXPacketSize),
       inactivePacketSize_(kMaxDMXPacketSize),
+      frameProcessors_{nullptr},
+      frameProcessorCount_(0),
+      frameQueue_{},
+      frameQueueHead_(0),
+      frameQueueCount_(0),
+      queuedFrameLoaded_(false),
+      queuedFrameAdjustedMBBTime_(0),
+      txChecksum_(0),
+      sipInterval_(0),
+      sipConfig_{},
+      sipNullPacketCount_(0),
+      sipPacketCount_(0),
+      sipSequence_(0),
+      autoPacketSize_(false),
+      autoPacketSizeMark_(1),
       mbbTime_(0),
       adjustedMBBTime_(0),
       refreshRate_(std::numeric_limits<float>::infinity()),
       breakToBreakTime_(0),
-      breakStartTime_(0),
+      breakToBreakFrac_(0),
+      nextBreakTime_(0),
+      nextBreakFrac_(0),
+      breakScheduleValid_(false),
+      externalTrigger_(false),
+      triggerPhase_(0),
+      triggerArmed_(false),
+      triggered_(false),
+      triggerArmTime_(0),
+      triggerTime_(0),
+      triggerCycles_(0),
+      triggerLatencyPending_(false),
+      triggerStats_{},
+      nsPerCycleQ16_(0),
+      txStats_{},
+      txStatsSeq_(0),
+      txBreakStartCycles_(0),
+      txBreakEndCycles_(0),
+      txPacketEndCycles_(0),
+      txStatsContinuous_(false),
       paused_(false),
       resumeCounter_(0),
       transmitting_(false),
@@ -339,6 +436,14 @@ void Sender::begin() {
 
   // Reset all the stats
   resetPacketCount();
+  isrProfiler_.reset();
+  triggerStats_ = TriggerStats{};
+  txStats_ = TXStats{};
+  txStatsContinuous_ = false;
+
+  // High-resolution timing
+  util::enableCycleCounter();
+  nsPerCycleQ16_ = util::nsPerCycleQ16();
 
   // Set up the instance for the ISRs
   Sender *s = txInstances[serialIndex_];
@@ -349,6 +454,13 @@ void Sender::begin() {
 
   transmitting_ = false;
   state_ = XmitStates::kIdle;
+  breakScheduleValid_ = false;
+  queuedFrameLoaded_ = false;
+  restorePacketTiming();
+  txChecksum_ = 0;
+  triggerArmed_ = false;
+  triggered_ = false;
+  triggerLatencyPending_ = false;
 
   sendHandler_->start();
   intervalTimer_.setPriority(sendHandler_->priority());
@@ -383,7 +495,7 @@ void Sender::end() {
 #ifndef TEENSYDMX_USE_PERIODICTIMER
 void Sender::setBreakTime(uint32_t t) {
   breakTime_ = t;
-  adjustedBreakTime_ = t + kBreakTimerAdjust;
+  adjustedBreakTime_ = timerCalibration_.breakTime.apply(t);
 }
 #endif  // !TEENSYDMX_USE_PERIODICTIMER
 
@@ -420,11 +532,7 @@ uint32_t Sender::breakTime() const {
 
 void Sender::setMABTime(uint32_t t) {
   mabTime_ = t;
-  if (t <= kMABTimerAdjust) {
-    adjustedMABTime_ = 0;
-  } else {
-    adjustedMABTime_ = t - kMABTimerAdjust;
-  }
+  adjustedMABTime_ = timerCalibration_.mabTime.apply(t);
 }
 
 uint32_t Sender::mabTime() const {
@@ -467,8 +575,7 @@ bool Sender::setBreakSerialParams(uint32_t baud, uint32_t format) {
     return false;
   }
 
-  switch (breakSerialFormat() &
-          ~(kSerialFormatTXINVBit | kSerialFormatRXINVBit)) {
+  switch (format & ~kSerialFormatRXINVBit) {
     case SERIAL_7E1:
     case SERIAL_7O1:
     case SERIAL_8N1:
@@ -499,10 +606,10 @@ bool Sender::setBreakSerialParams(uint32_t baud, uint32_t format) {
 
 void Sender::setInterSlotTime(uint32_t t) {
   interSlotTime_ = t;
-  if (t <= kInterSlotTimerAdjust) {
-    adjustedInterSlotTime_ = 0;
-  } else {
-    adjustedInterSlotTime_ = t - kInterSlotTimerAdjust;
+  adjustedInterSlotTime_ = timerCalibration_.interSlotTime.apply(t);
+  if (!queuedFrameLoaded_) {
+    packetInterSlotTime_ = t;
+    packetAdjustedInterSlotTime_ = adjustedInterSlotTime_;
   }
 }
 
@@ -510,6 +617,44 @@ uint32_t Sender::interSlotTime() const {
   return interSlotTime_;
 }
 
+uint32_t Sender::TimerCorrection::apply(uint32_t t) const {
+  int64_t x = (int64_t{t} << 16) - offset;
+  if (x <= 0) {
+    return 0;
+  }
+
+  // Split the multiply so that it can't overflow
+  uint64_t u = static_cast<uint64_t>(x);
+  uint64_t y = (u >> 16)*gain + (((u & 0xffff)*gain) >> 16);
+  return static_cast<uint32_t>(
+      std::min(uint64_t{UINT32_MAX}, (y + 0x8000) >> 16));
+}
+
+Sender::TimerCalibration Sender::defaultTimerCalibration() {
+  TimerCalibration cal;
+#ifndef TEENSYDMX_USE_PERIODICTIMER
+  cal.breakTime.offset = -static_cast<int32_t>(kBreakTimerAdjust << 16);
+#endif  // !TEENSYDMX_USE_PERIODICTIMER
+  cal.mabTime.offset = static_cast<int32_t>(kMABTimerAdjust << 16);
+  cal.interSlotTime.offset = static_cast<int32_t>(kInterSlotTimerAdjust << 16);
+  return cal;
+}
+
+void Sender::setTimerCalibration(const TimerCalibration &cal) {
+  Lock lock{*this};
+  //{
+    timerCalibration_ = cal;
+    setBreakTime(breakTime_);
+    setMABTime(mabTime_);
+    setInterSlotTime(interSlotTime_);
+  //}
+}
+
+Sender::TimerCalibration Sender::timerCalibration() const {
+  Lock lock{*this};
+  return timerCalibration_;
+}
+
 bool Sender::setPacketSizeAndData(int size,
                                   int startChannel,
                                   const uint8_t *values,
@@ -551,6 +696,33 @@ bool Sender::setPacketSize(int size) {
   return true;
 }
 
+void Sender::setAutoPacketSize(bool flag) {
+  Lock lock{*this};
+  //{
+    autoPacketSize_ = flag;
+    autoPacketSizeMark_ = 1;
+  //}
+}
+
+int Sender::nextPacketSize() {
+  int size = activePacketSize_;
+  if (!autoPacketSize_) {
+    return size;
+  }
+
+  // Only the slots above the mark need to be checked because the mark
+  // never decreases
+  int mark = autoPacketSizeMark_;
+  for (int i = size - 1; i >= mark; i--) {
+    if (activeBuf_[i] != 0) {
+      mark = i + 1;
+      break;
+    }
+  }
+  autoPacketSizeMark_ = mark;
+  return std::min(std::max(mark, kMinDMXPacketSize), size);
+}
+
 bool Sender::set(int channel, uint8_t value) {
   if (channel < 0 || kMaxDMXPacketSize <= channel) {
     return false;
@@ -645,15 +817,97 @@ bool Sender::fill(int startChannel, int len, uint8_t value) {
   return true;
 }
 
+bool Sender::addFrameProcessor(FrameProcessor *p) {
+  if (p == nullptr) {
+    return false;
+  }
+
+  Lock lock{*this};
+  //{
+    int count = frameProcessorCount_;
+    for (int i = 0; i < count; i++) {
+      if (frameProcessors_[i] == p) {
+        return true;
+      }
+    }
+    if (count >= kMaxFrameProcessors) {
+      return false;
+    }
+    frameProcessors_[count] = p;
+    frameProcessorCount_ = count + 1;
+  //}
+  return true;
+}
+
+bool Sender::removeFrameProcessor(FrameProcessor *p) {
+  Lock lock{*this};
+  //{
+    int count = frameProcessorCount_;
+    for (int i = 0; i < count; i++) {
+      if (frameProcessors_[i] == p) {
+        std::copy(&frameProcessors_[i + 1], &frameProcessors_[count],
+                  &frameProcessors_[i]);
+        frameProcessorCount_ = count - 1;
+        return true;
+      }
+    }
+  //}
+  return false;
+}
+
+bool Sender::queueFrame(const uint8_t *data, int size,
+                        uint32_t mbbTime, uint32_t interSlotTime) {
+  if (data == nullptr || size <= 0 || kMaxDMXPacketSize < size) {
+    return false;
+  }
+
+  Lock lock{*this};
+  //{
+    int count = frameQueueCount_;
+    if (count >= kFrameQueueSize) {
+      return false;
+    }
+    frameQueue_[(frameQueueHead_ + count) % kFrameQueueSize] =
+        QueuedFrame{data, size, mbbTime, interSlotTime};
+    frameQueueCount_ = count + 1;
+  //}
+  return true;
+}
+
+void Sender::clearFrameQueue() {
+  Lock lock{*this};
+  frameQueueCount_ = 0;
+}
+
+bool Sender::setAutoSIP(int interval) {
+  if (interval < 0) {
+    return false;
+  }
+
+  Lock lock{*this};
+  //{
+    if (sipInterval_ == 0) {
+      sipNullPacketCount_ = 0;
+      sipPacketCount_ = 0;
+    }
+    sipInterval_ = interval;
+  //}
+  return true;
+}
+
+void Sender::setSIPConfig(const SIPConfig &config) {
+  Lock lock{*this};
+  sipConfig_ = config;
+}
+
+Sender::SIPConfig Sender::sipConfig() const {
+  Lock lock{*this};
+  return sipConfig_;
+}
+
 void Sender::setMBBTime(uint32_t t) {
   mbbTime_ = t;
-  if (t <= kMBBTimerMin) {
-    adjustedMBBTime_ = 0;
-  } else if (t <= kMBBTimerMinAdjusted + kMBBTimerAdjust) {
-    adjustedMBBTime_ = kMBBTimerMinAdjusted;
-  } else {
-    adjustedMBBTime_ = t - kMBBTimerAdjust;
-  }
+  adjustedMBBTime_ = adjustMBBTime(t);
 }
 
 uint32_t Sender::mbbTime() const {
@@ -664,19 +918,116 @@ bool Sender::setRefreshRate(float rate) {
   if ((rate != rate) || rate < 0.0f) {  // NaN or negative
     return false;
   }
+  if (rate != 0.0f && refreshRate_ == 0.0f) {
+    end();
+    begin();
+  }
+
+  // Compute the period in double precision so that the fraction is exact to
+  // well under 1ppm
+  uint32_t t;
+  uint32_t frac = 0;
   if (rate == 0.0f) {
-    breakToBreakTime_ = UINT32_MAX;
+    t = UINT32_MAX;
   } else {
-    if (refreshRate_ == 0.0f) {
-      end();
-      begin();
+    double period = 1000000.0 / rate;
+    if (period >= kMaxBreakToBreakPeriod) {
+      t = kMaxBreakToBreakPeriod;
+    } else {
+      t = static_cast<uint32_t>(period);
+      frac = static_cast<uint32_t>((period - t) * 4294967296.0);
     }
-    breakToBreakTime_ = 1000000 / rate;
   }
-  refreshRate_ = rate;
+
+  Lock lock{*this};
+  //{
+    breakToBreakTime_ = t;
+    breakToBreakFrac_ = frac;
+    breakScheduleValid_ = false;
+    refreshRate_ = rate;
+  //}
   return true;
 }
 
+uint32_t Sender::nextBreakDelay() {
+  uint32_t now = micros();
+  uint32_t earliest = now + adjustedMBBTime_;
+  uint32_t period = breakToBreakTime_;
+  uint32_t periodFrac = breakToBreakFrac_;
+
+  // A queued frame follows the previous packet after only its MBB and doesn't
+  // use up a slot in the schedule
+  if (queuedFrameLoaded_) {
+    return queuedFrameAdjustedMBBTime_;
+  }
+
+  // External trigger: wait for the phase offset after the trigger, but
+  // respect the MBB after the previous packet
+  if (externalTrigger_) {
+    breakScheduleValid_ = false;
+    uint32_t delay = 0;
+    uint32_t elapsed = now - triggerArmTime_;
+    if (elapsed < adjustedMBBTime_) {
+      delay = adjustedMBBTime_ - elapsed;
+    }
+    elapsed = now - triggerTime_;
+    if (elapsed < triggerPhase_) {
+      delay = std::max(delay, triggerPhase_ - elapsed);
+    }
+    return delay;
+  }
+
+  // As fast as possible
+  if (period == 0 && periodFrac == 0) {
+    breakScheduleValid_ = false;
+    return earliest - now;
+  }
+
+  // Restart the schedule if it's not valid or if we've fallen more than a
+  // whole period behind, for example after a pause or when the rate can't be
+  // achieved. Being a little late keeps the schedule so that the next BREAK
+  // can catch up. The schedule can't legitimately be more than a period ahead,
+  // so that means the time wrapped around during a very long pause.
+  int32_t late = static_cast<int32_t>(earliest - nextBreakTime_);
+  if (breakScheduleValid_ && txStatsContinuous_ && period > 0 &&
+      late > static_cast<int32_t>(period)) {
+    beginTXStatsUpdate();
+    txStats_.missedFrameCount += static_cast<uint32_t>(late) / period;
+    endTXStatsUpdate();
+  }
+  if (!breakScheduleValid_ || late > static_cast<int32_t>(period) ||
+      late < -static_cast<int32_t>(period)) {
+    nextBreakTime_ = earliest;
+    nextBreakFrac_ = 0;
+    late = 0;
+    breakScheduleValid_ = true;
+  }
+  uint32_t target = (late > 0) ? earliest : nextBreakTime_;
+
+  // Advance by one period
+  uint32_t frac = nextBreakFrac_ + periodFrac;
+  nextBreakTime_ += period + ((frac < nextBreakFrac_) ? 1 : 0);
+  nextBreakFrac_ = frac;
+
+  return target - now;
+}
+
+util::TXTiming Sender::timing() const {
+  int size = autoPacketSize_ ? inactivePacketSize_ : activePacketSize_;
+  uint32_t interSlot = interSlotTime();
+#if defined(__IMXRT1062__) || defined(__IMXRT1052__)
+  // The UART rounds the inter-slot time up to what it can produce
+  if (!interSlotUseTimer_ && interSlot != 0) {
+    uint8_t padBits = 0;
+    int idleChars = 0;
+    serialInterSlot(interSlot, &padBits, &idleChars);
+    interSlot = (padBits + idleChars*(kSlotBits + padBits))*kBitTime;
+  }
+#endif  // __IMXRT1062__ || __IMXRT1052__
+  return util::TXTiming{breakTime(), mabTime(), interSlot, mbbTime(),
+                        size, refreshRate_};
+}
+
 void Sender::resume() {
   resumeFor(0);
 }
@@ -697,7 +1048,14 @@ bool Sender::resumeFor(int n, void (*doneTXFunc)(Sender *s)) {
     if (paused_) {
       // Copy the active buffer into the inactive buffer
       std::copy_n(&activeBuf_[0], kMaxDMXPacketSize, &inactiveBuf_[0]);
-      inactivePacketSize_ = activePacketSize_;
+      inactivePacketSize_ = nextPacketSize();
+      queuedFrameLoaded_ = false;
+      restorePacketTiming();
+
+      // Forget any trigger that arrived while pausing
+      triggerArmed_ = false;
+      triggered_ = false;
+      triggerLatencyPending_ = false;
 
       if (began_ && !transmitting_) {
         sendHandler_->setActive();
@@ -711,6 +1069,171 @@ bool Sender::resumeFor(int n, void (*doneTXFunc)(Sender *s)) {
   return true;
 }
 
+void Sender::setExternalTrigger(bool flag) {
+  Lock lock{*this};
+  //{
+    externalTrigger_ = flag;
+    triggerArmed_ = false;
+    triggered_ = false;
+    triggerLatencyPending_ = false;
+    breakScheduleValid_ = false;
+
+    // Stop waiting for a trigger if we were
+    if (!flag && began_ && !paused_ && !transmitting_) {
+      sendHandler_->setActive();
+    }
+  //}
+}
+
+void Sender::triggerFrame() {
+  uint32_t cycles = util::cycleCount();
+  uint32_t t = micros();
+  if (!began_ || !externalTrigger_) {
+    return;
+  }
+
+  Lock lock{*this};
+  //{
+    triggerStats_.triggerCount++;
+    if (paused_) {
+      return;
+    }
+    if (!triggerArmed_) {
+      triggerStats_.missedCount++;
+      return;
+    }
+    triggerArmed_ = false;
+    triggered_ = true;
+    triggerTime_ = t;
+    triggerCycles_ = cycles;
+    triggerLatencyPending_ = true;
+
+    // The ISR starts the packet
+    sendHandler_->setActive();
+  //}
+}
+
+Sender::TriggerStats Sender::triggerStats() const {
+  Lock lock{*this};
+  std::atomic_signal_fence(std::memory_order_acquire);
+  return triggerStats_;
+}
+
+void Sender::resetTriggerStats() {
+  Lock lock{*this};
+  triggerStats_ = TriggerStats{};
+  std::atomic_signal_fence(std::memory_order_release);
+}
+
+Sender::TXStats Sender::txStats() const {
+  TXStats stats;
+  for (int i = 0; i < kTXStatsReadTries; i++) {
+    uint32_t seq = txStatsSeq_;
+    std::atomic_signal_fence(std::memory_order_acquire);
+    stats = txStats_;
+    std::atomic_signal_fence(std::memory_order_acquire);
+    if ((seq & 0x01) == 0 && seq == txStatsSeq_) {
+      return stats;
+    }
+  }
+
+  // The ISR keeps updating the stats, so stop it from running. If the update
+  // is still in progress then this was called from an interrupt that
+  // preempted it, and the copy can't be made consistent.
+  Lock lock{*this};
+  //{
+    stats = txStats_;
+    stats.isPartial = ((txStatsSeq_ & 0x01) != 0);
+  //}
+  return stats;
+}
+
+void Sender::resetTXStats() {
+  Lock lock{*this};
+  //{
+    beginTXStatsUpdate();
+    txStats_ = TXStats{};
+    txStatsContinuous_ = false;
+    endTXStatsUpdate();
+  //}
+}
+
+void Sender::beginTXStatsUpdate() {
+  txStatsSeq_ = txStatsSeq_ + 1;
+  std::atomic_signal_fence(std::memory_order_release);
+}
+
+void Sender::endTXStatsUpdate() {
+  std::atomic_signal_fence(std::memory_order_release);
+  txStatsSeq_ = txStatsSeq_ + 1;
+}
+
+bool Sender::waitForTrigger() {
+  if (!externalTrigger_ || queuedFrameLoaded_) {
+    return false;
+  }
+  if (triggered_) {
+    triggered_ = false;
+    return false;
+  }
+  if (!triggerArmed_) {
+    triggerArmTime_ = micros();
+    triggerArmed_ = true;
+  }
+  return true;
+}
+
+void Sender::breakStarted() {
+  uint32_t cycles = util::cycleCount();
+
+  beginTXStatsUpdate();
+  txStats_.frameCount++;
+  if (txStatsContinuous_) {
+    uint32_t d = cycles - txBreakStartCycles_;
+    txStats_.lastBreakToBreakTimeNs = util::cyclesToNs(d, nsPerCycleQ16_);
+    txStats_.breakToBreakTime.add(util::cyclesToUs(d, nsPerCycleQ16_));
+    d = cycles - txPacketEndCycles_;
+    txStats_.lastMBBTimeNs = util::cyclesToNs(d, nsPerCycleQ16_);
+    txStats_.mbbTime.add(util::cyclesToUs(d, nsPerCycleQ16_));
+  }
+  endTXStatsUpdate();
+  txBreakStartCycles_ = cycles;
+  txBreakEndCycles_ = cycles;
+
+  if (triggerLatencyPending_) {
+    triggerLatencyPending_ = false;
+    uint32_t d = cycles - triggerCycles_;
+    triggerStats_.lastLatencyNs = util::cyclesToNs(d, nsPerCycleQ16_);
+    triggerStats_.latency.add(util::cyclesToUs(d, nsPerCycleQ16_));
+  }
+}
+
+void Sender::breakEnded() {
+  uint32_t cycles = util::cycleCount();
+  uint32_t d = cycles - txBreakStartCycles_;
+  txBreakEndCycles_ = cycles;
+
+  beginTXStatsUpdate();
+  txStats_.lastBreakTimeNs = util::cyclesToNs(d, nsPerCycleQ16_);
+  txStats_.breakTime.add(util::cyclesToUs(d, nsPerCycleQ16_));
+  endTXStatsUpdate();
+}
+
+void Sender::mabEnded() {
+  uint32_t d = util::cycleCount() - txBreakEndCycles_;
+
+  beginTXStatsUpdate();
+  txStats_.lastMABTimeNs = util::cyclesToNs(d, nsPerCycleQ16_);
+  txStats_.mabTime.add(util::cyclesToUs(d, nsPerCycleQ16_));
+  endTXStatsUpdate();
+}
+
+void Sender::timerFailed() {
+  beginTXStatsUpdate();
+  txStats_.timerFailCount++;
+  endTXStatsUpdate();
+}
+
 bool Sender::isTransmitting() const {
   // Check these both atomically
   Lock lock{*this};
@@ -721,15 +1244,64 @@ bool Sender::isTransmitting() const {
 }
 
 void Sender::completePacket() {
-  // Copy the active buffer into the inactive buffer
-  std::copy_n(&activeBuf_[0], kMaxDMXPacketSize, &inactiveBuf_[0]);
-  inactivePacketSize_ = activePacketSize_;
+  uint32_t startCycles = util::cycleCount();
+  trace(util::TraceEventType::kSendCompletePacket, static_cast<int>(state_),
+        inactiveBufIndex_);
+
+  uint16_t checksum = txChecksum_;
+  txChecksum_ = 0;
+
+  // Count packets for any SIP
+  bool sendSIP = false;
+  if (sipInterval_ > 0) {
+    uint8_t startCode = inactiveBuf_[0];
+    if (startCode != kSIPStartCode) {
+      sipPacketCount_++;
+    }
+    if (startCode == 0 && ++sipNullPacketCount_ >= sipInterval_) {
+      sipNullPacketCount_ = 0;
+      sendSIP = !paused_;
+    }
+  }
+
+  if (sendSIP) {
+    // Send a SIP right after this packet
+    loadSIP(checksum);
+  } else if (!paused_ && frameQueueCount_ > 0) {
+    // Send the next queued frame right after this packet
+    loadQueuedFrame();
+  } else {
+    // Let any frame processors change the values for the next packet
+    if (!paused_) {
+      int count = frameProcessorCount_;
+      for (int i = 0; i < count; i++) {
+        frameProcessors_[i]->processFrame(
+            const_cast<uint8_t *>(&activeBuf_[0]), activePacketSize_);
+      }
+    }
+
+    // Copy the active buffer into the inactive buffer
+    std::copy_n(&activeBuf_[0], kMaxDMXPacketSize, &inactiveBuf_[0]);
+    inactivePacketSize_ = nextPacketSize();
+    queuedFrameLoaded_ = false;
+    restorePacketTiming();
+  }
 
   incPacketCount();
   inactiveBufIndex_ = 0;
   transmitting_ = false;
   state_ = XmitStates::kIdle;
 
+  // Measure the time spent here; the next BREAK-to-BREAK and MBB times only
+  // make sense if the sender isn't pausing
+  uint32_t d = util::cycleCount() - startCycles;
+  beginTXStatsUpdate();
+  txStats_.lastCompletePacketTimeNs = util::cyclesToNs(d, nsPerCycleQ16_);
+  txStats_.completePacketTime.add(util::cyclesToUs(d, nsPerCycleQ16_));
+  endTXStatsUpdate();
+  txPacketEndCycles_ = startCycles;
+  txStatsContinuous_ = !paused_;
+
   if (paused_) {
     void (*f)(Sender *) = doneTXFunc_;
     if (f != nullptr) {
@@ -738,6 +1310,85 @@ void Sender::completePacket() {
   }
 }
 
+void Sender::loadSIP(uint16_t checksum) {
+  int slots = inactivePacketSize_ - 1;
+  checksum = ~checksum;
+
+  volatile uint8_t *sip = &inactiveBuf_[0];
+  sip[0] = kSIPStartCode;
+  sip[1] = kSIPSize - 1;  // Size, not including the start code
+  sip[2] = sipConfig_.control;
+  sip[3] = static_cast<uint8_t>(checksum >> 8);
+  sip[4] = static_cast<uint8_t>(checksum);
+  sip[5] = sipSequence_++;
+  sip[6] = sipConfig_.universe;
+  sip[7] = sipConfig_.processingLevel;
+  sip[8] = sipConfig_.softwareVersion;
+  sip[9] = static_cast<uint8_t>(slots >> 8);
+  sip[10] = static_cast<uint8_t>(slots);
+  sip[11] = static_cast<uint8_t>(sipPacketCount_ >> 8);
+  sip[12] = static_cast<uint8_t>(sipPacketCount_);
+  for (int i = 0; i < 5; i++) {
+    sip[13 + i*2] = static_cast<uint8_t>(sipConfig_.manufacturerIDs[i] >> 8);
+    sip[14 + i*2] = static_cast<uint8_t>(sipConfig_.manufacturerIDs[i]);
+  }
+  sip[23] = 0;  // Reserved
+
+  // The SIP checksum covers everything before it
+  uint8_t sipChecksum = 0;
+  for (int i = 0; i < kSIPSize - 1; i++) {
+    sipChecksum += sip[i];
+  }
+  sip[kSIPSize - 1] = ~sipChecksum;
+
+  inactivePacketSize_ = kSIPSize;
+  sipPacketCount_ = 0;
+
+  queuedFrameAdjustedMBBTime_ = adjustedMBBTime_;
+  restorePacketTiming();
+  queuedFrameLoaded_ = true;
+}
+
+void Sender::loadQueuedFrame() {
+  const QueuedFrame &f = frameQueue_[frameQueueHead_];
+  std::copy_n(f.data, f.size, &inactiveBuf_[0]);
+  inactivePacketSize_ = f.size;
+
+  if (f.mbbTime == kDefaultTiming) {
+    queuedFrameAdjustedMBBTime_ = adjustedMBBTime_;
+  } else {
+    queuedFrameAdjustedMBBTime_ = adjustMBBTime(f.mbbTime);
+  }
+  if (f.interSlotTime == kDefaultTiming) {
+    restorePacketTiming();
+  } else {
+    setPacketInterSlotTime(f.interSlotTime,
+                           timerCalibration_.interSlotTime.apply(
+                               f.interSlotTime));
+  }
+  queuedFrameLoaded_ = true;
+
+  frameQueueHead_ = (frameQueueHead_ + 1) % kFrameQueueSize;
+  frameQueueCount_ = frameQueueCount_ - 1;
+}
+
+void Sender::restorePacketTiming() {
+  setPacketInterSlotTime(interSlotTime_, adjustedInterSlotTime_);
+}
+
+void Sender::setPacketInterSlotTime(uint32_t t, uint32_t adjusted) {
+  packetInterSlotTime_ = t;
+  packetAdjustedInterSlotTime_ = adjusted;
+
+  packetInterSlotSerial_ = !interSlotUseTimer_ && t != 0;
+  packetInterSlotPadBits_ = 0;
+  packetInterSlotIdleChars_ = 0;
+  if (packetInterSlotSerial_) {
+    serialInterSlot(t, &packetInterSlotPadBits_, &packetInterSlotIdleChars_);
+  }
+  interSlotIdleRemaining_ = 0;
+}
+
 // ---------------------------------------------------------------------------
 //  IRQ management
 // ---------------------------------------------------------------------------
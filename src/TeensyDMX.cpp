@@ -3,6 +3,8 @@
 
 #include "TeensyDMX.h"
 
+#include <util/atomic.h>
+
 namespace qindesign {
 namespace teensydmx {
 
@@ -73,7 +75,41 @@ constexpr int serialIndex(const HardwareSerial &uart) {
 TeensyDMX::TeensyDMX(HardwareSerial &uart)
     : uart_(uart),
       serialIndex_(serialIndex(uart_)),
+      isrProfiler_{},
       packetCount_(0) {}
 
+util::ISRProfiler::Stats TeensyDMX::isrStats() const {
+  util::ISRProfiler::Stats stats;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    stats = isrProfiler_.stats();
+  }
+  return stats;
+}
+
+void TeensyDMX::resetISRStats() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    isrProfiler_.reset();
+  }
+}
+
+int TeensyDMX::readTraceEvents(util::TraceEvent *buf, int count) {
+#ifdef TEENSYDMX_ENABLE_TRACE
+  if (buf == nullptr || count <= 0) {
+    return 0;
+  }
+  return traceBuffer_.read(buf, count);
+#else
+  return 0;
+#endif  // TEENSYDMX_ENABLE_TRACE
+}
+
+uint32_t TeensyDMX::traceDroppedCount() const {
+#ifdef TEENSYDMX_ENABLE_TRACE
+  return traceBuffer_.droppedCount();
+#else
+  return 0;
+#endif  // TEENSYDMX_ENABLE_TRACE
+}
+
 }  // namespace teensydmx
 }  // namespace qindesign
@@ -24,8 +24,10 @@
 #include <cstdint>
 #include <memory>
 
+#include <EventResponder.h>
 #include <HardwareSerial.h>
 
+#include "FrameProcessor.h"
 #include "LPUARTReceiveHandler.h"
 #include "LPUARTSendHandler.h"
 #include "ReceiveHandler.h"
@@ -33,6 +35,13 @@
 #include "SendHandler.h"
 #include "UARTReceiveHandler.h"
 #include "UARTSendHandler.h"
+#include "util/CycleCounter.h"
+#include "util/Histogram.h"
+#include "util/InputCapture.h"
+#include "util/ISRProfiler.h"
+#include "util/RunningStat.h"
+#include "util/TraceBuffer.h"
+#include "util/TXTiming.h"
 #ifndef TEENSYDMX_USE_PERIODICTIMER
 #include "util/IntervalTimerEx.h"
 #else
@@ -59,6 +68,17 @@ constexpr int kMinTXBreakTime = 92;
 // in microseconds.
 constexpr int kMinTXMABTime = 12;
 
+// ISR event tracing is enabled by defining the global TEENSYDMX_ENABLE_TRACE
+// macro when building. When it isn't defined, the trace points compile to
+// nothing and no buffer memory is used.
+//
+// The number of trace events buffered per instance. This must be a power of
+// two. Define the global TEENSYDMX_TRACE_SIZE macro to change it.
+#ifndef TEENSYDMX_TRACE_SIZE
+#define TEENSYDMX_TRACE_SIZE 128
+#endif  // !TEENSYDMX_TRACE_SIZE
+constexpr int kTraceSize = TEENSYDMX_TRACE_SIZE;
+
 // TeensyDMX implements either a receiver or transmitter on one of hardware
 // serial ports 1-6.
 class TeensyDMX {
@@ -80,6 +100,30 @@ class TeensyDMX {
     return serialIndex_ + 1;
   }
 
+  // Reads up to `count` of the oldest ISR trace events into `buf` and removes
+  // them from the trace buffer. This returns the number of events read. This
+  // is meant to be called periodically from the main loop.
+  //
+  // Tracing is only available when the library is built with the
+  // TEENSYDMX_ENABLE_TRACE macro defined; otherwise, this always returns zero.
+  int readTraceEvents(util::TraceEvent *buf, int count);
+
+  // Returns the number of trace events dropped because the trace buffer was
+  // full. This always returns zero if tracing isn't enabled.
+  uint32_t traceDroppedCount() const;
+
+  // Returns the ISR execution time statistics for this instance. This covers
+  // the UART ISR and the timer callbacks. The values are in cycle counter
+  // units; `cyclesPerSecond` in the returned object can be used to convert
+  // them. These are reset when the instance is started or restarted, or by
+  // `resetISRStats()`.
+  //
+  // Please refer to the `util::ISRProfiler::Stats` docs for more information.
+  util::ISRProfiler::Stats isrStats() const;
+
+  // Resets the ISR execution time statistics.
+  void resetISRStats();
+
  protected:
   // Creates a new DMX receiver or transmitter using the given hardware UART.
   // https://github.com/isocpp/CppCoreGuidelines/blob/master/CppCoreGuidelines.md#Rc-explicit
@@ -101,9 +145,22 @@ class TeensyDMX {
     packetCount_ = 0;
   }
 
+  // Records a trace event if tracing is enabled, otherwise does nothing. This
+  // must only be called from this instance's ISRs, all of which need to run at
+  // the same priority.
+  void trace(util::TraceEventType type, int state, int index) {
+#ifdef TEENSYDMX_ENABLE_TRACE
+    traceBuffer_.push(util::cycleCount(), type, static_cast<uint8_t>(state),
+                      static_cast<uint16_t>(index));
+#endif  // TEENSYDMX_ENABLE_TRACE
+  }
+
   HardwareSerial &uart_;
   const int serialIndex_;
 
+  // Measures the ISRs. Subclasses and their handlers manage this.
+  util::ISRProfiler isrProfiler_;
+
  private:
   // Sets up the system for receiving or transmitting DMX on the specified
   // serial port.
@@ -117,6 +174,10 @@ class TeensyDMX {
   // incPacketCount() and resetPacketCount().
   // https://github.com/isocpp/CppCoreGuidelines/blob/master/CppCoreGuidelines.md#Rh-protected
   volatile uint32_t packetCount_;
+
+#ifdef TEENSYDMX_ENABLE_TRACE
+  util::TraceBuffer<kTraceSize> traceBuffer_;
+#endif  // TEENSYDMX_ENABLE_TRACE
 };
 
 // ---------------------------------------------------------------------------
@@ -153,6 +214,13 @@ class Receiver final : public TeensyDMX {
   //   not being monitored.
   // * MAB time: The packet's MAB time. This will be zero if the RX line is not
   //   being monitored.
+  // * High-resolution BREAK, MAB, and BREAK-to-BREAK times: The same as the
+  //   above, but in nanoseconds and measured with the processor's cycle
+  //   counter instead of `micros()`. The BREAK and MAB times are only
+  //   sub-microsecond when their edges are actually seen, i.e. when the RX line
+  //   is being monitored; inferred values have the same resolution as their
+  //   microsecond counterparts. On the Teensy LC, which has no cycle counter,
+  //   these all have microsecond resolution.
   class PacketStats final {
    public:
     // Initializes everything to zero.
@@ -166,10 +234,15 @@ class Receiver final : public TeensyDMX {
           packetTime(0),
           breakTime(0),
           mabTime(0),
+          breakToBreakTimeNs(0),
+          breakTimeNs(0),
+          mabTimeNs(0),
           extraSize(0),
           nextBreakPlusMABTime(0),
           nextBreakTime(0),
-          nextMABTime(0) {}
+          nextMABTime(0),
+          nextBreakTimeNs(0),
+          nextMABTimeNs(0) {}
 
     ~PacketStats() = default;
 
@@ -193,6 +266,11 @@ class Receiver final : public TeensyDMX {
     uint32_t breakTime;  // BREAK time, in microseconds
     uint32_t mabTime;    // MAB time, in microseconds
 
+    // High-resolution times, from the cycle counter
+    uint32_t breakToBreakTimeNs;  // Time between BREAKs, in nanoseconds
+    uint32_t breakTimeNs;         // BREAK time, in nanoseconds
+    uint32_t mabTimeNs;           // MAB time, in nanoseconds
+
    private:
     // An accumulator for extra bytes beyond the max. packet length.
     // This is private for now because the value may not be in sync
@@ -208,6 +286,8 @@ class Receiver final : public TeensyDMX {
     uint32_t nextBreakPlusMABTime;
     uint32_t nextBreakTime;
     uint32_t nextMABTime;
+    uint32_t nextBreakTimeNs;
+    uint32_t nextMABTimeNs;
 
     friend class Receiver;
   };
@@ -243,12 +323,81 @@ class Receiver final : public TeensyDMX {
     uint32_t longPacketCount;
   };
 
+  // System Information Packet (SIP) verification counts. See `setSIPVerify`.
+  //
+  // Notes on the variables:
+  // * SIP count: Total number of SIPs received.
+  // * Bad SIP count: SIPs with an invalid size or SIP checksum.
+  // * Verified count: NULL start code packets whose checksum matched the SIP
+  //   that followed.
+  // * Mismatch count: NULL start code packets whose checksum didn't match the
+  //   SIP that followed.
+  // * Unverified count: NULL start code packets that weren't followed by
+  //   a valid SIP.
+  class SIPStats final {
+   public:
+    // Initializes everything to zero.
+    constexpr SIPStats()
+        : sipCount(0),
+          badSIPCount(0),
+          verifiedCount(0),
+          mismatchCount(0),
+          unverifiedCount(0) {}
+
+    ~SIPStats() = default;
+
+    // Support common use of this object
+    SIPStats(const SIPStats &) = default;
+    SIPStats(SIPStats &&) = default;
+    SIPStats &operator=(const SIPStats &) = default;
+    SIPStats &operator=(SIPStats &&) = default;
+
+    uint32_t sipCount;
+    uint32_t badSIPCount;
+    uint32_t verifiedCount;
+    uint32_t mismatchCount;
+    uint32_t unverifiedCount;
+  };
+
+  // Running timing statistics, accumulated over every completed packet since
+  // the receiver was started or the statistics were reset. Each metric tracks
+  // the count, min, max, mean, and standard deviation of its values, all in
+  // microseconds.
+  //
+  // Notes on the variables:
+  // * BREAK time and MAB time: These are only accumulated when they're known,
+  //   i.e. when the RX line is being monitored.
+  // * BREAK-to-BREAK time: This is only accumulated when there was a
+  //   previous packet.
+  // * Packet time: The time from the BREAK start to the last slot end.
+  class TimingStats final {
+   public:
+    constexpr TimingStats() = default;
+
+    ~TimingStats() = default;
+
+    // Support common use of this object
+    TimingStats(const TimingStats &) = default;
+    TimingStats(TimingStats &&) = default;
+    TimingStats &operator=(const TimingStats &) = default;
+    TimingStats &operator=(TimingStats &&) = default;
+
+    util::RunningStat breakTime;
+    util::RunningStat mabTime;
+    util::RunningStat breakToBreakTime;
+    util::RunningStat packetTime;
+  };
+
   // Creates a new receiver and uses the given UART for communication.
   explicit Receiver(HardwareSerial &uart);
 
-  // Receiver is movable
-  Receiver(Receiver &&) = default;
-  Receiver &operator=(Receiver &&) = default;
+  // Receiver is movable. Moving a receiver first stops it, so `begin()` needs
+  // to be called on the new one. A packet-ready function moves with it.
+  //
+  // Move assignment isn't supported because a receiver is tied to its
+  // serial port.
+  Receiver(Receiver &&other);
+  Receiver &operator=(Receiver &&) = delete;
 
   // Destructs Receiver. This calls `end()`.
   ~Receiver();
@@ -341,6 +490,43 @@ class Receiver final : public TeensyDMX {
   // been stopped.
   uint16_t get16Bit(int channel, bool *rangeError = nullptr) const;
 
+  // Sets whether to verify NULL start code packets against the System
+  // Information Packets (SIP) that follow them. When enabled, the ISR
+  // accumulates each packet's 16-bit checksum as its slots are received, and
+  // when a valid SIP immediately follows a NULL start code packet, compares
+  // the SIP's checksum with the packet's. Matching packets are made available
+  // to `readVerifiedPacket`.
+  //
+  // Verified packets aren't copied. Instead, a third packet buffer takes turns
+  // with the two receive buffers. It's allocated the first time this is
+  // enabled and kept until the receiver is destroyed. This returns `false` if
+  // the allocation fails, and `true` otherwise.
+  //
+  // Regular packet reading is unaffected. The default is disabled.
+  bool setSIPVerify(bool flag);
+
+  // Returns whether SIP verification is enabled.
+  bool isSIPVerify() const {
+    return sipVerify_;
+  }
+
+  // Reads the latest verified NULL start code packet, in the same way as
+  // `readPacket`. A packet is only available after the SIP that follows it
+  // has been received and its checksum matched. This returns -1 if there's no
+  // new verified packet; each packet can only be read once.
+  //
+  // See `setSIPVerify`.
+  int readVerifiedPacket(uint8_t *buf, int startChannel, int len);
+
+  // Returns the SIP verification counts. These are reset when the receiver is
+  // started or restarted, or by `resetSIPStats()`.
+  //
+  // Please refer to the `SIPStats` docs for more information.
+  SIPStats sipStats() const;
+
+  // Resets the SIP verification counts.
+  void resetSIPStats();
+
   // Returns the latest packet statistics. These are reset when the receiver is
   // started or restarted.
   //
@@ -377,12 +563,12 @@ class Receiver final : public TeensyDMX {
   // pointer, so callers should take care to not free the object before this
   // Receiver is freed or the responder for the start code is set to `nullptr`.
   //
-  // This will replace any responder having the same start code and returns
-  // the replaced pointer. Note that this will return `nullptr` if no responder
-  // was replaced.
+  // This will replace the whole responder chain having the same start code and
+  // returns the first responder in the replaced chain. Note that this will
+  // return `nullptr` if no responder was replaced.
   //
-  // Setting the responder for a start code to `nullptr` will remove any
-  // previously-set responder for that start code.
+  // Setting the responder for a start code to `nullptr` will remove all
+  // previously-set responders for that start code.
   //
   // This function dynamically allocates memory. On small systems, the memory
   // may not be available, so it is possible that this will silently fail. To
@@ -394,6 +580,27 @@ class Receiver final : public TeensyDMX {
   // Responder functions are called from an ISR.
   Responder *setResponder(uint8_t startCode, Responder *r);
 
+  // Adds a responder to the end of the chain for the supplied start code. Like
+  // `setResponder`, this holds on to the pointer.
+  //
+  // Each responder in a chain sees every `processByte` and `receivePacket`
+  // call, in the order they were added. Only one responder may claim the
+  // response: the first one whose `processByte` returns a positive value. The
+  // packet is completed at that point, so responders after it in the chain
+  // won't see that final byte, but they will all still see the packet via
+  // `receivePacket`. The packet is eaten if any responder in the chain
+  // eats it.
+  //
+  // This returns `false` if the responder is `nullptr` or if memory could not
+  // be allocated, and `true` otherwise. Adding a responder that's already in
+  // the chain does nothing and returns `true`. See `setResponder` for notes on
+  // memory allocation failures.
+  bool addResponder(uint8_t startCode, Responder *r);
+
+  // Removes a responder from the chain for the supplied start code. This
+  // returns whether the responder was found and removed.
+  bool removeResponder(uint8_t startCode, Responder *r);
+
   // Sets the `setTXNotRX` implementation function. This should be called before
   // calling `begin()`.
   //
@@ -405,6 +612,8 @@ class Receiver final : public TeensyDMX {
   // Sets the pin that monitors the RX line to determine BREAK and MAB timing.
   // Set to a negative value to unset. The default is unset.
   //
+  // Setting a pin here unsets any capture pin set with `setRXCapturePin`.
+  //
   // Don't forget to configure the pin as an input.
   void setRXWatchPin(int pin);
 
@@ -413,6 +622,27 @@ class Receiver final : public TeensyDMX {
     return rxWatchPin_;
   }
 
+  // Sets a pin that monitors the RX line using a hardware timer input-capture
+  // channel instead of pin interrupts. This is an alternative to
+  // `setRXWatchPin`: the BREAK end and MAB end edges are timestamped by the
+  // timer, and the captured values are read from the UART ISR, so there are no
+  // extra interrupts and no interrupt latency in the BREAK and MAB times. Set to
+  // a negative value to unset. The default is unset.
+  //
+  // This returns whether the pin could be used. The Teensy 3.0-3.6 are
+  // supported on pins 3, 6, 9, 21, and 22, and the Teensy 4.x on pins 10, 11,
+  // and 12. On the Teensy 3.x, the pin's whole FlexTimer is taken over, so PWM
+  // won't work on any pins sharing that timer until the capture pin is unset.
+  // See `util::InputCapture` for more information.
+  //
+  // Setting a pin here unsets any pin set with `setRXWatchPin`.
+  bool setRXCapturePin(int pin);
+
+  // Returns the RX capture pin. This will return a negative value if unset.
+  int rxCapturePin() const {
+    return rxCapture_.pin();
+  }
+
   // Returns whether this is considered to be connected to a DMX transmitter. A
   // connection is considered to have been broken if a timeout was detected or a
   // BREAK plus MARK after BREAK (MAB) was too short.
@@ -430,12 +660,111 @@ class Receiver final : public TeensyDMX {
     connectChangeFunc_ = f;
   }
 
+  // Sets the function to call when a new packet is available. This can be
+  // used instead of polling `readPacket`. The function takes one argument, a
+  // pointer to this Receiver instance.
+  //
+  // Unlike the other callbacks, this is not called from the UART ISR. The
+  // packet completion posts an event to a low-priority software interrupt
+  // (PendSV, via `EventResponder`), and the function is called from there as
+  // soon as no higher-priority interrupts are pending. This means other
+  // universes and timing-critical code aren't held up by the work done here,
+  // and the latency is bounded by the higher-priority interrupt load and not
+  // by how long `loop()` takes.
+  //
+  // If more than one packet completes before the function gets to run, it's
+  // only called once; `readPacket` always returns the latest packet. Packets
+  // eaten by a responder don't cause a call. The number of coalesced calls
+  // can be retrieved with `packetReadyMissedCount()`.
+  //
+  // This must not be called from an ISR. Setting the function to `nullptr`
+  // disables the event.
+  void onPacketReady(void (*f)(Receiver *r));
+
+  // Returns the number of packet-ready events that were coalesced because the
+  // previous event hadn't been handled yet. This is reset when the receiver is
+  // started or restarted.
+  uint32_t packetReadyMissedCount() const {
+    return packetReadyMissedCount_;
+  }
+
   // Returns the latest error statistics. These are reset when the receiver is
   // started or restarted.
   //
   // Please refer to the `ErrorStats` docs for more information.
   ErrorStats errorStats() const;
 
+  // Returns a snapshot of the running timing statistics. These are reset when
+  // the receiver is started or restarted, or by `resetTimingStats()`.
+  //
+  // Please refer to the `TimingStats` docs for more information.
+  TimingStats timingStats() const;
+
+  // Resets the running timing statistics.
+  void resetTimingStats();
+
+  // Configures the BREAK-to-BREAK time histogram and clears its counts. Bucket
+  // `i` counts times, in microseconds, in the range
+  // [minTime + i*bucketWidth, minTime + (i+1)*bucketWidth). There can be up to
+  // `util::Histogram::kMaxBuckets` buckets; setting the count to zero disables
+  // the histogram. It's disabled by default.
+  //
+  // For example, `setBreakToBreakHistogram(0, 1000, 64)` covers times up to
+  // 64ms in 1ms steps.
+  //
+  // The histogram is filled from the ISR every time a packet completes after a
+  // previous packet. It uses no dynamic memory and the cost per packet is
+  // constant, so it can be kept enabled.
+  void setBreakToBreakHistogram(uint32_t minTime, uint32_t bucketWidth,
+                                int bucketCount);
+
+  // Returns a snapshot of the BREAK-to-BREAK time histogram. Use it for
+  // distribution queries such as `percentile()` and `spread()`, the latter
+  // being a measure of jitter.
+  util::Histogram breakToBreakHistogram() const;
+
+  // Clears the BREAK-to-BREAK histogram counts, keeping its configuration. The
+  // counts are also cleared when the receiver is started or restarted.
+  void resetBreakToBreakHistogram();
+
+  // Estimates the refresh rate, in packets per second, from the median of the
+  // BREAK-to-BREAK histogram. This returns zero if the histogram is disabled
+  // or empty. Unlike a simple average, this isn't skewed by the occasional
+  // stall or burst.
+  float refreshRateEstimate() const;
+
+  // Receiver state machine invariants. These are checked after every receive
+  // event when the library is built with the TEENSYDMX_CHECK_INVARIANTS
+  // macro defined.
+  enum class Invariant : uint8_t {
+    kNone,
+    kBufIndex,         // The active buffer index is outside [0, 513]
+    kPacketSize,       // The packet size is outside [0, 513]
+    kBuffers,          // The active and inactive buffers aren't distinct
+    kConnectCause,     // Connected somewhere other than after a valid BREAK
+    kDisconnectCause,  // Disconnected without first ending the packet
+  };
+
+  // Returns the number of invariant violations seen since the receiver was
+  // started. This always returns zero if invariant checking isn't enabled.
+  uint32_t invariantViolationCount() const {
+#ifdef TEENSYDMX_CHECK_INVARIANTS
+    return invariantViolationCount_;
+#else
+    return 0;
+#endif  // TEENSYDMX_CHECK_INVARIANTS
+  }
+
+  // Returns the most recent invariant violation, or `Invariant::kNone` if there
+  // haven't been any or if invariant checking isn't enabled.
+  Invariant lastInvariantViolation() const {
+#ifdef TEENSYDMX_CHECK_INVARIANTS
+    return lastInvariantViolation_;
+#else
+    return Invariant::kNone;
+#endif  // TEENSYDMX_CHECK_INVARIANTS
+  }
+
  private:
   // State that tracks where we are in the receive process.
   enum class RecvStates {
@@ -461,6 +790,21 @@ class Receiver final : public TeensyDMX {
     const Receiver &r_;
   };
 
+  // Checks the state machine invariants when it goes out of scope, if checking
+  // is enabled. Each receive event entry point creates one of these first, so
+  // that the checks run no matter which path returns.
+  class InvariantCheck final {
+   public:
+    explicit InvariantCheck(Receiver &r) : r_(r) {}
+
+    ~InvariantCheck() {
+      r_.checkInvariants();
+    }
+
+   private:
+    Receiver &r_;
+  };
+
   // The maximum allowed packet time for receivers, both BREAK plus data and
   // BREAK to BREAK, in microseconds.
   static constexpr uint32_t kMaxDMXPacketTime = 1250000;
@@ -483,6 +827,46 @@ class Receiver final : public TeensyDMX {
   // This may be called from an ISR.
   void setConnected(bool flag);
 
+  // Checks the state machine invariants if the TEENSYDMX_CHECK_INVARIANTS macro
+  // is defined, otherwise does nothing. This is called from the ISRs.
+  void checkInvariants() {
+#ifdef TEENSYDMX_CHECK_INVARIANTS
+    if (activeBufIndex_ < 0 || kMaxDMXPacketSize < activeBufIndex_) {
+      invariantViolated(Invariant::kBufIndex);
+    }
+    if (packetSize_ < 0 || kMaxDMXPacketSize < packetSize_ ||
+        packetStats_.size < 0 || kMaxDMXPacketSize < packetStats_.size) {
+      invariantViolated(Invariant::kPacketSize);
+    }
+    if (activeBuf_ == inactiveBuf_ || !isPacketBuffer(activeBuf_) ||
+        !isPacketBuffer(inactiveBuf_)) {
+      invariantViolated(Invariant::kBuffers);
+    }
+#endif  // TEENSYDMX_CHECK_INVARIANTS
+  }
+
+  // Returns whether the given buffer is one of the packet buffers.
+  bool isPacketBuffer(const uint8_t *buf) const {
+    return buf == buf1_ || buf == buf2_ ||
+           (buf != nullptr && buf == sipBuf_.get());
+  }
+
+  // Records an invariant violation.
+  void invariantViolated(Invariant inv) {
+#ifdef TEENSYDMX_CHECK_INVARIANTS
+    invariantViolationCount_ = invariantViolationCount_ + 1;
+    lastInvariantViolation_ = inv;
+#endif  // TEENSYDMX_CHECK_INVARIANTS
+  }
+
+  // Posts the packet-ready event, if a function is set. This is called from
+  // `completePacket`.
+  void postPacketReady();
+
+  // Handles the packet-ready event at low priority. The event context is the
+  // Receiver instance.
+  static void packetReadyHandler(EventResponderRef ev);
+
   // Does these things
   // 1. If there's data:
   //    1. Makes a new packet available and sets the packet stats, and
@@ -495,12 +879,15 @@ class Receiver final : public TeensyDMX {
   void idleTimerCallback();
 
   // Look for potential packet timeouts when an IDLE condition was detected.
+  // The `eventCycles` parameter is the cycle counter value at the same point as
+  // `eventTime`.
   // This is called from an ISR.
-  void receiveIdle(uint32_t eventTime);
+  void receiveIdle(uint32_t eventTime, uint32_t eventCycles);
 
-  // A potential BREAK has just been received.
+  // A potential BREAK has just been received. The `eventCycles` parameter is
+  // the cycle counter value at the same point as `eventTime`.
   // This is called from an ISR.
-  void receivePotentialBreak(uint32_t eventTime);
+  void receivePotentialBreak(uint32_t eventTime, uint32_t eventCycles);
 
   // An invalid start-of-BREAK was received or there were too few stop bits.
   // There were non-zero bytes in the framing error.
@@ -512,6 +899,36 @@ class Receiver final : public TeensyDMX {
   // This is called from an ISR.
   void receiveByte(uint8_t b, uint32_t eopTime);
 
+  // Checks the packet being completed, in the active buffer, against the SIP
+  // verification state. If it's a valid SIP whose checksum matches the
+  // previous packet, this returns the size of that packet, and otherwise this
+  // returns zero. This also updates the SIP stats.
+  // This is called from an ISR.
+  int verifySIP();
+
+  // Appends a responder to the chain for the given start code, allocating any
+  // needed memory. If the allocation fails then all responders are wiped out
+  // and this returns `false`. This must be called with the lock held.
+  bool insertResponder(uint8_t startCode, Responder *r);
+
+  // Removes the chain entries in the range [first, last) belonging to the given
+  // start code. This does not free any memory. This must be called with the
+  // lock held.
+  void eraseResponders(uint8_t startCode, int first, int last);
+
+  // Frees all responder memory if there are no more responders. This must be
+  // called with the lock held.
+  void releaseRespondersIfEmpty();
+
+  // Wipes out all responders and frees all responder memory. This must be
+  // called with the lock held.
+  void clearResponders();
+
+  // Reads any edges captured by the RX capture pin and updates the MAB
+  // start and end times as if they were seen by the RX watch pin ISRs.
+  // This is called from an ISR.
+  void pollRXCapture();
+
   // ISR functions.
   void rxPinFell_isr();
   void rxPinRose_isr();
@@ -552,6 +969,10 @@ class Receiver final : public TeensyDMX {
   const uint8_t *volatile inactiveBuf_;
   int activeBufIndex_;
 
+  // The 16-bit additive checksum of the slots received so far in the
+  // active buffer.
+  uint16_t rxChecksum_;
+
   // The size of the last received packet. This will be set to zero when
   // `readPacket` reads data. The last packet size does not get set to zero when
   // packet data is read.
@@ -567,6 +988,14 @@ class Receiver final : public TeensyDMX {
   uint32_t lastBreakStartTime_;
   uint32_t breakStartTime_;
 
+  // The same as the BREAK start times, but in cycle counter units. The
+  // conversion values are set when the receiver is started: the character time
+  // in cycles, and the nanoseconds per cycle as a 16.16 fixed-point value.
+  uint32_t lastBreakStartCycles_;
+  uint32_t breakStartCycles_;
+  uint32_t charTimeCycles_;
+  uint32_t nsPerCycleQ16_;
+
   // Last time a slot ended, in microseconds.
   uint32_t lastSlotEndTime_;
 
@@ -579,12 +1008,46 @@ class Receiver final : public TeensyDMX {
   // This is called when the connection state changes.
   void (*volatile connectChangeFunc_)(Receiver *r);
 
+  // Packet-ready event, processed at low priority.
+  EventResponder packetReadyEvent_;
+  void (*volatile packetReadyFunc_)(Receiver *r);
+  volatile bool packetReadyPending_;
+  volatile uint32_t packetReadyMissedCount_;
+
   // Error stats.
   ErrorStats errorStats_;
 
+  // SIP verification. The verified buffer holds the latest verified packet; it
+  // trades places with the receive buffers instead of being copied into. The
+  // candidate is the previous packet, if it had a NULL start code, awaiting
+  // a SIP.
+  volatile bool sipVerify_;
+  std::unique_ptr<uint8_t[]> sipBuf_;
+  uint8_t *verifiedBuf_;
+  volatile int verifiedPacketSize_;  // Set to zero when read
+  int sipCandidateSize_;
+  uint16_t sipCandidateChecksum_;
+  SIPStats sipStats_;
+
+#ifdef TEENSYDMX_CHECK_INVARIANTS
+  // Invariant violations.
+  volatile uint32_t invariantViolationCount_ = 0;
+  volatile Invariant lastInvariantViolation_ = Invariant::kNone;
+#endif  // TEENSYDMX_CHECK_INVARIANTS
+
+  // Running timing stats.
+  TimingStats timingStats_;
+  util::Histogram breakToBreakHistogram_;
+
   // Responders state
+  // All responders are kept in one flat array, grouped by start code and in the
+  // order they were added. The chain for start code `sc` occupies the indices
+  // [responderStarts_[sc], responderStarts_[sc + 1]), so dispatch is a simple
+  // array walk.
   std::unique_ptr<Responder *[]> responders_;
+  std::unique_ptr<uint16_t[]> responderStarts_;  // 257 entries
   int responderCount_;
+  int responderCapacity_;
   std::unique_ptr<uint8_t[]> responderOutBuf_;
   int responderOutBufLen_;
 
@@ -602,6 +1065,18 @@ class Receiver final : public TeensyDMX {
   volatile bool seenMABEnd_;
   uint32_t mabStartTime_;       // When we've seen the pin rise
   uint32_t mabEndTime_;         // When we've seen the pin fall
+  uint32_t mabStartCycles_;     // The same, but in cycle counter units
+  uint32_t mabEndCycles_;
+
+  // Hardware RX line capture, an alternative to the RX watch pin. Captured
+  // ticks are related to the cycle counter via the counter value when the
+  // capture was armed. The conversion values are set when the pin is set: the
+  // cycles per tick as a 16.16 fixed-point value, and the capture period in
+  // cycles.
+  util::InputCapture rxCapture_;
+  uint32_t rxCaptureArmCycles_;
+  uint32_t cyclesPerTickQ16_;
+  uint32_t capturePeriodCycles_;
 
   // Timer for tracking IDLE timeouts and for timing sending a responder BREAK.
 #ifndef TEENSYDMX_USE_PERIODICTIMER
@@ -707,6 +1182,159 @@ class Receiver final : public TeensyDMX {
 // A DMX transmitter. This sends packets asynchronously.
 class Sender final : public TeensyDMX {
  public:
+  // External trigger statistics. See `setExternalTrigger`.
+  //
+  // Notes on the variables:
+  // * Trigger count: Total number of calls to `triggerFrame()` while external
+  //   triggering is enabled.
+  // * Missed count: Number of triggers that didn't start a packet because the
+  //   previous packet was still being sent.
+  // * Last latency: The time from the most recent trigger that started
+  //   a packet to the start of that packet's BREAK, in nanoseconds. This
+  //   includes the phase offset.
+  // * Latency: Running statistics of all the latencies, in microseconds. The
+  //   spread between the minimum and maximum is the trigger jitter.
+  //
+  // The latencies are measured with the processor's cycle counter. On the
+  // Teensy LC, which has no cycle counter, they have microsecond resolution.
+  class TriggerStats final {
+   public:
+    // Initializes everything to zero.
+    constexpr TriggerStats()
+        : triggerCount(0),
+          missedCount(0),
+          lastLatencyNs(0),
+          latency{} {}
+
+    ~TriggerStats() = default;
+
+    // Support common use of this object
+    TriggerStats(const TriggerStats &) = default;
+    TriggerStats(TriggerStats &&) = default;
+    TriggerStats &operator=(const TriggerStats &) = default;
+    TriggerStats &operator=(TriggerStats &&) = default;
+
+    uint32_t triggerCount;
+    uint32_t missedCount;
+    uint32_t lastLatencyNs;
+    util::RunningStat latency;  // In microseconds
+  };
+
+  // Transmit statistics, for monitoring the output. The "last" values are from
+  // the most recent packet, in nanoseconds, and the running statistics
+  // accumulate all the packets since the stats were reset, in microseconds, the
+  // same as the receiver's `TimingStats`. The times are:
+  // * BREAK-to-BREAK: from one BREAK start to the next.
+  // * BREAK and MAB: only for timer-generated BREAKs, measured from the timer
+  //   events that start and end each one.
+  // * MBB: from the end of a packet's last slot to the next BREAK start.
+  // * completePacket: the ISR time spent finishing a packet and preparing the
+  //   next one, including any frame processors.
+  //
+  // The BREAK-to-BREAK and MBB times aren't measured across a pause.
+  //
+  // The times are measured with the processor's cycle counter. On the Teensy
+  // LC, which has no cycle counter, they have microsecond resolution.
+  class TXStats final {
+   public:
+    // Initializes everything to zero.
+    constexpr TXStats()
+        : frameCount(0),
+          missedFrameCount(0),
+          timerFailCount(0),
+          lastBreakToBreakTimeNs(0),
+          lastBreakTimeNs(0),
+          lastMABTimeNs(0),
+          lastMBBTimeNs(0),
+          lastCompletePacketTimeNs(0),
+          breakToBreakTime{},
+          breakTime{},
+          mabTime{},
+          mbbTime{},
+          completePacketTime{},
+          isPartial(false) {}
+
+    ~TXStats() = default;
+
+    // Support common use of this object
+    TXStats(const TXStats &) = default;
+    TXStats(TXStats &&) = default;
+    TXStats &operator=(const TXStats &) = default;
+    TXStats &operator=(TXStats &&) = default;
+
+    // Returns the achieved refresh rate, in Hz, from the mean BREAK-to-BREAK
+    // time, or zero if it hasn't been measured.
+    float refreshRate() const {
+      float t = breakToBreakTime.mean();
+      return (t > 0.0f) ? 1.0e6f / t : 0.0f;
+    }
+
+    uint32_t frameCount;        // BREAKs started
+    uint32_t missedFrameCount;  // Refresh rate periods skipped after falling
+                                // behind the schedule
+    uint32_t timerFailCount;    // Timer starts that failed, where the sender
+                                // fell back to no timer
+
+    uint32_t lastBreakToBreakTimeNs;
+    uint32_t lastBreakTimeNs;
+    uint32_t lastMABTimeNs;
+    uint32_t lastMBBTimeNs;
+    uint32_t lastCompletePacketTimeNs;
+
+    // In microseconds
+    util::RunningStat breakToBreakTime;
+    util::RunningStat breakTime;
+    util::RunningStat mabTime;
+    util::RunningStat mbbTime;
+    util::RunningStat completePacketTime;
+
+    bool isPartial;  // Indicates whether the snapshot may have been copied in
+                     // the middle of an update; see `Sender::txStats()`
+  };
+
+  // The maximum number of frame processors. See `addFrameProcessor`.
+  static constexpr int kMaxFrameProcessors = 4;
+
+  // The maximum number of frames in the frame queue. See `queueFrame`.
+  static constexpr int kFrameQueueSize = 4;
+
+  // Indicates that a queued frame uses the sender's own timing setting.
+  static constexpr uint32_t kDefaultTiming = UINT32_MAX;
+
+  // The System Information Packet (SIP) start code.
+  static constexpr uint8_t kSIPStartCode = 0xcf;
+
+  // The size of a SIP, including the start code.
+  static constexpr int kSIPSize = 25;
+
+  // The fields of automatically generated SIPs that aren't computed by the
+  // sender. See `setAutoSIP`.
+  struct SIPConfig final {
+    uint8_t control = 0;            // Control bit field
+    uint8_t universe = 1;           // DMX universe
+    uint8_t processingLevel = 0;    // DMX processing level
+    uint8_t softwareVersion = 0;
+    uint16_t manufacturerIDs[5]{0};
+  };
+
+  // A linear correction from a requested time to the timer value that produces
+  // it: the timer value is (t - offset)*gain, or zero if that's negative. The
+  // offset, in microseconds, and the gain are both 16.16 fixed-point.
+  struct TimerCorrection final {
+    int32_t offset = 0;
+    uint32_t gain = uint32_t{1} << 16;
+
+    // Returns the timer value for the requested time, in microseconds.
+    uint32_t apply(uint32_t t) const;
+  };
+
+  // Corrections for the times produced by a timer. See `setTimerCalibration`.
+  struct TimerCalibration final {
+    TimerCorrection breakTime;
+    TimerCorrection mabTime;
+    TimerCorrection interSlotTime;
+  };
+
   // Creates a new transmitter and uses the given UART for communication.
   explicit Sender(HardwareSerial &uart);
 
@@ -825,6 +1453,49 @@ class Sender final : public TeensyDMX {
   // The default is zero.
   void setInterSlotTime(uint32_t t);
 
+  // Sets whether to use a timer or the UART to achieve the inter-slot MARK
+  // time. A timer needs two interrupts per slot. The UART can instead pad each
+  // slot with extra MARK bits and queue idle characters behind it, keeping the
+  // FIFO in use, but the time is rounded up to what the UART can produce. This
+  // takes effect at the next packet.
+  //
+  // This setting only applies on the Teensy 4. The Teensy 3 and LC UARTs
+  // always use a timer for a non-zero inter-slot time, whatever the setting,
+  // and `timing()` models that. `isInterSlotUseTimer()` still returns what was
+  // set.
+  //
+  // The default is to use a timer.
+  void setInterSlotUseTimer(bool flag) {
+    interSlotUseTimer_ = flag;
+  }
+
+  // Returns whether a timer or the UART is being used to achieve the
+  // inter-slot MARK time.
+  bool isInterSlotUseTimer() const {
+    return interSlotUseTimer_;
+  }
+
+  // Returns the built-in timer corrections for this processor. These were
+  // measured at 180us BREAK, 20us MAB, and 40us inter-slot times, at the
+  // default CPU speed.
+  static TimerCalibration defaultTimerCalibration();
+
+  // Sets the corrections that turn the requested BREAK, MAB, and inter-slot
+  // times into timer values, and applies them to the current times. Other CPU
+  // speeds or other timer setups may need different corrections than the
+  // built-in ones; `TimingCalibrator` measures them. Since they don't change
+  // for a given setup, they can be stored, for example in EEPROM, and set
+  // again at startup.
+  //
+  // The BREAK correction isn't used when `TEENSYDMX_USE_PERIODICTIMER` is
+  // defined because that timer starts the BREAK itself.
+  //
+  // The default is `defaultTimerCalibration()`.
+  void setTimerCalibration(const TimerCalibration &cal);
+
+  // Returns the current timer corrections.
+  TimerCalibration timerCalibration() const;
+
   // Returns the inter-slot MARK time, in microseconds.  The actual time will
   // likely be larger than the return value due to some UART intricacies.
   uint32_t interSlotTime() const;
@@ -863,6 +1534,33 @@ class Sender final : public TeensyDMX {
     return activePacketSize_;
   }
 
+  // Sets whether to automatically trim trailing zero slots from transmitted
+  // packets. When enabled, each packet is only sent up to the highest slot
+  // that has ever held a non-zero value, but at least `kMinDMXPacketSize`
+  // slots and at most `packetSize()` slots. Shorter packets take less time to
+  // send, so the refresh rate rises automatically; for example, 150 slots can
+  // be sent at about 150Hz.
+  //
+  // The trimmed size never shrinks on its own. If it did, a slot going back to
+  // zero wouldn't be sent at all, and many receivers would keep showing its old
+  // value. Calling this function again, with either value, starts tracking from
+  // the beginning, for example after intentionally clearing all the channels.
+  //
+  // The default is disabled.
+  void setAutoPacketSize(bool flag);
+
+  // Returns whether packets are being automatically trimmed. See
+  // `setAutoPacketSize`.
+  bool isAutoPacketSize() const {
+    return autoPacketSize_;
+  }
+
+  // Returns the size of the packet currently being sent, or last sent. This
+  // only differs from `packetSize()` when automatic trimming is enabled.
+  int transmitPacketSize() const {
+    return inactivePacketSize_;
+  }
+
   // Sets a channel's value. Channel zero represents the start code. The start
   // code should really be zero, but it can be changed here. This also affects
   // the packet currently being transmitted.
@@ -937,6 +1635,21 @@ class Sender final : public TeensyDMX {
   // upper limit is equal to `kDMXMaxPacketSize-1`.
   bool fill(int startChannel, int len, uint8_t value);
 
+  // Adds a processor that changes the channel values at each frame boundary,
+  // for example a `FadeEngine`. Processors are called from the ISR, in the
+  // order they were added, after each packet is sent and before the values for
+  // the next packet are captured. Values they write stick, as if they were set
+  // with `set`. Processors aren't called while paused.
+  //
+  // This returns `false` if the processor is NULL or if there are already
+  // `kMaxFrameProcessors` processors. Otherwise, this returns `true`, including
+  // if the processor was already added.
+  bool addFrameProcessor(FrameProcessor *p);
+
+  // Removes a frame processor. This returns whether it was found. After this
+  // returns, the processor won't be called again.
+  bool removeFrameProcessor(FrameProcessor *p);
+
   // Sets the MBB time, in microseconds. If a timer is unavailable then no MBB
   // delay will be applied. Note that there will always be some minimum
   // transmitted MBB due to how the code and UART interact.
@@ -983,6 +1696,12 @@ class Sender final : public TeensyDMX {
   // rate, then the larger of the two possible MBB times will be used to achieve
   // either the specified rate or the specified MBB. See `setMBBTime` for
   // more information.
+  //
+  // BREAKs are scheduled against an absolute timeline with a fractional
+  // microsecond period, so non-integer periods aren't truncated and interrupt
+  // latency doesn't accumulate; the long-term rate matches the requested rate.
+  // If a packet runs late by more than one period, for example after a pause or
+  // if the rate isn't achievable, the schedule restarts from that packet.
   bool setRefreshRate(float rate);
 
   // Returns the packet refresh rate. The default is INFINITY, indicating
@@ -991,6 +1710,16 @@ class Sender final : public TeensyDMX {
     return refreshRate_;
   }
 
+  // Returns the current timing settings: BREAK, MAB, inter-slot MARK, and MBB
+  // times, packet size, and refresh rate. The returned object models the
+  // resulting packet and BREAK-to-BREAK times and frame rate, and can check the
+  // settings against the ANSI E1.11 transmitter limits with `violations()`.
+  // When the UART makes the inter-slot MARK time, this returns the time the UART
+  // actually produces, rounded up from the setting.
+  //
+  // Please refer to the `util::TXTiming` docs for more information.
+  util::TXTiming timing() const;
+
   // Pauses the ansynchronous packet sending. This allows information to be
   // inserted at a specific point. The pause actually occurs after finishing
   // transmission of the current packet.
@@ -1080,6 +1809,135 @@ class Sender final : public TeensyDMX {
     doneTXFunc_ = f;
   }
 
+  // Queues a pre-built frame to be sent immediately after the packet in
+  // progress, without a round trip through the main loop. This guarantees that,
+  // for example, a System Information Packet (SIP) or test packet is adjacent
+  // to the packet it follows. Queued frames are sent back-to-back, in order,
+  // each separated from the previous packet by only the MBB time, and ahead of
+  // any refresh rate schedule or external trigger. Regular packets resume when
+  // the queue is empty.
+  //
+  // The frame is `size` bytes of `data`, including the start code in
+  // `data[0]`, so `size` must be in the range 1-513. The MBB time before the
+  // frame and the inter-slot MARK time within it can be overridden; use
+  // `kDefaultTiming` to keep the sender's settings.
+  //
+  // The data isn't copied here; it's copied when the frame is loaded for
+  // transmission, after which it may be changed. `queuedFrameCount()` reports
+  // how many frames haven't yet been loaded. Frame processors aren't applied to
+  // queued frames, and queued frames count as packets for `resumeFor`. Frames
+  // aren't sent while paused or while the refresh rate is zero.
+  //
+  // This returns `false` if the size is out of range, `data` is `nullptr`, or
+  // the queue is full, and `true` otherwise.
+  bool queueFrame(const uint8_t *data, int size,
+                  uint32_t mbbTime = kDefaultTiming,
+                  uint32_t interSlotTime = kDefaultTiming);
+
+  // Returns the number of queued frames not yet loaded for transmission.
+  int queuedFrameCount() const {
+    return frameQueueCount_;
+  }
+
+  // Removes all frames from the queue that haven't yet been loaded
+  // for transmission.
+  void clearFrameQueue();
+
+  // Sets whether each packet waits for an external trigger instead of
+  // following the refresh rate. When enabled, after a packet is sent, the next
+  // BREAK doesn't start until `triggerFrame()` is called, plus the phase
+  // offset. This allows the output to be locked to an external frame clock,
+  // for example a video sync pulse on a GPIO pin or packets arriving at
+  // a `Receiver`.
+  //
+  // The refresh rate is ignored in this mode, except that a rate of zero still
+  // means that no packets are sent. The MBB time is still respected.
+  //
+  // Pausing and resuming work as usual. For example, `resumeFor(1)` sends one
+  // packet at the next trigger.
+  //
+  // The default is disabled.
+  void setExternalTrigger(bool flag);
+
+  // Returns whether packets wait for an external trigger. See
+  // `setExternalTrigger`.
+  bool isExternalTrigger() const {
+    return externalTrigger_;
+  }
+
+  // Sets the phase offset, the time from a trigger to the start of the BREAK,
+  // in microseconds. To have the BREAK lead a periodic trigger, use the trigger
+  // period minus the desired lead time.
+  //
+  // The default is zero.
+  void setTriggerPhase(uint32_t t) {
+    triggerPhase_ = t;
+  }
+
+  // Returns the phase offset, in microseconds. See `setTriggerPhase`.
+  uint32_t triggerPhase() const {
+    return triggerPhase_;
+  }
+
+  // Starts the next packet, after the phase offset, if external triggering is
+  // enabled. If the previous packet is still being sent then the trigger is
+  // counted as missed and ignored; triggers aren't queued. This does nothing
+  // if external triggering isn't enabled.
+  //
+  // This is safe to call from an ISR, for example from a pin interrupt or from
+  // a `Responder`.
+  void triggerFrame();
+
+  // Returns the external trigger statistics. These are reset when the sender
+  // is started or restarted, and by calling `resetTriggerStats()`.
+  TriggerStats triggerStats() const;
+
+  // Resets the external trigger statistics.
+  void resetTriggerStats();
+
+  // Returns a snapshot of the transmit statistics. This doesn't normally
+  // disable interrupts; if the ISR updates the statistics while they're being
+  // copied, the copy is made again. After a few tries, the copy is made with
+  // the UART IRQs disabled so that this can't spin forever. These are reset
+  // when the sender is started or restarted, and by calling `resetTXStats()`.
+  //
+  // This shouldn't be called from an ISR that can preempt the sender's ISRs.
+  // If it interrupts an update, the update can't finish until it returns, and
+  // the snapshot will have `TXStats::isPartial` set.
+  TXStats txStats() const;
+
+  // Resets the transmit statistics.
+  void resetTXStats();
+
+  // Enables automatic System Information Packets (SIP). When enabled, the
+  // sender follows every `interval` packets having a NULL start code with
+  // a SIP, immediately, as for a queued frame. A value of zero disables this.
+  //
+  // The checksum of the preceding packet is accumulated by the ISR as each
+  // byte is sent, so this costs nothing in the main loop. The sender fills in
+  // the checksum, a free-running sequence number, the number of slots in the
+  // preceding packet, and the number of packets sent since the previous SIP
+  // (or since enabling this); the other fields come from `setSIPConfig`.
+  //
+  // SIPs are sent ahead of any queued frames, aren't sent while paused, and
+  // count as packets for `resumeFor`.
+  //
+  // This returns `false` if the interval is negative, and `true` otherwise.
+  // The default is disabled.
+  bool setAutoSIP(int interval);
+
+  // Returns the automatic SIP interval, or zero if disabled.
+  int autoSIPInterval() const {
+    return sipInterval_;
+  }
+
+  // Sets the SIP fields that aren't computed by the sender. This takes effect
+  // at the next SIP.
+  void setSIPConfig(const SIPConfig &config);
+
+  // Returns the SIP fields that aren't computed by the sender.
+  SIPConfig sipConfig() const;
+
  private:
   // State that tracks what to transmit and when.
   enum class XmitStates {
@@ -1117,12 +1975,81 @@ class Sender final : public TeensyDMX {
   // This does nothing if `began_` is `false`.
   void setIRQState(bool flag) const;
 
+  // A frame in the frame queue.
+  struct QueuedFrame final {
+    const uint8_t *data;
+    int size;
+    uint32_t mbbTime;
+    uint32_t interSlotTime;
+  };
+
   // Completes a sent packet. This increments the packet count, resets the
-  // output buffer index, and sets the state to `kIdle`.
+  // output buffer index, and sets the state to `kIdle`. The next packet is the
+  // next queued frame, if there is one, and otherwise the current channel
+  // values.
   //
   // This is called from an ISR.
   void completePacket();
 
+  // Returns the next slot to send and adds it to the checksum of the packet
+  // being sent. This is called from the ISR.
+  uint8_t nextSlot() {
+    uint8_t b = inactiveBuf_[inactiveBufIndex_++];
+    txChecksum_ += b;
+    return b;
+  }
+
+  // Loads a SIP for the packet that was just sent, given its checksum. This
+  // is called from the ISR.
+  void loadSIP(uint16_t checksum);
+
+  // Loads the next queued frame for transmission and removes it from the
+  // queue. This must be called with the UART interrupts disabled or from
+  // the ISR.
+  void loadQueuedFrame();
+
+  // Sets the timing for the next packet back to the sender's own settings.
+  // This must be called with the UART interrupts disabled or from the ISR.
+  void restorePacketTiming();
+
+  // Sets the inter-slot MARK time for the packet being sent. This also works
+  // out how the UART would produce it, if it's not using a timer. This must be
+  // called with the UART interrupts disabled or from the ISR.
+  void setPacketInterSlotTime(uint32_t t, uint32_t adjusted);
+
+  // Returns the time, in microseconds, to wait before starting the next BREAK
+  // so that BREAKs follow the refresh rate schedule and the MBB is respected.
+  // This advances the schedule by one period. This is called from the ISR.
+  uint32_t nextBreakDelay();
+
+  // Returns whether to wait for an external trigger before starting the next
+  // BREAK. The first call after a packet arms the trigger, and the call after
+  // the trigger consumes it. This is called from the ISR.
+  bool waitForTrigger();
+
+  // Records the start of a BREAK. This also measures the latency from any
+  // trigger that started the packet. This is called from the ISR.
+  void breakStarted();
+
+  // Record the end of a timer-generated BREAK and MAB. These are called from
+  // the ISR.
+  void breakEnded();
+  void mabEnded();
+
+  // Records a timer that couldn't be started. This is called from the ISR.
+  void timerFailed();
+
+  // Start and end an update of the transmit stats. The sequence number is odd
+  // during an update so that readers can tell when a copy may be torn. These
+  // must be called with the UART interrupts disabled or from the ISR.
+  void beginTXStatsUpdate();
+  void endTXStatsUpdate();
+
+  // Returns the size of the next packet to send, taking automatic trimming
+  // into account. This updates the trimming high-water mark and must be called
+  // with the UART interrupts disabled or from the ISR.
+  int nextPacketSize();
+
   // Tracks whether the system has been configured.
   volatile bool began_;
 
@@ -1154,14 +2081,58 @@ class Sender final : public TeensyDMX {
   volatile bool breakUseTimer_;  // Whether to use a timer or serial parameters
                                  // for BREAK/MAB times
 
+  // Corrections from requested times to timer values
+  TimerCalibration timerCalibration_;
+
   // MARK time between slots
   volatile uint32_t interSlotTime_;
   volatile uint32_t adjustedInterSlotTime_;
 
+  // MARK time between slots for the packet being sent, which may be
+  // overridden by a queued frame
+  volatile uint32_t packetInterSlotTime_;
+  volatile uint32_t packetAdjustedInterSlotTime_;
+
+  // Inter-slot MARK time produced by the UART, for the packet being sent
+  volatile bool interSlotUseTimer_;
+  bool packetInterSlotSerial_;  // Whether to use the UART for this packet
+  uint8_t packetInterSlotPadBits_;  // MARK bits appended to each slot
+  int packetInterSlotIdleChars_;    // Idle characters after each slot
+  int interSlotIdleRemaining_;      // Still to queue after the current slot
+
   // The size of the packet to be sent.
   volatile int activePacketSize_;
   volatile int inactivePacketSize_;
 
+  // Frame processors, called in order at each frame boundary
+  FrameProcessor *frameProcessors_[kMaxFrameProcessors];
+  volatile int frameProcessorCount_;
+
+  // Frame queue, a ring buffer. When a queued frame or SIP has been loaded for
+  // transmission, it's sent after only its own adjusted MBB time.
+  QueuedFrame frameQueue_[kFrameQueueSize];
+  int frameQueueHead_;
+  volatile int frameQueueCount_;
+  volatile bool queuedFrameLoaded_;
+  uint32_t queuedFrameAdjustedMBBTime_;
+
+  // The 16-bit additive checksum of the slots sent so far in this packet.
+  uint16_t txChecksum_;
+
+  // Automatic SIPs. The NULL packet count is the number of NULL start code
+  // packets since the last SIP, for the interval, and the packet count is the
+  // number of packets of any type, for the SIP contents.
+  volatile int sipInterval_;
+  SIPConfig sipConfig_;
+  int sipNullPacketCount_;
+  uint16_t sipPacketCount_;
+  uint8_t sipSequence_;
+
+  // Automatic packet size trimming. The mark is one more than the highest slot
+  // that's held a non-zero value since trimming was enabled.
+  volatile bool autoPacketSize_;
+  int autoPacketSizeMark_;
+
   // MBB
   volatile uint32_t mbbTime_;
   volatile uint32_t adjustedMBBTime_;
@@ -1174,13 +2145,43 @@ class Sender final : public TeensyDMX {
   util::PeriodicTimer intervalTimer_;  // General purpose timer
 #endif  // !TEENSYDMX_USE_PERIODICTIMER
 
-  // The BREAK-to-BREAK timing, matching the refresh rate.
-  // This is specified in microseconds.
+  // The BREAK-to-BREAK timing, matching the refresh rate. This is specified
+  // in microseconds, with the fractional part as a 0.32 fixed-point value.
   volatile uint32_t breakToBreakTime_;
-
-  // Keeps track of the last BREAK start time, in milliseconds. This is for
-  // refresh rate timing.
-  uint32_t breakStartTime_;
+  volatile uint32_t breakToBreakFrac_;
+
+  // The BREAK schedule: when the next BREAK is due, in microseconds, with the
+  // fractional part as a 0.32 fixed-point value. BREAKs are scheduled at
+  // multiples of the period from a starting point and not relative to the
+  // actual start of the previous BREAK, so ISR latency and the truncated
+  // fraction don't accumulate. The schedule restarts from the current time
+  // when it isn't valid or when it falls more than a period behind.
+  uint32_t nextBreakTime_;
+  uint32_t nextBreakFrac_;
+  volatile bool breakScheduleValid_;
+
+  // External triggering. The sender is armed while it's waiting for
+  // a trigger, and triggered between the trigger and the next time the ISR
+  // sees it. Times are in microseconds.
+  volatile bool externalTrigger_;
+  volatile uint32_t triggerPhase_;
+  volatile bool triggerArmed_;
+  volatile bool triggered_;
+  uint32_t triggerArmTime_;  // When the previous packet finished
+  uint32_t triggerTime_;
+  uint32_t triggerCycles_;   // For measuring the latency
+  bool triggerLatencyPending_;
+  TriggerStats triggerStats_;
+  uint32_t nsPerCycleQ16_;
+
+  // Transmit stats, written by the ISR and read without locking by using
+  // a sequence number. Times are in cycles.
+  TXStats txStats_;
+  volatile uint32_t txStatsSeq_;
+  uint32_t txBreakStartCycles_;
+  uint32_t txBreakEndCycles_;
+  uint32_t txPacketEndCycles_;
+  bool txStatsContinuous_;  // Whether the last packet led straight to this one
 
   // For pausing
   volatile bool paused_;
@@ -0,0 +1,286 @@
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#include "TimingCalibrator.h"
+
+// C++ includes
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#include <core_pins.h>
+
+#include "util/CycleCounter.h"
+
+namespace qindesign {
+namespace teensydmx {
+
+extern const uint32_t kBitTime;   // In microseconds
+extern const uint32_t kCharTime;  // In microseconds
+
+// Timer values to measure, in microseconds. Each column is one point.
+static constexpr uint32_t kBreakTimes[TimingCalibrator::kPoints]{
+    92, 180, 360, 720};
+static constexpr uint32_t kMABTimes[TimingCalibrator::kPoints]{
+    12, 20, 40, 80};
+static constexpr uint32_t kInterSlotTimes[TimingCalibrator::kPoints]{
+    8, 20, 40, 80};
+
+// The test packet. The start code's zero bits make a long LOW that follows the
+// MAB, and each 255 slot has a single falling edge, at its start bit.
+static constexpr uint8_t kTestPacket[]{0, 255, 255};
+constexpr int kTestPacketSize = sizeof(kTestPacket);
+
+// Slow enough that each capture sees complete packets with idle time between,
+// and that the sender's ISR isn't running most of the time.
+constexpr float kTestRefreshRate = 200.0f;
+
+// Any LOW at least this long is a BREAK, in microseconds. This is longer than
+// the start code's LOW and shorter than the shortest BREAK measured.
+constexpr uint32_t kMinBreakTime = 60;
+
+constexpr uint32_t kSettleTime = 20;      // In milliseconds
+constexpr uint32_t kCaptureTimeout = 100;  // In milliseconds
+constexpr uint32_t kMeasureTimeout = 1000;  // In milliseconds
+
+// The calibrator whose edges are being captured.
+static TimingCalibrator *volatile calibrating = nullptr;
+
+// Returns the median of the values, reordering them.
+static float median(float *values, int count) {
+  std::sort(&values[0], &values[count]);
+  return values[count/2];
+}
+
+TimingCalibrator::TimingCalibrator(Sender &sender, int pin)
+    : sender_(sender),
+      pin_(pin),
+      edgeTimes_{0},
+      edgeLevels_(0),
+      edgeCount_(kMaxEdges),
+      measurements_{} {}
+
+TimingCalibrator::Measurement TimingCalibrator::measurement(int index) const {
+  if (index < 0 || kPoints <= index) {
+    return Measurement{};
+  }
+  return measurements_[index];
+}
+
+bool TimingCalibrator::calibrate(Sender::TimerCalibration *cal) {
+  if (sender_.isPaused() || sender_.isExternalTrigger()) {
+    return false;
+  }
+  if (calibrating != nullptr) {
+    return false;
+  }
+  calibrating = this;
+
+  // Save the sender's settings; the BREAK and MAB times are only reported for
+  // the timer when it's selected
+  bool breakUseTimer = sender_.isBreakUseTimerNotSerial();
+  sender_.setBreakUseTimerNotSerial(true);
+  uint32_t breakTime = sender_.breakTime();
+  uint32_t mabTime = sender_.mabTime();
+  uint32_t interSlotTime = sender_.interSlotTime();
+  bool interSlotUseTimer = sender_.isInterSlotUseTimer();
+  uint32_t mbbTime = sender_.mbbTime();
+  float refreshRate = sender_.refreshRate();
+  int packetSize = sender_.packetSize();
+  Sender::TimerCalibration oldCal = sender_.timerCalibration();
+
+  // Measure the raw timer behaviour
+  sender_.setTimerCalibration(Sender::TimerCalibration{});
+  sender_.setInterSlotUseTimer(true);
+  sender_.setMBBTime(0);
+  sender_.setRefreshRate(kTestRefreshRate);
+  sender_.setPacketSizeAndData(kTestPacketSize,
+                               0, kTestPacket, kTestPacketSize);
+
+  util::enableCycleCounter();
+  pinMode(pin_, INPUT);
+  attachInterrupt(pin_, &edgeISR, CHANGE);
+
+  bool ok = true;
+  for (int i = 0; i < kPoints && ok; i++) {
+    ok = measure(i);
+  }
+
+  detachInterrupt(pin_);
+  edgeCount_ = kMaxEdges;
+
+  Sender::TimerCalibration newCal;
+  if (ok) {
+    uint32_t x[kPoints];
+    float y[kPoints];
+    for (int i = 0; i < kPoints; i++) {
+      x[i] = measurements_[i].breakTime;
+      y[i] = measurements_[i].measuredBreakTime;
+    }
+    ok = fit(x, y, &newCal.breakTime);
+    for (int i = 0; i < kPoints; i++) {
+      x[i] = measurements_[i].mabTime;
+      y[i] = measurements_[i].measuredMABTime;
+    }
+    ok = ok && fit(x, y, &newCal.mabTime);
+    for (int i = 0; i < kPoints; i++) {
+      x[i] = measurements_[i].interSlotTime;
+      y[i] = measurements_[i].measuredInterSlotTime;
+    }
+    ok = ok && fit(x, y, &newCal.interSlotTime);
+  }
+
+  // Restore the settings
+  sender_.setTimerCalibration(ok ? newCal : oldCal);
+  sender_.setBreakTime(breakTime);
+  sender_.setMABTime(mabTime);
+  sender_.setBreakUseTimerNotSerial(breakUseTimer);
+  sender_.setInterSlotTime(interSlotTime);
+  sender_.setInterSlotUseTimer(interSlotUseTimer);
+  sender_.setMBBTime(mbbTime);
+  sender_.setRefreshRate(refreshRate);
+  sender_.setPacketSize(packetSize);
+
+  calibrating = nullptr;
+
+  if (ok && cal != nullptr) {
+    *cal = newCal;
+  }
+  return ok;
+}
+
+void TimingCalibrator::edgeISR() {
+  uint32_t t = util::cycleCount();
+  TimingCalibrator *c = calibrating;
+  if (c == nullptr) {
+    return;
+  }
+  int n = c->edgeCount_;
+  if (n >= kMaxEdges) {
+    return;
+  }
+  c->edgeTimes_[n] = t;
+  if (digitalReadFast(c->pin_)) {
+    c->edgeLevels_ = c->edgeLevels_ | (uint32_t{1} << n);
+  }
+  c->edgeCount_ = n + 1;
+}
+
+bool TimingCalibrator::capture() {
+  edgeLevels_ = 0;
+  edgeCount_ = 0;
+  uint32_t start = millis();
+  while (edgeCount_ < kMaxEdges) {
+    if (millis() - start >= kCaptureTimeout) {
+      edgeCount_ = kMaxEdges;
+      return false;
+    }
+  }
+  std::atomic_signal_fence(std::memory_order_acquire);
+  return true;
+}
+
+bool TimingCalibrator::measure(int index) {
+  Measurement &m = measurements_[index];
+  m = Measurement{};
+  m.breakTime = kBreakTimes[index];
+  m.mabTime = kMABTimes[index];
+  m.interSlotTime = kInterSlotTimes[index];
+
+  sender_.setBreakTime(m.breakTime);
+  sender_.setMABTime(m.mabTime);
+  sender_.setInterSlotTime(m.interSlotTime);
+  delay(kSettleTime);
+
+  float cyclesPerUs = util::cyclesPerSecond() / 1000000.0f;
+  float breakTimes[kSamples];
+  float mabTimes[kSamples];
+  float interSlotTimes[kSamples];
+  int count = 0;
+
+  uint32_t start = millis();
+  while (count < kSamples) {
+    if (millis() - start >= kMeasureTimeout) {
+      return false;
+    }
+    if (!capture()) {
+      continue;
+    }
+
+    // Find each BREAK followed by the MAB, the start code, and the first two
+    // slots: seven alternating edges, starting with a fall
+    uint32_t levels = edgeLevels_;
+    int i = 0;
+    while (i + 7 <= kMaxEdges && count < kSamples) {
+      bool valid = true;
+      for (int k = 0; k < 7; k++) {
+        if (((levels >> (i + k)) & 0x01) != static_cast<uint32_t>(k & 1)) {
+          valid = false;
+          break;
+        }
+      }
+      const uint32_t *t = &edgeTimes_[i];
+      float breakTime = (t[1] - t[0]) / cyclesPerUs;
+      float startCodeLow = (t[3] - t[2]) / cyclesPerUs;
+      float slotLow = (t[5] - t[4]) / cyclesPerUs;
+      // The start code's LOW is nine bits and each slot's is one
+      if (!valid || breakTime < kMinBreakTime ||
+          startCodeLow < 7*kBitTime || 11*kBitTime < startCodeLow ||
+          2*kBitTime < slotLow) {
+        i++;
+        continue;
+      }
+
+      breakTimes[count] = breakTime;
+      mabTimes[count] = (t[2] - t[1]) / cyclesPerUs;
+      interSlotTimes[count] = (t[6] - t[4]) / cyclesPerUs - kCharTime;
+      count++;
+      i += 7;
+    }
+  }
+
+  m.measuredBreakTime = median(breakTimes, count);
+  m.measuredMABTime = median(mabTimes, count);
+  m.measuredInterSlotTime = median(interSlotTimes, count);
+  return true;
+}
+
+bool TimingCalibrator::fit(const uint32_t *x, const float *y,
+                           Sender::TimerCorrection *c) const {
+  // Least squares: y = a*x + b
+  float meanX = 0.0f;
+  float meanY = 0.0f;
+  for (int i = 0; i < kPoints; i++) {
+    meanX += x[i];
+    meanY += y[i];
+  }
+  meanX /= kPoints;
+  meanY /= kPoints;
+
+  float sxx = 0.0f;
+  float sxy = 0.0f;
+  for (int i = 0; i < kPoints; i++) {
+    float dx = x[i] - meanX;
+    sxx += dx*dx;
+    sxy += dx*(y[i] - meanY);
+  }
+  if (!(sxx > 0.0f)) {
+    return false;
+  }
+  float a = sxy / sxx;
+  float b = meanY - a*meanX;
+
+  // A timer that's off by more than a factor of two, or by more than a few
+  // character times, is more likely a wiring problem than a timer problem
+  if (!(0.5f <= a && a <= 2.0f) || !(std::fabs(b) <= 4.0f*kCharTime)) {
+    return false;
+  }
+
+  // The timer value for a time t is (t - b)/a
+  c->offset = static_cast<int32_t>(std::lround(b * 65536.0f));
+  c->gain = static_cast<uint32_t>(std::lround(65536.0f / a));
+  return true;
+}
+
+}  // namespace teensydmx
+}  // namespace qindesign
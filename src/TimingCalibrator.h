@@ -0,0 +1,116 @@
+// TimingCalibrator.h defines a way to measure the BREAK, MAB, and inter-slot
+// MARK times that a sender produces with a timer, and to correct for them.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_TIMINGCALIBRATOR_H_
+#define TEENSYDMX_TIMINGCALIBRATOR_H_
+
+// C++ includes
+#include <cstdint>
+
+#include "TeensyDMX.h"
+
+namespace qindesign {
+namespace teensydmx {
+
+// Measures the times a sender actually produces for a range of timer values,
+// fits a straight line to each of the BREAK, MAB, and inter-slot MARK times,
+// and sets the sender's timer corrections from those lines. The corrections
+// built into the library were measured at one CPU speed and one time each, so
+// this is useful for other speeds, for example when overclocking, or for tight
+// timing over a wide range of times.
+//
+// The sender's TX pin must be connected to another digital pin, the loopback
+// pin, whose edges are timestamped with the cycle counter from a pin
+// interrupt. On the Teensy LC, which has no cycle counter, the timestamps only
+// have microsecond resolution and the results will be coarse.
+//
+// Calibrating takes over the sender for about a second. The sender must have
+// been started with `begin()` and must not be paused or waiting for an
+// external trigger. Calibration sends 3-slot test packets, {0, 255, 255}, and
+// afterwards restores the sender's timing settings and packet size, but not
+// the first three channel values. Frame processors, automatic SIPs, and queued
+// frames also send packets that aren't used for measuring, so it's best to
+// calibrate before setting those up.
+//
+// The results don't change for a given setup, so they can be stored, for
+// example in EEPROM, and given back to `Sender::setTimerCalibration` at
+// startup without calibrating again.
+//
+// Only one calibration can run at a time.
+class TimingCalibrator final {
+ public:
+  // The number of times measured for each of BREAK, MAB, and inter-slot.
+  static constexpr int kPoints = 4;
+
+  // The number of packets measured at each point. The median is used so that
+  // the occasional late interrupt doesn't skew the results.
+  static constexpr int kSamples = 9;
+
+  // One measured point: the timer values given to the sender, in
+  // microseconds, and the median times that were produced.
+  struct Measurement final {
+    uint32_t breakTime = 0;
+    uint32_t mabTime = 0;
+    uint32_t interSlotTime = 0;
+    float measuredBreakTime = 0.0f;
+    float measuredMABTime = 0.0f;
+    float measuredInterSlotTime = 0.0f;
+  };
+
+  // Creates a calibrator for the given sender and loopback pin.
+  TimingCalibrator(Sender &sender, int pin);
+
+  ~TimingCalibrator() = default;
+
+  // Disallow copying and moving
+  TimingCalibrator(const TimingCalibrator &) = delete;
+  TimingCalibrator &operator=(const TimingCalibrator &) = delete;
+
+  // Runs the calibration, which blocks until it's done. On success, this sets
+  // the new corrections on the sender, stores them in `cal` if it's not NULL,
+  // and returns `true`. This returns `false` if the sender isn't in a state
+  // that allows calibration, if another calibration is running, if no test
+  // packets were seen on the loopback pin, or if the measurements don't make
+  // sense; the sender's corrections are left alone in that case.
+  bool calibrate(Sender::TimerCalibration *cal = nullptr);
+
+  // Returns a measured point from the last calibration, or an all-zero
+  // measurement if the index is out of range.
+  Measurement measurement(int index) const;
+
+ private:
+  // The number of edges in one capture.
+  static constexpr int kMaxEdges = 32;
+
+  // Records an edge on the loopback pin. This is called from the pin ISR.
+  static void edgeISR();
+
+  // Measures one point and stores the result in `measurements_[index]`. This
+  // returns whether enough samples were seen.
+  bool measure(int index);
+
+  // Captures edges until the buffer is full. This returns whether the buffer
+  // filled before the timeout.
+  bool capture();
+
+  // Fits a line through the measurements and turns it into a correction. This
+  // returns whether the line makes sense.
+  bool fit(const uint32_t *x, const float *y, Sender::TimerCorrection *c) const;
+
+  Sender &sender_;
+  const int pin_;
+
+  // Edge capture, filled by the ISR
+  uint32_t edgeTimes_[kMaxEdges];
+  volatile uint32_t edgeLevels_;  // Bit i is the pin level after edge i
+  volatile int edgeCount_;
+
+  Measurement measurements_[kPoints];
+};
+
+}  // namespace teensydmx
+}  // namespace qindesign
+
+#endif  // TEENSYDMX_TIMINGCALIBRATOR_H_
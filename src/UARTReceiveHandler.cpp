@@ -9,6 +9,8 @@
 #include <core_pins.h>
 #include <util/atomic.h>
 
+#include "util/CycleCounter.h"
+
 namespace qindesign {
 namespace teensydmx {
 
@@ -121,8 +123,11 @@ int UARTReceiveHandler::priority() const {
 }
 
 void UARTReceiveHandler::irqHandler() const {
+  util::ISRProfiler::Scope profile{receiver_->isrProfiler_};
+
   uint8_t status = port_->S1;
 
+  uint32_t eventCycles = util::cycleCount();
   uint32_t eventTime = micros();
 
   // A framing error likely indicates a BREAK, but it could also mean that there
@@ -161,7 +166,7 @@ void UARTReceiveHandler::irqHandler() const {
 #endif  // KINETISK
 
     if (port_->D == 0) {
-      receiver_->receivePotentialBreak(eventTime);
+      receiver_->receivePotentialBreak(eventTime, eventCycles);
     } else {
       receiver_->receiveBadBreak();
     }
@@ -183,7 +188,7 @@ void UARTReceiveHandler::irqHandler() const {
         port_->D;
         port_->CFIFO = UART_CFIFO_RXFLUSH;
         __enable_irq();
-        receiver_->receiveIdle(eventTime);
+        receiver_->receiveIdle(eventTime, eventCycles);
       } else {
         __enable_irq();
         bool idle = ((status & UART_S1_IDLE) != 0);
@@ -216,7 +221,7 @@ void UARTReceiveHandler::irqHandler() const {
 #endif  // __MK20DX128__ || __MK20DX256__
         receiver_->receiveByte(port_->D, timestamp + kCharTime);
         if (idle) {  // Also capture any IDLE event
-          receiver_->receiveIdle(eventTime);
+          receiver_->receiveIdle(eventTime, eventCycles);
           // The flag has been cleared by reading the data register
         }
       }
@@ -232,7 +237,7 @@ void UARTReceiveHandler::irqHandler() const {
 #endif  // __MK20DX128__ || __MK20DX256__
       receiver_->receiveByte(port_->D, eventTime);
     } else if ((status & UART_S1_IDLE) != 0) {
-      receiver_->receiveIdle(eventTime);
+      receiver_->receiveIdle(eventTime, eventCycles);
       port_->D;  // Clear the flag
     }
   }
@@ -241,7 +246,7 @@ void UARTReceiveHandler::irqHandler() const {
   if ((status & UART_S1_RDRF) != 0) {
     receiver_->receiveByte(port_->D, eventTime);
   } else if ((status & UART_S1_IDLE) != 0) {
-    receiver_->receiveIdle(eventTime);
+    receiver_->receiveIdle(eventTime, eventCycles);
 
     // Clear the flag
     if (serialIndex_ == 0) {
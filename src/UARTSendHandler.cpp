@@ -99,8 +99,11 @@ int UARTSendHandler::priority() const {
 }
 
 void UARTSendHandler::breakTimerCallback() const {
+  util::ISRProfiler::Scope profile{sender_->isrProfiler_};
+
   if (sender_->state_ == Sender::XmitStates::kBreak) {
     port_->C3 &= ~UART_C3_TXINV;
+    sender_->breakEnded();
     sender_->state_ = Sender::XmitStates::kMAB;
     if (sender_->intervalTimer_.restart(sender_->adjustedMABTime_)) {
       return;
@@ -112,8 +115,10 @@ void UARTSendHandler::breakTimerCallback() const {
     // We shouldn't delay as an alternative because that might
     // mean we delay too long, however the MAB is most likely to
     // be too short in this case
+    sender_->timerFailed();
   }
   sender_->intervalTimer_.end();
+  sender_->mabEnded();
   sender_->state_ = Sender::XmitStates::kData;
   setActive();
 }
@@ -122,21 +127,31 @@ void UARTSendHandler::breakTimerPreCallback() const {
   // Invert the line as close as possible to the timer start
   port_->C3 |= UART_C3_TXINV;
   setInactive();
-  sender_->breakStartTime_ = micros();
+  sender_->breakStarted();
 }
 
 void UARTSendHandler::interSlotTimerCallback() const {
+  util::ISRProfiler::Scope profile{sender_->isrProfiler_};
+
   sender_->intervalTimer_.end();
   sender_->state_ = Sender::XmitStates::kData;
   setActive();
 }
 
 void UARTSendHandler::rateTimerCallback() const {
+  util::ISRProfiler::Scope profile{sender_->isrProfiler_};
+
   sender_->intervalTimer_.end();
   setActive();
 }
 
 void UARTSendHandler::irqHandler() const {
+  util::ISRProfiler::Scope profile{sender_->isrProfiler_};
+
+  sender_->trace(util::TraceEventType::kSendIRQ,
+                 static_cast<int>(sender_->state_),
+                 sender_->inactiveBufIndex_);
+
   uint8_t status = port_->S1;
   uint8_t control = port_->C2;
 
@@ -160,10 +175,13 @@ void UARTSendHandler::irqHandler() const {
         } else {
           // Not using a timer or starting it failed;
           // revert to the original way
+          if (sender_->breakUseTimer_) {
+            sender_->timerFailed();
+          }
           breakSerialParams_.apply(serialIndex_, port_);
           port_->D = 0;
           setCompleting();
-          sender_->breakStartTime_ = micros();
+          sender_->breakStarted();
         }
         break;
 
@@ -174,21 +192,21 @@ void UARTSendHandler::irqHandler() const {
 
       case Sender::XmitStates::kData:
 #if defined(KINETISK)
-        if (fifoSize_ > 1 && sender_->interSlotTime_ == 0) {
+        if (fifoSize_ > 1 && sender_->packetInterSlotTime_ == 0) {
           do {
             if (sender_->inactiveBufIndex_ >= sender_->inactivePacketSize_) {
               setCompleting();
               break;
             }
             port_->S1;
-            port_->D = sender_->inactiveBuf_[sender_->inactiveBufIndex_++];
+            port_->D = sender_->nextSlot();
           } while (port_->TCFIFO < fifoSize_);  // Transmit Count
         } else {  // No FIFO or don't use the FIFO
           if (sender_->inactiveBufIndex_ < sender_->inactivePacketSize_) {
-            port_->D = sender_->inactiveBuf_[sender_->inactiveBufIndex_++];
+            port_->D = sender_->nextSlot();
             if (sender_->inactiveBufIndex_ >= sender_->inactivePacketSize_) {
               setCompleting();
-            } else if (sender_->interSlotTime_ != 0) {
+            } else if (sender_->packetInterSlotTime_ != 0) {
               sender_->state_ = Sender::XmitStates::kInterSlot;
               setCompleting();
             }
@@ -198,10 +216,10 @@ void UARTSendHandler::irqHandler() const {
         }
 #else  // No FIFO
         if (sender_->inactiveBufIndex_ < sender_->inactivePacketSize_) {
-          port_->D = sender_->inactiveBuf_[sender_->inactiveBufIndex_++];
+          port_->D = sender_->nextSlot();
           if (sender_->inactiveBufIndex_ >= sender_->inactivePacketSize_) {
             setCompleting();
-          } else if (sender_->interSlotTime_ != 0) {
+          } else if (sender_->packetInterSlotTime_ != 0) {
             sender_->state_ = Sender::XmitStates::kInterSlot;
             setCompleting();
           }
@@ -217,6 +235,13 @@ void UARTSendHandler::irqHandler() const {
           setInactive();
           return;
         }
+
+        // Wait for an external trigger, if enabled
+        if (sender_->waitForTrigger()) {
+          setInactive();
+          return;
+        }
+
         if (sender_->resumeCounter_ > 0) {
           if (--sender_->resumeCounter_ == 0) {
             sender_->paused_ = true;
@@ -226,18 +251,14 @@ void UARTSendHandler::irqHandler() const {
         sender_->transmitting_ = true;
         sender_->state_ = Sender::XmitStates::kBreak;
 
-        // Delay so that we can achieve the specified refresh rate
-        // including the MBB
-        uint32_t timeSinceBreak = micros() - sender_->breakStartTime_;
+        // Delay so that we can achieve the specified refresh rate or
+        // trigger phase, including the MBB
         if (sender_->breakToBreakTime_ == UINT32_MAX) {
           // Infinite BREAK to BREAK time
           setInactive();
           return;
         }
-        uint32_t delay = sender_->adjustedMBBTime_;
-        if (timeSinceBreak + delay < sender_->breakToBreakTime_) {
-          delay = sender_->breakToBreakTime_ - timeSinceBreak;
-        }
+        uint32_t delay = sender_->nextBreakDelay();
         if (delay > 0) {
           setInactive();
           if (sender_->intervalTimer_.begin(
@@ -245,6 +266,7 @@ void UARTSendHandler::irqHandler() const {
                   delay)) {
             return;
           }
+          sender_->timerFailed();
         }
         // Starting the timer failed or no delay is necessary
         setActive();
@@ -277,9 +299,10 @@ void UARTSendHandler::irqHandler() const {
         setInactive();
         if (sender_->intervalTimer_.begin(
                 [this]() { interSlotTimerCallback(); },
-                sender_->adjustedInterSlotTime_)) {
+                sender_->packetAdjustedInterSlotTime_)) {
           return;
         }
+        sender_->timerFailed();
         sender_->state_ = Sender::XmitStates::kData;
         break;
       }
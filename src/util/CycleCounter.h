@@ -0,0 +1,113 @@
+// CycleCounter.h defines a high-resolution timestamp source. On processors
+// that have one, this uses the ARM DWT cycle counter.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_UTIL_CYCLECOUNTER_H_
+#define TEENSYDMX_UTIL_CYCLECOUNTER_H_
+
+// C++ includes
+#include <cstdint>
+
+#if defined(__MK20DX128__) || defined(__MK20DX256__) || \
+    defined(__MK64FX512__) || defined(__MK66FX1M0__)
+#include <kinetis.h>
+#define TEENSYDMX_HAS_DWT_CYCCNT
+#elif defined(__IMXRT1062__) || defined(__IMXRT1052__)
+#include <imxrt.h>
+#define TEENSYDMX_HAS_DWT_CYCCNT
+#elif defined(__MKL26Z64__)
+#include <core_pins.h>
+#else
+#include <chrono>
+#endif  // Processor check
+
+#if defined(__IMXRT1062__) || defined(__IMXRT1052__)
+// The core clock may be changed at runtime
+extern "C" volatile uint32_t F_CPU_ACTUAL;
+#endif  // __IMXRT1062__ || __IMXRT1052__
+
+namespace qindesign {
+namespace teensydmx {
+namespace util {
+
+// Enables the cycle counter. This is safe to call more than once.
+inline void enableCycleCounter() {
+#if defined(TEENSYDMX_HAS_DWT_CYCCNT)
+  ARM_DEMCR |= ARM_DEMCR_TRCENA;
+  ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+#endif  // TEENSYDMX_HAS_DWT_CYCCNT
+}
+
+// Returns the current cycle count. This wraps around, so only differences are
+// meaningful.
+//
+// The Teensy LC (Cortex-M0+) doesn't have a cycle counter, so `micros()` is
+// used instead. Builds for other systems use the standard steady clock, in
+// nanoseconds. In all cases, `cyclesPerSecond()` returns the matching rate.
+inline uint32_t cycleCount() {
+#if defined(TEENSYDMX_HAS_DWT_CYCCNT)
+  return ARM_DWT_CYCCNT;
+#elif defined(__MKL26Z64__)
+  return micros();
+#else
+  return static_cast<uint32_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+#endif  // TEENSYDMX_HAS_DWT_CYCCNT
+}
+
+// Returns the rate at which `cycleCount()` increments, in counts per second.
+inline uint32_t cyclesPerSecond() {
+#if defined(__IMXRT1062__) || defined(__IMXRT1052__)
+  return F_CPU_ACTUAL;
+#elif defined(TEENSYDMX_HAS_DWT_CYCCNT)
+  return F_CPU;
+#elif defined(__MKL26Z64__)
+  return 1000000;
+#else
+  return 1000000000;
+#endif  // Processor check
+}
+
+// Returns the number of nanoseconds per cycle, as a 16.16 fixed-point value.
+// This is used with `cyclesToNs` so that conversions in an ISR only need a
+// multiply and a shift.
+inline uint32_t nsPerCycleQ16() {
+  return static_cast<uint32_t>(
+      ((uint64_t{1000000000} << 16) + cyclesPerSecond()/2) / cyclesPerSecond());
+}
+
+// Converts a cycle count to nanoseconds using a scale from `nsPerCycleQ16()`.
+// The result saturates at UINT32_MAX.
+inline uint32_t cyclesToNs(uint32_t cycles, uint32_t scale) {
+  uint64_t ns = (uint64_t{cycles} * scale) >> 16;
+  if (ns > UINT32_MAX) {
+    return UINT32_MAX;
+  }
+  return static_cast<uint32_t>(ns);
+}
+
+// Converts a cycle count to microseconds, rounded to the nearest, using a scale
+// from `nsPerCycleQ16()`. Unlike `cyclesToNs`, this doesn't saturate for any
+// cycle count.
+inline uint32_t cyclesToUs(uint32_t cycles, uint32_t scale) {
+  uint64_t ns = (uint64_t{cycles} * scale) >> 16;
+  if (ns <= UINT32_MAX - 500) {
+    // Avoid the 64-bit division in the usual case
+    return (static_cast<uint32_t>(ns) + 500) / 1000;
+  }
+  return static_cast<uint32_t>((ns + 500) / 1000);
+}
+
+// Converts microseconds to cycles.
+inline uint32_t usToCycles(uint32_t us) {
+  return static_cast<uint32_t>(uint64_t{us} * cyclesPerSecond() / 1000000);
+}
+
+}  // namespace util
+}  // namespace teensydmx
+}  // namespace qindesign
+
+#endif  // TEENSYDMX_UTIL_CYCLECOUNTER_H_
@@ -0,0 +1,175 @@
+// Histogram.h defines a fixed-bucket histogram that doesn't allocate memory.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_UTIL_HISTOGRAM_H_
+#define TEENSYDMX_UTIL_HISTOGRAM_H_
+
+// C++ includes
+#include <algorithm>
+#include <cstdint>
+
+namespace qindesign {
+namespace teensydmx {
+namespace util {
+
+// A histogram of unsigned 32-bit values having up to `kMaxBuckets` equal-width
+// buckets. Bucket `i` counts values in the range
+// [minValue + i*bucketWidth, minValue + (i+1)*bucketWidth). Values below the
+// first bucket are counted as underflow and values above the last bucket are
+// counted as overflow.
+//
+// Adding a value is O(1) and doesn't allocate, so it's suitable for use in an
+// ISR. A histogram having zero buckets is disabled and ignores all values.
+class Histogram final {
+ public:
+  // The maximum number of buckets.
+  static constexpr int kMaxBuckets = 64;
+
+  // Creates a disabled histogram.
+  constexpr Histogram()
+      : minValue_(0),
+        bucketWidth_(1),
+        bucketCount_(0),
+        underflow_(0),
+        overflow_(0),
+        buckets_{} {}
+
+  ~Histogram() = default;
+
+  // Support common use of this object
+  Histogram(const Histogram &) = default;
+  Histogram(Histogram &&) = default;
+  Histogram &operator=(const Histogram &) = default;
+  Histogram &operator=(Histogram &&) = default;
+
+  // Sets the bucket layout and clears all the counts. The bucket count is
+  // clamped to [0, kMaxBuckets] and the width is forced to be at least 1. A
+  // count of zero disables the histogram.
+  void configure(uint32_t minValue, uint32_t bucketWidth, int bucketCount) {
+    minValue_ = minValue;
+    bucketWidth_ = std::max(bucketWidth, uint32_t{1});
+    bucketCount_ = std::min(std::max(bucketCount, 0), int{kMaxBuckets});
+    reset();
+  }
+
+  // Clears all the counts, keeping the bucket layout.
+  void reset() {
+    underflow_ = 0;
+    overflow_ = 0;
+    std::fill_n(&buckets_[0], kMaxBuckets, uint32_t{0});
+  }
+
+  // Adds a value. This does nothing if the histogram is disabled.
+  void add(uint32_t x) {
+    if (bucketCount_ <= 0) {
+      return;
+    }
+    if (x < minValue_) {
+      underflow_++;
+      return;
+    }
+    uint32_t i = (x - minValue_) / bucketWidth_;
+    if (i >= static_cast<uint32_t>(bucketCount_)) {
+      overflow_++;
+    } else {
+      buckets_[i]++;
+    }
+  }
+
+  // Returns whether the histogram is enabled, i.e. whether it has at least one
+  // bucket.
+  bool enabled() const {
+    return bucketCount_ > 0;
+  }
+
+  // Returns the start of the first bucket.
+  uint32_t minValue() const {
+    return minValue_;
+  }
+
+  // Returns the bucket width.
+  uint32_t bucketWidth() const {
+    return bucketWidth_;
+  }
+
+  // Returns the number of buckets.
+  int bucketCount() const {
+    return bucketCount_;
+  }
+
+  // Returns the count for the given bucket, or zero if the index is out
+  // of range.
+  uint32_t bucket(int index) const {
+    if (index < 0 || bucketCount_ <= index) {
+      return 0;
+    }
+    return buckets_[index];
+  }
+
+  // Returns the number of values below the first bucket.
+  uint32_t underflow() const {
+    return underflow_;
+  }
+
+  // Returns the number of values above the last bucket.
+  uint32_t overflow() const {
+    return overflow_;
+  }
+
+  // Returns the total number of values added, including underflow
+  // and overflow.
+  uint32_t count() const {
+    uint32_t n = underflow_ + overflow_;
+    for (int i = 0; i < bucketCount_; i++) {
+      n += buckets_[i];
+    }
+    return n;
+  }
+
+  // Returns an estimate of the value at the given percentile, in the range
+  // [0, 100], interpolating linearly within the bucket. Underflowed values are
+  // considered to be at the start of the first bucket, and overflowed values
+  // at the end of the last bucket. This returns zero if there are no values.
+  float percentile(float p) const {
+    uint32_t total = count();
+    if (total == 0) {
+      return 0.0f;
+    }
+    p = std::min(std::max(p, 0.0f), 100.0f);
+    float rank = p / 100.0f * total;
+
+    float cum = underflow_;
+    if (underflow_ > 0 && rank <= cum) {
+      return minValue_;
+    }
+    for (int i = 0; i < bucketCount_; i++) {
+      uint32_t n = buckets_[i];
+      if (n > 0 && rank <= cum + n) {
+        return minValue_ + bucketWidth_*(i + (rank - cum)/n);
+      }
+      cum += n;
+    }
+    return minValue_ + static_cast<float>(bucketWidth_)*bucketCount_;
+  }
+
+  // Returns the spread between two percentiles, for example
+  // `spread(5, 95)`. This is a measure of jitter.
+  float spread(float lowP, float highP) const {
+    return percentile(highP) - percentile(lowP);
+  }
+
+ private:
+  uint32_t minValue_;
+  uint32_t bucketWidth_;
+  int bucketCount_;
+  uint32_t underflow_;
+  uint32_t overflow_;
+  uint32_t buckets_[kMaxBuckets];
+};
+
+}  // namespace util
+}  // namespace teensydmx
+}  // namespace qindesign
+
+#endif  // TEENSYDMX_UTIL_HISTOGRAM_H_
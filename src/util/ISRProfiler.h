@@ -0,0 +1,171 @@
+// ISRProfiler.h defines a way to measure ISR execution time with the
+// cycle counter.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_UTIL_ISRPROFILER_H_
+#define TEENSYDMX_UTIL_ISRPROFILER_H_
+
+// C++ includes
+#include <cstdint>
+
+#include <core_pins.h>
+
+#include "CycleCounter.h"
+
+namespace qindesign {
+namespace teensydmx {
+namespace util {
+
+// Accumulates ISR execution times. Each invocation is measured by placing a
+// `Scope` object at the top of the ISR. Recording is only done from ISRs that
+// can't preempt each other, i.e. ones that all run at the same priority.
+class ISRProfiler final {
+ public:
+  // A snapshot of the accumulated times, all in cycle counter units.
+  struct Stats {
+    uint32_t count;             // Number of invocations
+    uint32_t lastCycles;        // The most recent invocation
+    uint32_t maxCycles;         // The longest invocation
+    uint64_t totalCycles;       // Sum over all invocations
+    uint32_t windowCycles;      // Sum over the last complete window
+    uint32_t windowLength;      // The length of that window
+    uint32_t cyclesPerSecond;   // The cycle counter rate, for conversions
+
+    // Returns the fraction of the CPU used during the last complete window.
+    float load() const {
+      if (windowLength == 0) {
+        return 0.0f;
+      }
+      return static_cast<float>(windowCycles) / windowLength;
+    }
+  };
+
+  // Measures the time from construction to destruction.
+  class Scope final {
+   public:
+    explicit Scope(ISRProfiler &p)
+        : profiler_(p),
+          start_(cycleCount()) {}
+
+    ~Scope() {
+      profiler_.record(start_, cycleCount());
+    }
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+   private:
+    ISRProfiler &profiler_;
+    uint32_t start_;
+  };
+
+  ISRProfiler()
+      : count_(0),
+        lastCycles_(0),
+        maxCycles_(0),
+        totalCycles_(0),
+        windowStart_(0),
+        windowStartUs_(0),
+        windowLength_(cyclesPerSecond()),
+        maxWindowUs_(maxWindowUs()),
+        windowCycles_(0),
+        lastWindowCycles_(0),
+        lastWindowLength_(0) {}
+
+  ~ISRProfiler() = default;
+
+  // Clears everything and starts a new window.
+  void reset() {
+    count_ = 0;
+    lastCycles_ = 0;
+    maxCycles_ = 0;
+    totalCycles_ = 0;
+    windowLength_ = cyclesPerSecond();
+    maxWindowUs_ = maxWindowUs();
+    windowStart_ = cycleCount();
+    windowStartUs_ = micros();
+    windowCycles_ = 0;
+    lastWindowCycles_ = 0;
+    lastWindowLength_ = 0;
+  }
+
+  // Records one invocation, given its start and end cycle counts.
+  void record(uint32_t start, uint32_t end) {
+    uint32_t cycles = end - start;
+    count_++;
+    lastCycles_ = cycles;
+    if (cycles > maxCycles_) {
+      maxCycles_ = cycles;
+    }
+    totalCycles_ += cycles;
+
+    rollWindow(end);
+    windowCycles_ += cycles;
+  }
+
+  // Returns a snapshot. This first rolls the window over if it's complete, so
+  // that the last window is current even if there haven't been any recent
+  // invocations. The caller must make sure this isn't interrupted by a call
+  // to `record`.
+  Stats stats() const {
+    rollWindow(cycleCount());
+    return Stats{count_, lastCycles_, maxCycles_, totalCycles_,
+                 lastWindowCycles_, lastWindowLength_, windowLength_};
+  }
+
+ private:
+  // Returns the longest window whose length can be measured with the cycle
+  // counter before it wraps, in microseconds. This uses half the range to be
+  // safe.
+  static uint32_t maxWindowUs() {
+    return static_cast<uint32_t>((uint64_t{1} << 31) * 1000000 /
+                                 cyclesPerSecond());
+  }
+
+  // Starts a new window if the current one has lasted at least a second. A
+  // window can last longer than that when there are no invocations or reads for
+  // a while, so its actual length is kept.
+  //
+  // The window's age is tracked with `micros()` too, because the cycle counter
+  // wraps after a few seconds at high clock speeds. A window that lasted too
+  // long for its length to be measured in cycles is discarded, and the stats
+  // report no complete window until the next one ends.
+  void rollWindow(uint32_t now) const {
+    uint32_t elapsedUs = micros() - windowStartUs_;
+    if (elapsedUs >= maxWindowUs_) {
+      lastWindowCycles_ = 0;
+      lastWindowLength_ = 0;
+    } else {
+      uint32_t elapsed = now - windowStart_;
+      if (elapsed < windowLength_) {
+        return;
+      }
+      lastWindowCycles_ = windowCycles_;
+      lastWindowLength_ = elapsed;
+    }
+    windowCycles_ = 0;
+    windowStart_ = now;
+    windowStartUs_ = micros();
+  }
+
+  uint32_t count_;
+  uint32_t lastCycles_;
+  uint32_t maxCycles_;
+  uint64_t totalCycles_;
+
+  // One-second window, also rolled over when reading the stats
+  mutable uint32_t windowStart_;
+  mutable uint32_t windowStartUs_;  // From micros(), for detecting long gaps
+  uint32_t windowLength_;  // In cycles
+  uint32_t maxWindowUs_;
+  mutable uint32_t windowCycles_;
+  mutable uint32_t lastWindowCycles_;
+  mutable uint32_t lastWindowLength_;  // The actual length, in cycles
+};
+
+}  // namespace util
+}  // namespace teensydmx
+}  // namespace qindesign
+
+#endif  // TEENSYDMX_UTIL_ISRPROFILER_H_
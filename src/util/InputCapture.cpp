@@ -0,0 +1,431 @@
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#include "InputCapture.h"
+
+// C++ includes
+#include <initializer_list>
+
+#include <core_pins.h>
+
+namespace qindesign {
+namespace teensydmx {
+namespace util {
+
+#if defined(KINETISK)
+
+// FTM register layout, starting at FTMx_SC.
+struct InputCapture::Regs {
+  volatile uint32_t SC;
+  volatile uint32_t CNT;
+  volatile uint32_t MOD;
+  struct {
+    volatile uint32_t SC;
+    volatile uint32_t V;
+  } C[8];
+  volatile uint32_t CNTIN;
+  volatile uint32_t STATUS;
+  volatile uint32_t MODE;
+  volatile uint32_t SYNC;
+  volatile uint32_t OUTINIT;
+  volatile uint32_t OUTMASK;
+  volatile uint32_t COMBINE;
+};
+
+// Prescaler, as a power of two. Dividing the bus clock by 8 gives a period of
+// at least 8.7ms and a resolution of at most 133ns for the supported bus
+// clocks, enough to cover a long BREAK plus MAB.
+static constexpr uint32_t kPrescale = 3;
+
+// COMBINE register bits for channel pair 0. Each pair's bits are shifted left
+// by 8.
+static constexpr uint32_t kCombineDECAPEN = 0x04;
+static constexpr uint32_t kCombineDECAP   = 0x08;
+static constexpr uint32_t kCombineMask    = 0xff;
+
+// Indices of the saved register values.
+static constexpr int kSavedSC      = 0;
+static constexpr int kSavedMOD     = 1;
+static constexpr int kSavedCNTIN   = 2;
+static constexpr int kSavedMODE    = 3;
+static constexpr int kSavedCOMBINE = 4;
+static constexpr int kSavedEvenSC  = 5;
+static constexpr int kSavedEvenV   = 6;
+static constexpr int kSavedOddSC   = 7;
+static constexpr int kSavedOddV    = 8;
+static constexpr int kSavedPCR     = 9;
+
+// Supported pins.
+struct CapturePin {
+  int pin;
+  int ftm;
+  int channel;
+  uint32_t mux;
+};
+static constexpr CapturePin kCapturePins[]{
+    {22, 0, 0, 4},
+    { 9, 0, 2, 4},
+    { 6, 0, 4, 4},
+    {21, 0, 6, 4},
+    { 3, 1, 0, 3},
+};
+
+bool InputCapture::begin(int pin) {
+  end();
+
+  const CapturePin *cp = nullptr;
+  for (const CapturePin &p : kCapturePins) {
+    if (p.pin == pin) {
+      cp = &p;
+      break;
+    }
+  }
+  if (cp == nullptr) {
+    return false;
+  }
+
+  Regs *ftm = reinterpret_cast<Regs *>(
+      const_cast<uint32_t *>((cp->ftm == 0) ? &FTM0_SC : &FTM1_SC));
+  uint32_t shift = 8*(cp->channel/2);
+
+  // Save everything that's changed so that end() can restore it
+  saved_[kSavedSC] = ftm->SC;
+  saved_[kSavedMOD] = ftm->MOD;
+  saved_[kSavedCNTIN] = ftm->CNTIN;
+  saved_[kSavedMODE] = ftm->MODE;
+  saved_[kSavedCOMBINE] = ftm->COMBINE;
+  saved_[kSavedEvenSC] = ftm->C[cp->channel].SC;
+  saved_[kSavedEvenV] = ftm->C[cp->channel].V;
+  saved_[kSavedOddSC] = ftm->C[cp->channel + 1].SC;
+  saved_[kSavedOddV] = ftm->C[cp->channel + 1].V;
+  saved_[kSavedPCR] = *portConfigRegister(pin);
+
+  // Stop the counter so that CNTIN and MOD are updated immediately, and only
+  // then enable the FTM-specific features; dual-edge capture needs FTMEN
+  ftm->MODE = FTM_MODE_WPDIS;
+  ftm->SC = 0;
+  ftm->CNTIN = 0;
+  ftm->MOD = kPeriodTicks - 1;
+  ftm->CNT = 0;
+  ftm->MODE = FTM_MODE_WPDIS | FTM_MODE_FTMEN;
+
+  // One-shot dual-edge capture: the even channel captures the rising edge and
+  // the odd channel captures the falling edge
+  ftm->COMBINE = (ftm->COMBINE & ~(kCombineMask << shift)) |
+                 (kCombineDECAPEN << shift);
+  ftm->C[cp->channel].SC = FTM_CSC_ELSA;
+  ftm->C[cp->channel + 1].SC = FTM_CSC_ELSB;
+
+  ftm->SC = FTM_SC_CLKS(1) | FTM_SC_PS(kPrescale);
+
+  *portConfigRegister(pin) = PORT_PCR_MUX(cp->mux);
+
+  regs_ = ftm;
+  channel_ = cp->channel;
+  pin_ = pin;
+  return true;
+}
+
+void InputCapture::end() {
+  if (regs_ == nullptr) {
+    return;
+  }
+
+  Regs *ftm = regs_;
+  uint32_t shift = 8*(channel_/2);
+
+  *portConfigRegister(pin_) = saved_[kSavedPCR];
+
+  // Stop the counter and restore the mode first, so that, when the FTM-specific
+  // features were off, CNTIN, MOD, and the channel values are updated
+  // immediately instead of waiting for a synchronization
+  ftm->SC = 0;
+  ftm->MODE = FTM_MODE_WPDIS;
+  ftm->MODE = saved_[kSavedMODE];
+  ftm->COMBINE = (ftm->COMBINE & ~(kCombineMask << shift)) |
+                 (saved_[kSavedCOMBINE] & (kCombineMask << shift));
+  ftm->C[channel_].SC = saved_[kSavedEvenSC];
+  ftm->C[channel_].V = saved_[kSavedEvenV];
+  ftm->C[channel_ + 1].SC = saved_[kSavedOddSC];
+  ftm->C[channel_ + 1].V = saved_[kSavedOddV];
+  ftm->CNTIN = saved_[kSavedCNTIN];
+  ftm->MOD = saved_[kSavedMOD];
+  ftm->CNT = 0;
+  ftm->SC = saved_[kSavedSC];
+
+  regs_ = nullptr;
+  channel_ = 0;
+  pin_ = -1;
+}
+
+void InputCapture::arm() {
+  if (regs_ == nullptr) {
+    return;
+  }
+
+  uint32_t shift = 8*(channel_/2);
+
+  // Restart the capture logic in case it's still waiting for an edge from a
+  // previous arm, then clear the flags; they're cleared by reading them as set
+  // and then writing a zero
+  regs_->COMBINE &= ~(kCombineDECAP << shift);
+  regs_->C[channel_].SC &= ~FTM_CSC_CHF;
+  regs_->C[channel_ + 1].SC &= ~FTM_CSC_CHF;
+  armCount_ = regs_->CNT;
+  regs_->COMBINE |= kCombineDECAP << shift;
+}
+
+int InputCapture::read(uint32_t *riseTicks, uint32_t *fallTicks) const {
+  if (regs_ == nullptr) {
+    return 0;
+  }
+
+  if ((regs_->C[channel_].SC & FTM_CSC_CHF) == 0) {
+    return 0;
+  }
+  *riseTicks = (regs_->C[channel_].V - armCount_) & (kPeriodTicks - 1);
+  if ((regs_->C[channel_ + 1].SC & FTM_CSC_CHF) == 0) {
+    return 1;
+  }
+  *fallTicks = (regs_->C[channel_ + 1].V - armCount_) & (kPeriodTicks - 1);
+  return 2;
+}
+
+uint32_t InputCapture::ticksPerSecond() {
+  return F_BUS >> kPrescale;
+}
+
+#elif defined(__IMXRT1062__) || defined(__IMXRT1052__)
+
+// QuadTimer channel register layout. Each channel's registers take 32 bytes,
+// and the channel enable register is only used in channel 0's block.
+struct TMRChannel {
+  volatile uint16_t COMP1;
+  volatile uint16_t COMP2;
+  volatile uint16_t CAPT;
+  volatile uint16_t LOAD;
+  volatile uint16_t HOLD;
+  volatile uint16_t CNTR;
+  volatile uint16_t CTRL;
+  volatile uint16_t SCTRL;
+  volatile uint16_t CMPLD1;
+  volatile uint16_t CMPLD2;
+  volatile uint16_t CSCTRL;
+  volatile uint16_t FILT;
+  volatile uint16_t DMA;
+  volatile uint16_t reserved[2];
+  volatile uint16_t ENBL;
+};
+
+// QuadTimer register layout, starting at TMRx_COMP10.
+struct InputCapture::Regs {
+  TMRChannel CH[4];
+};
+
+// Prescaler, as a power of two. Dividing the 150MHz IP bus clock by 32 gives a
+// period of about 14ms and a resolution of about 213ns, enough to cover a long
+// BREAK plus MAB.
+static constexpr uint32_t kPrescale = 5;
+
+// Primary count source value for the IP bus clock divided by 1.
+static constexpr uint32_t kPCSIPBus = 8;
+
+// The channel that captures the falling edge. It isn't the input channel for
+// any supported pin.
+static constexpr int kFallChannel = 3;
+
+// Indices of the saved register values. There's one set for each of the two
+// channels, starting at `kSavedRise` and `kSavedFall`.
+static constexpr int kSavedCTRL    = 0;
+static constexpr int kSavedSCTRL   = 1;
+static constexpr int kSavedCSCTRL  = 2;
+static constexpr int kSavedLOAD    = 3;
+static constexpr int kSavedCOMP1   = 4;
+static constexpr int kSavedCMPLD1  = 5;
+static constexpr int kSavedFILT    = 6;
+static constexpr int kSavedRise    = 0;
+static constexpr int kSavedFall    = 7;
+static constexpr int kSavedENBL    = 14;
+static constexpr int kSavedMux     = 15;
+
+// Supported pins. All of them use QuadTimer 1 at pin mux ALT1.
+struct CapturePin {
+  int pin;
+  int channel;
+};
+static constexpr CapturePin kCapturePins[]{
+    {10, 0},
+    {12, 1},
+    {11, 2},
+};
+static constexpr uint32_t kMuxALT = 1;
+
+// Saves one channel's configuration.
+static void saveChannel(const TMRChannel &ch, uint32_t *saved) {
+  saved[kSavedCTRL] = ch.CTRL;
+  saved[kSavedSCTRL] = ch.SCTRL;
+  saved[kSavedCSCTRL] = ch.CSCTRL;
+  saved[kSavedLOAD] = ch.LOAD;
+  saved[kSavedCOMP1] = ch.COMP1;
+  saved[kSavedCMPLD1] = ch.CMPLD1;
+  saved[kSavedFILT] = ch.FILT;
+}
+
+// Restores one channel's configuration. The channel must be disabled. The
+// control register is written last because it selects the count mode.
+static void restoreChannel(TMRChannel &ch, const uint32_t *saved) {
+  ch.CTRL = 0;
+  ch.SCTRL = saved[kSavedSCTRL];
+  ch.CSCTRL = saved[kSavedCSCTRL];
+  ch.LOAD = saved[kSavedLOAD];
+  ch.COMP1 = saved[kSavedCOMP1];
+  ch.CMPLD1 = saved[kSavedCMPLD1];
+  ch.FILT = saved[kSavedFILT];
+  ch.CNTR = 0;
+  ch.CTRL = saved[kSavedCTRL];
+}
+
+bool InputCapture::begin(int pin) {
+  end();
+
+  const CapturePin *cp = nullptr;
+  for (const CapturePin &p : kCapturePins) {
+    if (p.pin == pin) {
+      cp = &p;
+      break;
+    }
+  }
+  if (cp == nullptr) {
+    return false;
+  }
+
+  Regs *tmr = reinterpret_cast<Regs *>(&IMXRT_TMR1);
+  uint16_t enableMask = (1 << cp->channel) | (1 << kFallChannel);
+
+  CCM_CCGR6 |= CCM_CCGR6_QTIMER1(CCM_CCGR_ON);
+
+  // Save everything that's changed so that end() can restore it
+  saveChannel(tmr->CH[cp->channel], &saved_[kSavedRise]);
+  saveChannel(tmr->CH[kFallChannel], &saved_[kSavedFall]);
+  saved_[kSavedENBL] = tmr->CH[0].ENBL;
+  saved_[kSavedMux] = *portConfigRegister(pin);
+
+  // Disable both channels so that their counters can be started together, and
+  // then count up continuously from the IP bus clock. Both channels take their
+  // capture input from the pin's channel input: the pin's channel captures the
+  // rising edge and the other channel captures the falling edge.
+  tmr->CH[0].ENBL &= ~enableMask;
+  uint16_t ctrl = TMR_CTRL_CM(1) | TMR_CTRL_PCS(kPCSIPBus + kPrescale) |
+                  TMR_CTRL_SCS(cp->channel);
+  for (int ch : {cp->channel, kFallChannel}) {
+    tmr->CH[ch].CTRL = 0;
+    tmr->CH[ch].CSCTRL = 0;
+    tmr->CH[ch].FILT = 0;
+    tmr->CH[ch].LOAD = 0;
+    tmr->CH[ch].CNTR = 0;
+  }
+  tmr->CH[cp->channel].SCTRL = TMR_SCTRL_CAPTURE_MODE(1);
+  tmr->CH[kFallChannel].SCTRL = TMR_SCTRL_CAPTURE_MODE(2);
+  tmr->CH[cp->channel].CTRL = ctrl;
+  tmr->CH[kFallChannel].CTRL = ctrl;
+  tmr->CH[0].ENBL |= enableMask;
+
+  *portConfigRegister(pin) = kMuxALT;
+
+  regs_ = tmr;
+  channel_ = cp->channel;
+  pin_ = pin;
+  return true;
+}
+
+void InputCapture::end() {
+  if (regs_ == nullptr) {
+    return;
+  }
+
+  Regs *tmr = regs_;
+  uint16_t enableMask = (1 << channel_) | (1 << kFallChannel);
+
+  *portConfigRegister(pin_) = saved_[kSavedMux];
+
+  tmr->CH[0].ENBL &= ~enableMask;
+  restoreChannel(tmr->CH[channel_], &saved_[kSavedRise]);
+  restoreChannel(tmr->CH[kFallChannel], &saved_[kSavedFall]);
+  tmr->CH[0].ENBL = (tmr->CH[0].ENBL & ~enableMask) |
+                    (saved_[kSavedENBL] & enableMask);
+
+  regs_ = nullptr;
+  channel_ = 0;
+  pin_ = -1;
+}
+
+void InputCapture::arm() {
+  if (regs_ == nullptr) {
+    return;
+  }
+
+  // A channel doesn't capture again until its input edge flag is cleared, so
+  // clearing the flags arms both channels for their next edge. The flags are
+  // cleared by writing a zero. The counter is read first so that no capture
+  // can precede it.
+  armCount_ = regs_->CH[channel_].CNTR;
+  regs_->CH[channel_].SCTRL &= ~TMR_SCTRL_IEF;
+  regs_->CH[kFallChannel].SCTRL &= ~TMR_SCTRL_IEF;
+}
+
+int InputCapture::read(uint32_t *riseTicks, uint32_t *fallTicks) const {
+  if (regs_ == nullptr) {
+    return 0;
+  }
+
+  if ((regs_->CH[channel_].SCTRL & TMR_SCTRL_IEF) == 0) {
+    return 0;
+  }
+  uint32_t rise = (regs_->CH[channel_].CAPT - armCount_) & (kPeriodTicks - 1);
+  *riseTicks = rise;
+  if ((regs_->CH[kFallChannel].SCTRL & TMR_SCTRL_IEF) == 0) {
+    return 1;
+  }
+
+  // Unlike the FTM's dual-edge mode, the two channels capture independently,
+  // so a fall that came before the rise isn't the MAB end
+  uint32_t fall =
+      (regs_->CH[kFallChannel].CAPT - armCount_) & (kPeriodTicks - 1);
+  if (fall < rise) {
+    return 1;
+  }
+  *fallTicks = fall;
+  return 2;
+}
+
+uint32_t InputCapture::ticksPerSecond() {
+  return F_BUS_ACTUAL >> kPrescale;
+}
+
+#else
+
+bool InputCapture::begin(int /*pin*/) {
+  end();
+  return false;
+}
+
+void InputCapture::end() {
+}
+
+void InputCapture::arm() {
+}
+
+int InputCapture::read(uint32_t * /*riseTicks*/,
+                       uint32_t * /*fallTicks*/) const {
+  return 0;
+}
+
+uint32_t InputCapture::ticksPerSecond() {
+  return 0;
+}
+
+#endif  // KINETISK || __IMXRT1062__ || __IMXRT1052__
+
+}  // namespace util
+}  // namespace teensydmx
+}  // namespace qindesign
@@ -0,0 +1,147 @@
+// InputCapture.h defines an interface to a timer input-capture channel pair,
+// used for timestamping a BREAK end and MAB end in hardware.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_UTIL_INPUTCAPTURE_H_
+#define TEENSYDMX_UTIL_INPUTCAPTURE_H_
+
+// C++ includes
+#include <algorithm>
+#include <cstdint>
+
+namespace qindesign {
+namespace teensydmx {
+namespace util {
+
+// Captures one rising edge followed by one falling edge on a pin using a
+// hardware timer.
+//
+// On the Teensy 3.x, this uses the dual-edge capture mode of a FlexTimer (FTM)
+// channel pair. Only the even channel of a pair can be used as the input, so
+// only these pins are supported:
+// * FTM0: 22 (CH0), 9 (CH2), 6 (CH4), 21 (CH6)
+// * FTM1: 3 (CH0)
+//
+// Capturing reconfigures the pin's whole FTM, including its counter period and
+// prescaler, so PWM output won't work on any of that FTM's pins while
+// capturing: 5, 6, 9, 10, 20, 21, 22, and 23 for FTM0, and 3 and 4 for FTM1.
+// `end()` restores the FTM's previous configuration, including its counter, so
+// PWM on the other pins works again after that.
+//
+// On the Teensy 4.x, this uses two channels of QuadTimer 1 (TMR1). The pin's
+// own channel captures the rising edge and channel 3, which is given the same
+// pin as its input, captures the falling edge. These pins are supported:
+// * TMR1: 10 (CH0), 12 (CH1), 11 (CH2)
+//
+// Each QuadTimer channel has its own counter, so PWM on the other two pins
+// isn't affected, but only one of these pins can be used for capture at a time.
+// `end()` restores both channels' previous configuration.
+//
+// Other processors aren't currently supported, and `begin` will always return
+// `false` for them.
+//
+// This class is not safe in the presence of concurrency.
+class InputCapture final {
+ public:
+  constexpr InputCapture()
+      : regs_(nullptr),
+        channel_(0),
+        pin_(-1),
+        armCount_(0),
+        saved_{0} {}
+
+  ~InputCapture() {
+    end();
+  }
+
+  // Disallow copying, but allow moving so that owners can be moved; the moved-
+  // from object no longer owns the timer
+  InputCapture(const InputCapture &) = delete;
+  InputCapture &operator=(const InputCapture &) = delete;
+
+  InputCapture(InputCapture &&other)
+      : regs_(other.regs_),
+        channel_(other.channel_),
+        pin_(other.pin_),
+        armCount_(other.armCount_) {
+    std::copy_n(other.saved_, kSavedCount, saved_);
+    other.regs_ = nullptr;
+    other.pin_ = -1;
+  }
+
+  InputCapture &operator=(InputCapture &&other) {
+    if (this != &other) {
+      end();
+      regs_ = other.regs_;
+      channel_ = other.channel_;
+      pin_ = other.pin_;
+      armCount_ = other.armCount_;
+      std::copy_n(other.saved_, kSavedCount, saved_);
+      other.regs_ = nullptr;
+      other.pin_ = -1;
+    }
+    return *this;
+  }
+
+  // Starts capturing on the given pin. This stops any previous capture and
+  // saves the timer's current configuration. This returns whether the pin
+  // is supported.
+  bool begin(int pin);
+
+  // Stops capturing, restores the timer and pin configuration saved by
+  // `begin`, and releases the timer. This does nothing if not started.
+  void end();
+
+  // Returns whether capture has been started.
+  bool active() const {
+    return regs_ != nullptr;
+  }
+
+  // Returns the capture pin, or -1 if not started.
+  int pin() const {
+    return pin_;
+  }
+
+  // Arms the capture for one rising edge and then one falling edge. Any
+  // previous, possibly incomplete, capture is discarded. This may be called
+  // from an ISR.
+  void arm();
+
+  // Reads the captured edges, relative to the counter value when `arm()` was
+  // called. This returns the number of edges captured since the last `arm()`:
+  // zero, one (only `riseTicks` is set), or two (both are set). This may be
+  // called from an ISR.
+  //
+  // Counts wrap around after `kPeriodTicks` ticks, so it's up to the caller to
+  // make sure not too much time has elapsed since the call to `arm()`.
+  int read(uint32_t *riseTicks, uint32_t *fallTicks) const;
+
+  // Returns the counter rate, in ticks per second.
+  static uint32_t ticksPerSecond();
+
+  // The counter period, in ticks.
+  static constexpr uint32_t kPeriodTicks = 65536;
+
+ private:
+  // The timer's register layout, which depends on the processor.
+  struct Regs;
+
+  // The number of saved register values. What they are depends on
+  // the processor.
+  static constexpr int kSavedCount = 16;
+
+  Regs *regs_;
+  int channel_;  // The input channel
+  int pin_;
+  uint32_t armCount_;
+
+  // Timer and pin configuration saved by `begin` and restored by `end`.
+  uint32_t saved_[kSavedCount];
+};
+
+}  // namespace util
+}  // namespace teensydmx
+}  // namespace qindesign
+
+#endif  // TEENSYDMX_UTIL_INPUTCAPTURE_H_
@@ -0,0 +1,129 @@
+// RunningStat.h defines a streaming accumulator for count, min, max, mean, and
+// standard deviation.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_UTIL_RUNNINGSTAT_H_
+#define TEENSYDMX_UTIL_RUNNINGSTAT_H_
+
+// C++ includes
+#include <cmath>
+#include <cstdint>
+
+namespace qindesign {
+namespace teensydmx {
+namespace util {
+
+// Accumulates unsigned 32-bit samples. Adding a sample only needs a few integer
+// operations, so it's suitable for use in an ISR; the floating-point work is
+// done when querying the mean and standard deviation.
+//
+// The sums are kept relative to the first sample (the "shifted data"
+// algorithm), which keeps them small and the variance precise as long as the
+// samples are clustered, as timing measurements usually are. The sum of squares
+// can hold at least 2^24 samples that are each within 10^6 units of the first,
+// for example 1s in microseconds, but only about 18 samples that are 10^9 away.
+// If it overflows anyway, `variance()` and `stddev()` return NaN instead of
+// a wrong value.
+class RunningStat final {
+ public:
+  // Initializes everything to zero.
+  constexpr RunningStat()
+      : count_(0),
+        min_(0),
+        max_(0),
+        shift_(0),
+        sum_(0),
+        sumSq_(0),
+        overflow_(false) {}
+
+  ~RunningStat() = default;
+
+  // Support common use of this object
+  RunningStat(const RunningStat &) = default;
+  RunningStat(RunningStat &&) = default;
+  RunningStat &operator=(const RunningStat &) = default;
+  RunningStat &operator=(RunningStat &&) = default;
+
+  // Resets everything to zero.
+  void reset() {
+    *this = RunningStat{};
+  }
+
+  // Adds a sample.
+  void add(uint32_t x) {
+    if (count_ == 0) {
+      shift_ = min_ = max_ = x;
+    } else if (x < min_) {
+      min_ = x;
+    } else if (x > max_) {
+      max_ = x;
+    }
+    int64_t d = int64_t{x} - shift_;
+    uint64_t sq = static_cast<uint64_t>(d * d);  // |d| < 2^32, so this fits
+    sum_ += d;
+    if (sumSq_ > UINT64_MAX - sq) {
+      overflow_ = true;
+    }
+    sumSq_ += sq;
+    count_++;
+  }
+
+  // Returns the number of samples.
+  uint32_t count() const {
+    return count_;
+  }
+
+  // Returns the smallest sample, or zero if there are no samples.
+  uint32_t min() const {
+    return min_;
+  }
+
+  // Returns the largest sample, or zero if there are no samples.
+  uint32_t max() const {
+    return max_;
+  }
+
+  // Returns the mean, or zero if there are no samples.
+  float mean() const {
+    if (count_ == 0) {
+      return 0.0f;
+    }
+    return static_cast<float>(shift_ + static_cast<double>(sum_)/count_);
+  }
+
+  // Returns the sample variance, or zero if there are fewer than two samples.
+  // This returns NaN if the sum of squares overflowed.
+  float variance() const {
+    if (count_ < 2) {
+      return 0.0f;
+    }
+    if (overflow_) {
+      return NAN;
+    }
+    double s = static_cast<double>(sum_);
+    double v = (static_cast<double>(sumSq_) - s*s/count_) / (count_ - 1);
+    return (v < 0.0) ? 0.0f : static_cast<float>(v);
+  }
+
+  // Returns the sample standard deviation, or zero if there are fewer than two
+  // samples. This returns NaN if the sum of squares overflowed.
+  float stddev() const {
+    return std::sqrt(variance());
+  }
+
+ private:
+  uint32_t count_;
+  uint32_t min_;
+  uint32_t max_;
+  uint32_t shift_;  // The first sample
+  int64_t sum_;     // Sum of (x - shift_)
+  uint64_t sumSq_;  // Sum of (x - shift_)^2
+  bool overflow_;   // Whether sumSq_ overflowed
+};
+
+}  // namespace util
+}  // namespace teensydmx
+}  // namespace qindesign
+
+#endif  // TEENSYDMX_UTIL_RUNNINGSTAT_H_
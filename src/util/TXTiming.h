@@ -0,0 +1,117 @@
+// TXTiming.h defines a model of transmitted DMX packet timing and a checker for
+// the ANSI E1.11 transmitter limits.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_UTIL_TXTIMING_H_
+#define TEENSYDMX_UTIL_TXTIMING_H_
+
+// C++ includes
+#include <cstdint>
+
+namespace qindesign {
+namespace teensydmx {
+namespace util {
+
+// Bits returned by `TXTiming::violations()`, one for each ANSI E1.11
+// transmitter limit that's exceeded.
+enum TXTimingViolation : uint32_t {
+  kTXBreakTooShort        = 1 << 0,  // BREAK < 92us
+  kTXMABTooShort          = 1 << 1,  // MAB < 12us
+  kTXMABTooLong           = 1 << 2,  // MAB >= 1s
+  kTXInterSlotTooLong     = 1 << 3,  // Inter-slot MARK >= 1s
+  kTXMBBTooLong           = 1 << 4,  // MBB >= 1s
+  kTXBreakToBreakTooShort = 1 << 5,  // BREAK-to-BREAK < 1204us
+  kTXBreakToBreakTooLong  = 1 << 6,  // BREAK-to-BREAK > 1s
+};
+
+// The timing parameters of a transmitted packet, all in microseconds, and a
+// model of the resulting waveform. `Sender::timing()` returns the sender's
+// current settings; the fields can then be changed to explore other settings,
+// for example the frame rate for each packet size.
+//
+// The model is of the ideal waveform. The actual MAB, inter-slot, and MBB times
+// are usually a little longer, and the accuracy of the BREAK depends on how
+// it's generated. See the `Sender` docs for each setting.
+struct TXTiming final {
+  // The time for one slot: a start bit, 8 data bits, and 2 stop bits at 4us
+  // per bit.
+  static constexpr uint32_t kSlotTime = 44;
+
+  uint32_t breakTime;
+  uint32_t mabTime;
+  uint32_t interSlotTime;
+  uint32_t mbbTime;
+  int packetSize;     // Number of slots, including the start code
+  float refreshRate;  // In Hz; INFINITY means "as fast as possible"
+
+  // Returns the time from the start of the BREAK to the end of the last slot.
+  uint32_t packetTime() const {
+    if (packetSize <= 0) {
+      return breakTime + mabTime;
+    }
+    return breakTime + mabTime + packetSize*kSlotTime +
+           (packetSize - 1)*interSlotTime;
+  }
+
+  // Returns the time from one BREAK start to the next. This is the packet time
+  // plus the MBB, stretched if needed to meet the refresh rate. This returns
+  // UINT32_MAX if the refresh rate is zero, meaning no packets are sent.
+  uint32_t breakToBreakTime() const {
+    if (!(refreshRate > 0.0f)) {
+      return UINT32_MAX;
+    }
+    uint32_t t = packetTime() + mbbTime;
+    float period = 1000000.0f / refreshRate;
+    if (period > t) {
+      t = static_cast<uint32_t>(period);
+    }
+    return t;
+  }
+
+  // Returns the frame rate, in Hz, or zero if no packets are sent.
+  float frameRate() const {
+    uint32_t t = breakToBreakTime();
+    if (t == UINT32_MAX || t == 0) {
+      return 0.0f;
+    }
+    return 1000000.0f / t;
+  }
+
+  // Returns a bitwise OR of the `TXTimingViolation` values for each ANSI E1.11
+  // transmitter limit that isn't met, or zero if all of them are met. A
+  // refresh rate of zero is not considered to violate the BREAK-to-BREAK
+  // maximum because nothing is sent.
+  uint32_t violations() const {
+    uint32_t v = 0;
+    if (breakTime < 92) {
+      v |= kTXBreakTooShort;
+    }
+    if (mabTime < 12) {
+      v |= kTXMABTooShort;
+    }
+    if (mabTime >= 1000000) {
+      v |= kTXMABTooLong;
+    }
+    if (interSlotTime >= 1000000) {
+      v |= kTXInterSlotTooLong;
+    }
+    if (mbbTime >= 1000000) {
+      v |= kTXMBBTooLong;
+    }
+    uint32_t b2b = breakToBreakTime();
+    if (b2b < 1204) {
+      v |= kTXBreakToBreakTooShort;
+    }
+    if (b2b != UINT32_MAX && b2b > 1000000) {
+      v |= kTXBreakToBreakTooLong;
+    }
+    return v;
+  }
+};
+
+}  // namespace util
+}  // namespace teensydmx
+}  // namespace qindesign
+
+#endif  // TEENSYDMX_UTIL_TXTIMING_H_
@@ -0,0 +1,107 @@
+// TraceBuffer.h defines a lock-free single-producer, single-consumer ring
+// buffer of compact ISR trace events.
+// This file is part of the TeensyDMX library.
+// (c) 2023 Shawn Silverman
+
+#ifndef TEENSYDMX_UTIL_TRACEBUFFER_H_
+#define TEENSYDMX_UTIL_TRACEBUFFER_H_
+
+// C++ includes
+#include <atomic>
+#include <cstdint>
+
+namespace qindesign {
+namespace teensydmx {
+namespace util {
+
+// Trace event types.
+enum class TraceEventType : uint8_t {
+  kReceiveByte,            // Receiver::receiveByte
+  kReceiveIdle,            // Receiver::receiveIdle
+  kReceivePotentialBreak,  // Receiver::receivePotentialBreak
+  kReceiveBadBreak,        // Receiver::receiveBadBreak
+  kReceiveCompletePacket,  // Receiver::completePacket
+  kSendIRQ,                // A send handler's irqHandler
+  kSendCompletePacket,     // Sender::completePacket
+};
+
+// One trace record. The state is the numeric value of the receiver's or
+// sender's state enum at the time of the event, and the index is the current
+// slot index. The timestamp is the cycle counter value; see `cycleCount()` and
+// `cyclesPerSecond()` in CycleCounter.h.
+struct TraceEvent {
+  uint32_t timestamp;
+  TraceEventType type;
+  uint8_t state;
+  uint16_t index;
+};
+
+// A ring buffer holding up to N trace events, where N is a power of two. One
+// producer, typically ISRs all running at the same priority, calls `push`, and
+// one consumer, typically the main loop, calls `read`. Neither needs a lock.
+//
+// When the buffer is full, new events are dropped and counted rather than
+// overwriting events the consumer may be in the middle of reading.
+template <int N>
+class TraceBuffer final {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of two");
+
+ public:
+  constexpr TraceBuffer()
+      : head_(0),
+        tail_(0),
+        droppedCount_(0),
+        events_{} {}
+
+  ~TraceBuffer() = default;
+
+  // Adds an event. This is only called by the producer.
+  void push(uint32_t timestamp, TraceEventType type, uint8_t state,
+            uint16_t index) {
+    uint32_t head = head_;
+    if (head - tail_ >= static_cast<uint32_t>(N)) {
+      droppedCount_ = droppedCount_ + 1;
+      return;
+    }
+    TraceEvent &e = events_[head & (N - 1)];
+    e.timestamp = timestamp;
+    e.type = type;
+    e.state = state;
+    e.index = index;
+    std::atomic_signal_fence(std::memory_order_release);
+    head_ = head + 1;
+  }
+
+  // Reads up to `count` of the oldest events into `buf` and removes them. This
+  // returns the number of events read. This is only called by the consumer.
+  int read(TraceEvent *buf, int count) {
+    uint32_t tail = tail_;
+    uint32_t head = head_;
+    std::atomic_signal_fence(std::memory_order_acquire);
+    int n = 0;
+    while (n < count && tail != head) {
+      buf[n++] = events_[tail & (N - 1)];
+      tail++;
+    }
+    std::atomic_signal_fence(std::memory_order_release);
+    tail_ = tail;
+    return n;
+  }
+
+  // Returns the number of events dropped because the buffer was full.
+  uint32_t droppedCount() const {
+    return droppedCount_;
+  }
+
+ private:
+  volatile uint32_t head_;  // Written only by the producer
+  volatile uint32_t tail_;  // Written only by the consumer
+  volatile uint32_t droppedCount_;
+  TraceEvent events_[N];
+};
+
+}  // namespace util
+}  // namespace teensydmx
+}  // namespace qindesign
+
+#endif  // TEENSYDMX_UTIL_TRACEBUFFER_H_